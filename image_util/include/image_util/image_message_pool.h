@@ -0,0 +1,93 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef IMAGE_UTIL_IMAGE_MESSAGE_POOL_H_
+#define IMAGE_UTIL_IMAGE_MESSAGE_POOL_H_
+
+#include <string>
+#include <vector>
+
+// Boost Libraries
+#include <boost/thread/mutex.hpp>
+
+// ROS Libraries
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <std_msgs/Header.h>
+
+// OpenCV Libraries
+#include <opencv2/core/core.hpp>
+
+namespace image_util
+{
+  /**
+   * A pool of image messages that can be processed into directly and then
+   * published without copying.
+   *
+   * Publishing a message by pointer lets subscribers in the same nodelet
+   * manager receive it without serialization.  A message is reused once the
+   * pool holds the only reference to it, which means every subscriber has
+   * released it.
+   */
+  class ImageMessagePool
+  {
+  public:
+    /**
+     * @param[in]  max_size  The maximum number of messages kept for reuse.
+     */
+    explicit ImageMessagePool(size_t max_size = 4);
+
+    /**
+     * Gets a message with a data buffer for an image of the given size and
+     * type.
+     *
+     * @param[in]  header    The message header.
+     * @param[in]  encoding  The image encoding.
+     * @param[in]  size      The image size.
+     * @param[in]  type      The OpenCV type of the image.
+     * @param[out] image     A matrix header referencing the message data.
+     *                       Writing into it writes into the message.
+     *
+     * @returns The message.
+     */
+    sensor_msgs::ImagePtr Get(
+        const std_msgs::Header& header,
+        const std::string& encoding,
+        const cv::Size& size,
+        int type,
+        cv::Mat& image);
+
+  private:
+    size_t max_size_;
+    std::vector<sensor_msgs::ImagePtr> messages_;
+    boost::mutex mutex_;
+  };
+}
+
+#endif  // IMAGE_UTIL_IMAGE_MESSAGE_POOL_H_
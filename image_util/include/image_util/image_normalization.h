@@ -32,6 +32,9 @@
 
 #include <vector>
 
+// Boost Libraries
+#include <boost/shared_ptr.hpp>
+
 // ROS Libraries
 #include <ros/ros.h>
 
@@ -39,6 +42,9 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <image_util/tile_stats.h>
+#include <image_util/worker_pool.h>
+
 namespace image_util
 {
   /**
@@ -54,6 +60,77 @@ namespace image_util
       cv::Mat SourceImage,
       cv::Mat& DestImage);
 
+  /**
+   * Applies a fixed normalization image to a sequence of images.
+   *
+   * The normalization image is converted once into a fixed-point gain map,
+   * so normalizing an image is a single pass of integer multiplies into the
+   * destination buffer.  The results match normalize_illumination() to
+   * within one gray level.
+   */
+  class NormalizationApplier
+  {
+  public:
+    NormalizationApplier();
+
+    /**
+     * @param[in]  norm_image  The normalization image.  See SetNormImage().
+     * @param[in]  threads     The number of threads to split each image
+     *                         across.  The threads are created once and
+     *                         shared by copies of the applier.
+     */
+    explicit NormalizationApplier(const cv::Mat& norm_image, int32_t threads = 1);
+
+    /**
+     * Sets the normalization image and precomputes the gain map.
+     *
+     * @param[in]  norm_image  The normalization image, either CV_32FC1 scaled
+     *                         between 0 and 1, or CV_8UC1 scaled between 0
+     *                         and 255.
+     *
+     * @returns False if the normalization image is invalid.
+     */
+    bool SetNormImage(const cv::Mat& norm_image);
+
+    /**
+     * Normalizes the illumination of an image.
+     *
+     * @param[in]  source_image  The image to normalize (CV_8UC1, the same size
+     *                           as the normalization image).
+     * @param[out] dest_image    The normalized image.  If it is already a
+     *                           CV_8UC1 image of the right size, it's written
+     *                           in place without allocating.  It can be the
+     *                           same as the source image.
+     *
+     * @returns False if the source image doesn't match the normalization
+     *          image.
+     */
+    bool Apply(const cv::Mat& source_image, cv::Mat& dest_image) const;
+
+    bool Initialized() const { return !gain_.empty(); }
+
+  private:
+    static void ApplyRows(
+        int32_t row_start,
+        int32_t row_end,
+        const cv::Mat& gain,
+        const cv::Mat& source_image,
+        cv::Mat& dest_image);
+
+    static void ApplyBand(
+        const cv::Mat& gain,
+        const cv::Mat& source_image,
+        cv::Mat& dest_image,
+        int32_t band,
+        int32_t bands);
+
+    // Only created for more than one thread.
+    boost::shared_ptr<WorkerPool> pool_;
+
+    // Per-pixel gain in 16.16 fixed point (CV_32SC1).
+    cv::Mat gain_;
+  };
+
   /**
    * Normalizes the illumination in an image using contrast stretching.
    *
@@ -67,6 +144,42 @@ namespace image_util
       cv::Mat& dest_image,
       const cv::Mat& mask=cv::Mat());
 
+  /**
+   * Normalizes the illumination in an image using contrast stretching,
+   * reusing the tile statistics buffers between calls.
+   *
+   * @param[in]     grid_size     The grid size to normalize on
+   * @param[in]     source_image  The image to normalize
+   * @param[out]    dest_image    The resulting normalized image
+   * @param[in]     mask          The mask of pixels to consider, or empty
+   * @param[in,out] stats         The tile statistics to reuse
+   */
+  void ContrastStretch(
+      int32_t grid_size,
+      const cv::Mat& source_image,
+      cv::Mat& dest_image,
+      const cv::Mat& mask,
+      TileStats& stats);
+
+  /**
+   * Normalizes the illumination in an image using contrast stretching,
+   * reusing the tile statistics buffers between calls and splitting the
+   * image into bands of rows across a worker pool.
+   *
+   * @param[in]     grid_size     The grid size to normalize on
+   * @param[in]     source_image  The image to normalize
+   * @param[out]    dest_image    The resulting normalized image
+   * @param[in]     mask          The mask of pixels to consider, or empty
+   * @param[in,out] stats         The tile statistics to reuse
+   * @param[in]     pool          The worker pool to stretch the rows on
+   */
+  void ContrastStretch(
+      int32_t grid_size,
+      const cv::Mat& source_image,
+      cv::Mat& dest_image,
+      const cv::Mat& mask,
+      TileStats& stats,
+      WorkerPool& pool);
 
   /**
    * @brief      Computes a best estimate of a normalization image from a vector
@@ -79,6 +192,60 @@ namespace image_util
    */
   cv::Mat generate_normalization_image(const std::vector<cv::Mat>& image_list);
 
+  /**
+   * Incrementally accumulates images into a normalization image using
+   * constant memory, as an alternative to generate_normalization_image() for
+   * long image sequences.
+   */
+  class NormalizationImageAccumulator
+  {
+  public:
+    enum Mode
+    {
+      /** Average the images with a running sum. */
+      MEAN,
+      /**
+       * Estimate the per-pixel median of the images by stepping the
+       * estimate one gray level towards each new sample.  This is less
+       * sensitive to transient bright objects than the mean.
+       */
+      MEDIAN
+    };
+
+    explicit NormalizationImageAccumulator(Mode mode = MEAN);
+
+    /**
+     * Adds an image to the accumulator.
+     *
+     * @param[in]  image  An 8-bit image.  All images must have the same size
+     *                    and type as the first one added.
+     *
+     * @returns False if the image was rejected.
+     */
+    bool Add(const cv::Mat& image);
+
+    /**
+     * Computes the normalization image from the images added so far.
+     *
+     * @returns The normalization image, or an empty image if no images
+     *          have been added.
+     */
+    cv::Mat Finalize() const;
+
+    /**
+     * Discards all accumulated images.
+     */
+    void Reset();
+
+    int32_t Count() const { return count_; }
+
+  private:
+    Mode mode_;
+    int32_t count_;
+    cv::Mat sum_;
+    cv::Mat median_;
+  };
+
 	/**
 	 * @brief Convert the input Mat to 8 bit
 	 *
@@ -34,6 +34,7 @@
 
 // Boost Libraries
 #include <boost/circular_buffer.hpp>
+#include <boost/shared_ptr.hpp>
 
 // ROS Libraries
 #include <ros/ros.h>
@@ -49,11 +50,119 @@
 // RANGER Libraries
 #include <image_util/motion_estimation.h>
 #include <image_util/image_matching.h>
+#include <image_util/worker_pool.h>
 
 namespace image_util
 {
   cv::Mat WarpImage(const cv::Mat& image, double roll, double pitch);
 
+  /**
+   * Rotates an image by a multiple of 90 degrees in a single pass.
+   *
+   * @param[in]  image          The image to rotate
+   * @param[in]  quarter_turns  The number of clockwise quarter turns.
+   *                            Negative values turn counter-clockwise.
+   * @param[out] rotated        The rotated image.  If it's already allocated
+   *                            with the right size and type, it's written
+   *                            without allocating.
+   */
+  void RotateImage(const cv::Mat& image, int32_t quarter_turns, cv::Mat& rotated);
+
+  /**
+   * Warps images for perspective distortion like WarpImage(), caching the
+   * warp as fixed-point remap tables.
+   *
+   * The tables are rebuilt only when the image size changes or the pitch or
+   * roll move far enough from the values they were built with to shift the
+   * warp by more than a tolerance in pixels, so for a mounted camera the
+   * per-frame cost is a single remap.
+   */
+  class ImageWarper
+  {
+  public:
+    /**
+     * @param[in]  tolerance  The largest displacement (pixels) of the warp
+     *                        that a change in pitch or roll can cause
+     *                        before the remap tables are rebuilt.
+     * @param[in]  threads    The number of threads to split the remap
+     *                        across.  The threads are created once and
+     *                        reused for every image.
+     */
+    explicit ImageWarper(double tolerance = 0.1, int32_t threads = 1);
+
+    /**
+     * Warps an image.
+     *
+     * @param[in]  image   The image to warp
+     * @param[in]  roll    The roll used to warp the image
+     * @param[in]  pitch   The pitch used to warp the image
+     * @param[out] warped  The warped image.  Reused without allocating if
+     *                     it already has the right size and type.
+     */
+    void Warp(const cv::Mat& image, double roll, double pitch, cv::Mat& warped);
+
+    /**
+     * Warps an image.
+     *
+     * @param[in]  image   The image to warp
+     * @param[in]  roll    The roll used to warp the image
+     * @param[in]  pitch   The pitch used to warp the image
+     *
+     * @returns The warped image.
+     */
+    cv::Mat Warp(const cv::Mat& image, double roll, double pitch);
+
+    /**
+     * @returns The number of times the remap tables have been built.
+     */
+    int32_t BuildCount() const { return build_count_; }
+
+  private:
+    void BuildMaps(const cv::Size& size, double roll, double pitch);
+
+    static void RemapRows(
+        int32_t row_start,
+        int32_t row_end,
+        const cv::Mat& image,
+        const cv::Mat& map1,
+        const cv::Mat& map2,
+        cv::Mat& warped);
+
+    static void RemapBand(
+        const cv::Mat& image,
+        const cv::Mat& map1,
+        const cv::Mat& map2,
+        cv::Mat& warped,
+        int32_t band,
+        int32_t bands);
+
+    double tolerance_;
+
+    // Only created for more than one thread.
+    boost::shared_ptr<WorkerPool> pool_;
+
+    bool valid_;
+    cv::Size size_;
+    double roll_;
+    double pitch_;
+    int32_t build_count_;
+
+    cv::Mat map1_;
+    cv::Mat map2_;
+  };
+
+  /**
+   * Gets the homography that WarpPoints() applies to points for a given
+   * pitch and roll.
+   *
+   * @param[in]  pitch      The pitch used to warp the points
+   * @param[in]  roll       The roll used to warp the points
+   * @param[in]  image_size The size of the (unwarped) image
+   *
+   * @returns The 3x3 homography (CV_64F).
+   */
+  cv::Mat GetPointWarp(double pitch, double roll, const cv::Size& image_size);
+
   /**
    * Warps a matrix of points (in the same form as the inliers)
    *
@@ -128,13 +237,56 @@ namespace image_util
      * @brief      Estimates the nominal pitch and roll of the camera (from
      *             perfectly vertical) from two overlapping images.
      *
-     * @return     Returns the rotation matrix for the computed pitch and roll
+     * The pitch and roll are found with a coarse to fine grid search.  The
+     * cells of each grid are evaluated in parallel, and each cell seeds its
+     * own RANSAC so the result does not depend on the number of threads.
+     *
+     * A worker pool is created for the call.  To reuse the threads across
+     * calls, use the overload that takes a pool.
+     *
+     * @param[in]  points1        Points from first image
+     * @param[in]  points2        Corresponding points from second image
+     * @param[in]  image_size     The size of the image
+     * @param[out] nominal_pitch  The estimated pitch
+     * @param[out] nominal_roll   The estimated roll
+     * @param[in]  threads        The number of threads to use, or 0 to use
+     *                            one per core
+     * @param[in]  refine         If true, the finer levels of the grid search
+     *                            are replaced with a Nelder-Mead search
+     *
+     * @return     Returns the rigid transform between the warped points
+     */
+    static cv::Mat EstimateNominalAngle(const cv::Mat& points1,
+                                        const cv::Mat& points2,
+                                        const cv::Size& image_size,
+                                        double& nominal_pitch,
+                                        double& nominal_roll,
+                                        int32_t threads = 0,
+                                        bool refine = false);
+
+    /**
+     * @brief      Estimates the nominal pitch and roll of the camera (from
+     *             perfectly vertical) from two overlapping images, evaluating
+     *             the grid cells on an existing worker pool.
+     *
+     * @param[in]  points1        Points from first image
+     * @param[in]  points2        Corresponding points from second image
+     * @param[in]  image_size     The size of the image
+     * @param[out] nominal_pitch  The estimated pitch
+     * @param[out] nominal_roll   The estimated roll
+     * @param[in]  pool           The threads to evaluate the grid cells on
+     * @param[in]  refine         If true, the finer levels of the grid search
+     *                            are replaced with a Nelder-Mead search
+     *
+     * @return     Returns the rigid transform between the warped points
      */
     static cv::Mat EstimateNominalAngle(const cv::Mat& points1,
                                         const cv::Mat& points2,
                                         const cv::Size& image_size,
                                         double& nominal_pitch,
-                                        double& nominal_roll);
+                                        double& nominal_roll,
+                                        WorkerPool& pool,
+                                        bool refine = false);
 
   private:
     cv::Mat im1_;
@@ -153,6 +305,9 @@ namespace image_util
 
     cv::detail::PlaneWarper warper_;
 
+    // Created on first use and shared by copies of the estimator.
+    boost::shared_ptr<WorkerPool> pool_;
+
     /**
      * @brief      Matches keypoints using loose geometric constraints and
      *             stores them in kp1_matched_ and kp2_matched_
@@ -299,15 +454,59 @@ namespace image_util
     boost::circular_buffer<double> pitches_;
     boost::circular_buffer<double> rolls_;
 
+    // The same samples as the buffers, kept in sorted order so the median
+    // can be updated as samples arrive and expire.
+    std::vector<double> sorted_pitches_;
+    std::vector<double> sorted_rolls_;
+
+    double pitch_sum_;
+    double roll_sum_;
+
+    // The number of samples whose value has been subtracted from the sums
+    // since they were last recomputed from the buffers.
+    int32_t expired_samples_;
+
     double mean_pitch_;
     double mean_roll_;
     double median_pitch_;
     double median_roll_;
 
+    // Created on first use and shared by copies of the queue.
+    boost::shared_ptr<WorkerPool> pool_;
+
     /**
-     * @brief      Computes the statistics on the data in the buffers
+     * @brief      Recomputes the statistics from all of the data in the
+     *             buffers
      */
     void ComputeStats();
+
+    /**
+     * @brief      Updates the means and medians from the sums and sorted
+     *             samples
+     */
+    void UpdateStats();
+
+    /**
+     * @brief      Replaces a value in a sorted vector, keeping it sorted
+     *
+     * @param[in]  sorted       The sorted values
+     * @param[in]  old_value    The value to remove
+     * @param[in]  remove       Whether to remove old_value
+     * @param[in]  new_value    The value to insert
+     */
+    static void ReplaceSorted(std::vector<double>& sorted,
+                              double old_value,
+                              bool remove,
+                              double new_value);
+
+    /**
+     * @brief      Gets the median of a sorted vector
+     *
+     * @param[in]  sorted       The sorted values
+     *
+     * @returns The median, or zero if the vector is empty.
+     */
+    static double Median(const std::vector<double>& sorted);
   };
 }
 
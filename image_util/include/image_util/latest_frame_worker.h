@@ -0,0 +1,157 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef IMAGE_UTIL_LATEST_FRAME_WORKER_H_
+#define IMAGE_UTIL_LATEST_FRAME_WORKER_H_
+
+#include <string>
+
+// Boost Libraries
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+// ROS Libraries
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/Image.h>
+
+namespace image_util
+{
+  /**
+   * Processes images on a dedicated thread, always working on the newest
+   * frame received.
+   *
+   * Subscription callbacks only store the frame, so slow processing doesn't
+   * back up the callback queue of a nodelet manager.  A frame that is
+   * replaced by a newer one before the worker gets to it is dropped.
+   *
+   * The processed and dropped frame counts, and the latency from receiving
+   * a frame to finishing processing it, are published as diagnostics.
+   */
+  class LatestFrameWorker
+  {
+  public:
+    typedef boost::function<void (const sensor_msgs::ImageConstPtr&)> Callback;
+
+    LatestFrameWorker();
+    ~LatestFrameWorker();
+
+    /**
+     * Starts the worker thread.
+     *
+     * @param[in]  name               The name to report diagnostics under.
+     * @param[in]  callback           The function that processes a frame.
+     * @param[in]  node               The node handle to publish diagnostics
+     *                                with.
+     * @param[in]  diagnostic_period  The period between diagnostics updates,
+     *                                in seconds.
+     */
+    void Start(
+        const std::string& name,
+        const Callback& callback,
+        ros::NodeHandle& node,
+        double diagnostic_period = 1.0);
+
+    /**
+     * Stops the worker thread, discarding any pending frame.
+     */
+    void Stop();
+
+    /**
+     * Stores a frame for processing, dropping any frame that hasn't been
+     * processed yet.  Frames are ignored while the worker is stopped.
+     * Suitable as a subscription callback.
+     */
+    void AddFrame(const sensor_msgs::ImageConstPtr& image);
+
+    /**
+     * Subscribes to an image topic, optionally processing the frames on the
+     * worker thread instead of on the subscriber's callback queue.
+     *
+     * @param[in]  it          The image transport to subscribe with.
+     * @param[in]  topic       The image topic.
+     * @param[in]  callback    The function that processes a frame.
+     * @param[in]  use_worker  If true, the worker is started and frames are
+     *                         passed to it, dropping stale frames.  Otherwise
+     *                         the callback is subscribed directly.
+     * @param[in]  name        The name to report diagnostics under.
+     * @param[in]  node        The node handle to publish diagnostics with.
+     *
+     * @returns The subscriber.
+     */
+    image_transport::Subscriber Subscribe(
+        image_transport::ImageTransport& it,
+        const std::string& topic,
+        const Callback& callback,
+        bool use_worker,
+        const std::string& name,
+        ros::NodeHandle& node);
+
+    /**
+     * @returns The number of frames processed since the worker was started.
+     */
+    int32_t ProcessedCount();
+
+    /**
+     * @returns The number of frames dropped since the worker was started.
+     */
+    int32_t DroppedCount();
+
+  private:
+    void Run();
+    void PublishDiagnostics(const ros::WallTime& now);
+
+    std::string name_;
+    Callback callback_;
+    double diagnostic_period_;
+    ros::Publisher diagnostic_pub_;
+
+    boost::thread thread_;
+    boost::mutex mutex_;
+    boost::condition_variable condition_;
+    bool running_;
+
+    sensor_msgs::ImageConstPtr pending_;
+    ros::WallTime pending_time_;
+
+    // Statistics since the last diagnostics update.
+    ros::WallTime last_diagnostic_time_;
+    int32_t processed_;
+    int32_t dropped_;
+    double total_latency_;
+    double max_latency_;
+    double total_age_;
+
+    // Statistics since the worker was started.
+    int32_t total_processed_;
+    int32_t total_dropped_;
+  };
+}
+
+#endif  // IMAGE_UTIL_LATEST_FRAME_WORKER_H_
@@ -48,6 +48,8 @@
 #include <lapackpp.h>
 #include <gfqrc.h>
 
+#include <image_util/worker_pool.h>
+
 namespace image_util
 {
   cv::Mat LeastSqauresRigid2DTransform(
@@ -135,6 +137,77 @@ namespace image_util
       int32_t max_iterations=4000,
       double max_error = 20.0);
 
+  /**
+   * @brief Computes the rigid planar transformation given the points passed
+   *        in, running the RANSAC iterations in parallel
+   *
+   * Each RANSAC iteration draws its sample from a generator seeded from seed
+   * and the iteration number, and the threads share the best consensus set
+   * and the escape criterion.  The result is deterministic for a given seed
+   * regardless of the number of threads.
+   *
+   * A worker pool is created for the call.  To reuse the threads across
+   * calls, use the overload that takes a pool.
+   *
+   * @param[in]  points1         The source points, as for
+   *                             ComputeRigid2DTransform()
+   * @param[in]  points2         The destination points
+   * @param[out] inliers1        The inlier source points which support the
+   *                             transform.
+   * @param[out] inliers2        The inlier destination points which support
+   *                             the transform.
+   * @param[out] good_points     The indices of the inliers
+   * @param[in]  max_iterations  Max RANSAC iterations.
+   * @param[in]  max_error       The inlier distance threshold.
+   * @param[in]  seed            The seed for the RANSAC samples.
+   * @param[in]  threads         The number of threads to use, or 0 to use
+   *                             one per core.
+   *
+   * @retval  Returns the transformation matrix, which will be empty if no valid
+   *          transformation was found
+   */
+  cv::Mat ComputeRigid2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      std::vector<uint32_t> &good_points,
+      int32_t max_iterations,
+      double max_error,
+      uint32_t seed,
+      int32_t threads = 0);
+
+  /**
+   * @brief Computes the rigid planar transformation given the points passed
+   *        in, running the RANSAC iterations on an existing worker pool
+   *
+   * @param[in]  points1         The source points, as for
+   *                             ComputeRigid2DTransform()
+   * @param[in]  points2         The destination points
+   * @param[out] inliers1        The inlier source points which support the
+   *                             transform.
+   * @param[out] inliers2        The inlier destination points which support
+   *                             the transform.
+   * @param[out] good_points     The indices of the inliers
+   * @param[in]  max_iterations  Max RANSAC iterations.
+   * @param[in]  max_error       The inlier distance threshold.
+   * @param[in]  seed            The seed for the RANSAC samples.
+   * @param[in]  pool            The threads to run the iterations on.
+   *
+   * @retval  Returns the transformation matrix, which will be empty if no valid
+   *          transformation was found
+   */
+  cv::Mat ComputeRigid2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      std::vector<uint32_t> &good_points,
+      int32_t max_iterations,
+      double max_error,
+      uint32_t seed,
+      WorkerPool& pool);
+
   /**
    * @brief Computes the rigid planar transformation given the points passed in
    *
@@ -220,6 +293,31 @@ namespace image_util
       cv::Mat& T_rigid,
       double& rms_error);
 
+  /**
+   * @brief      Computes an Affine Transformation, drawing the RANSAC samples
+   *             from a private generator so that the result is reproducible
+   *             and the function can be called from several threads at once.
+   *
+   * @param[in]  points1
+   * @param[in]  points2
+   * @param[out] inliers1
+   * @param[out] inliers2
+   * @param[out] T_rigid
+   * @param[out] rms_error    The RMS (distance) error for inlier points using
+   *                          the rigid transform
+   * @param[in]  seed         The seed for the sample generator
+   *
+   * @return
+   */
+  cv::Mat ComputeLooseAffine2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      cv::Mat& T_rigid,
+      double& rms_error,
+      uint32_t seed);
+
 
   /**
    * @brief Computes the rigid 3D (6DOF) transformation given the points passed
@@ -244,6 +342,51 @@ namespace image_util
    */
   cv::Mat ComputeRigid3DTransform(cv::Mat& points1, cv::Mat& points2);
 
+  /**
+   * @brief Computes the rigid 3D (6DOF) transformation given the points passed
+   *        in, running the RANSAC iterations in parallel
+   *
+   * Each RANSAC iteration draws its sample from a generator seeded from seed
+   * and the iteration number, and the threads share the best consensus set
+   * and the escape criterion.  The result is deterministic for a given seed
+   * regardless of the number of threads.
+   *
+   * A worker pool is created for the call.  To reuse the threads across
+   * calls, use the overload that takes a pool.
+   *
+   * @param[in]  points1  The source points, as for ComputeRigid3DTransform()
+   * @param[in]  points2  The destination points
+   * @param[in]  seed     The seed for the RANSAC samples.
+   * @param[in]  threads  The number of threads to use, or 0 to use one per
+   *                      core.
+   *
+   * @retval  Returns the transformation matrix, which will be empty if no valid
+   *          transformation was found
+   */
+  cv::Mat ComputeRigid3DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      uint32_t seed,
+      int32_t threads = 0);
+
+  /**
+   * @brief Computes the rigid 3D (6DOF) transformation given the points passed
+   *        in, running the RANSAC iterations on an existing worker pool
+   *
+   * @param[in]  points1  The source points, as for ComputeRigid3DTransform()
+   * @param[in]  points2  The destination points
+   * @param[in]  seed     The seed for the RANSAC samples.
+   * @param[in]  pool     The threads to run the iterations on.
+   *
+   * @retval  Returns the transformation matrix, which will be empty if no valid
+   *          transformation was found
+   */
+  cv::Mat ComputeRigid3DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      uint32_t seed,
+      WorkerPool& pool);
+
   /**
    * @brief  Converts the rotation matrix portion of a non-rigid transform
    *         matrix to one with the the "nearest" orthonormal rotation matrix
@@ -297,6 +440,24 @@ namespace image_util
       uint32_t total_samples,
       std::vector<uint32_t>& indices);
 
+  /**
+   * @brief  Generates a set of non-repeating indices from set of ordered
+   *         integers using a caller owned generator state instead of the
+   *         global rand() state.
+   *
+   * @param[in]     max_num             Maximum number from which to draw
+   *                                    samples
+   * @param[in]     total_samples       Total number of samples to draw
+   * @param[out]    indices             A vector of indices
+   * @param[in,out] seed                The generator state, which is advanced
+   *                                    by each sample drawn
+   */
+  void RandPermSet(
+      uint32_t max_num,
+      uint32_t total_samples,
+      std::vector<uint32_t>& indices,
+      uint32_t& seed);
+
   /**
    * @brief  Extracts the rotation matrix from a transformation matrix
    *
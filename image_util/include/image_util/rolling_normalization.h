@@ -32,6 +32,9 @@
 
 #include <vector>
 
+// Boost Libraries
+#include <boost/thread.hpp>
+
 // ROS Libraries
 #include <ros/ros.h>
 
@@ -44,15 +47,95 @@ namespace image_util
   class RollingNormalization
   {
   public:
+    /**
+     * Creates a rolling normalization that averages and blurs at full
+     * resolution, recomputing the normalization image on every sample.
+     *
+     * @param[in]  size  The number of samples in the rolling average.
+     */
     RollingNormalization(int32_t size);
+
+    /**
+     * Creates a rolling normalization that keeps the running average at a
+     * reduced resolution in single precision.
+     *
+     * The normalization image is very smooth, so the blurs are run on the
+     * reduced resolution average, with kernels scaled to match, and the
+     * result is upsampled to the image size and cached between updates.
+     *
+     * @param[in]  size             The number of samples in the rolling
+     *                              average.
+     * @param[in]  decimation       The factor by which each image dimension
+     *                              is reduced.
+     * @param[in]  update_interval  The number of samples between updates of
+     *                              the normalization image.
+     * @param[in]  background       If true, updates are computed on a
+     *                              background thread and AddSample() returns
+     *                              the most recently completed result.
+     */
+    RollingNormalization(
+        int32_t size,
+        int32_t decimation,
+        int32_t update_interval,
+        bool background);
+
     ~RollingNormalization();
     
     cv::Mat AddSample(const cv::Mat& image);
+
+    /**
+     * Waits for any pending background update of the normalization image to
+     * complete.
+     *
+     * @returns The most recently computed normalization image.
+     */
+    cv::Mat WaitForUpdate();
   private:
+    cv::Mat AddReducedSample(const cv::Mat& image);
+
+    /**
+     * Computes a full resolution normalization image from a reduced
+     * resolution average.
+     *
+     * @param[in]  average     The reduced resolution average (CV_32F).
+     * @param[in]  decimation  The decimation factor of the average.
+     * @param[in]  size        The full resolution image size.
+     *
+     * @returns The normalization image (CV_8U).
+     */
+    static cv::Mat ComputeNormImage(
+        const cv::Mat& average,
+        int32_t decimation,
+        const cv::Size& size);
+
+    void UpdateThread();
+
     int32_t max_size_;
     int32_t samples_;
+
+    // True until the first sample after a restart has been added.  The
+    // sample count can't be used for this since it stays at 1 when the
+    // rolling average only has room for one sample.
+    bool restarted_;
+
     cv::Mat average_image_;
     cv::Mat norm_image_;
+
+    bool reduced_;
+    int32_t decimation_;
+    int32_t update_interval_;
+    bool background_;
+    int32_t samples_since_update_;
+    cv::Size image_size_;
+
+    boost::thread update_thread_;
+    boost::mutex mutex_;
+    boost::condition_variable update_condition_;
+    boost::condition_variable idle_condition_;
+    bool update_pending_;
+    bool updating_;
+    bool stopping_;
+    cv::Mat pending_average_;
   };
 }
 
@@ -0,0 +1,142 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef IMAGE_UTIL_TILE_STATS_H_
+#define IMAGE_UTIL_TILE_STATS_H_
+
+#include <vector>
+
+// ROS Libraries
+#include <ros/ros.h>
+
+// OpenCV Libraries
+#include <opencv2/core/core.hpp>
+
+namespace image_util
+{
+  /**
+   * Computes the minimum and maximum pixel values of a grid of image tiles.
+   *
+   * For a grid size of N, the image is divided into N x N bins and a tile of
+   * the size of one bin is centered on each of the (N + 1) x (N + 1) bin
+   * corners, clipped to the image bounds.  All tiles are computed in a single
+   * pass over the image, honoring an optional mask.
+   *
+   * The tile layout is cached, so reusing the same object for a sequence of
+   * images of the same size and grid only costs the pass over the pixels,
+   * even when the mask changes from frame to frame.
+   */
+  class TileStats
+  {
+  public:
+    TileStats();
+
+    /**
+     * Computes the tile minimums and maximums of an image.
+     *
+     * Tiles with no unmasked pixels have a minimum and maximum of 0.
+     *
+     * @param[in]  grid_size  The number of bins along each image axis.
+     * @param[in]  image      The image (CV_8UC1).
+     * @param[in]  mask       An optional mask (CV_8UC1, same size as the
+     *                        image).  Pixels where the mask is 0 are ignored.
+     *
+     * @returns True if successful.  Fails if the image or mask are invalid,
+     *          or if the grid is finer than the image.
+     */
+    bool Calculate(
+        int32_t grid_size,
+        const cv::Mat& image,
+        const cv::Mat& mask = cv::Mat());
+
+    /**
+     * The tile minimums from the last successful Calculate() call, as a
+     * (grid_size + 1) x (grid_size + 1) CV_64F matrix.
+     */
+    const cv::Mat& Minimums() const { return min_values_; }
+
+    /**
+     * The tile maximums from the last successful Calculate() call, as a
+     * (grid_size + 1) x (grid_size + 1) CV_64F matrix.
+     */
+    const cv::Mat& Maximums() const { return max_values_; }
+
+    int32_t GridSize() const { return grid_size_; }
+    int32_t BinWidth() const { return bin_width_; }
+    int32_t BinHeight() const { return bin_height_; }
+
+  private:
+    /**
+     * Updates the cached tile layout if the grid size or image size changed.
+     *
+     * @returns False if the grid is finer than the image.
+     */
+    bool UpdateLayout(int32_t grid_size, const cv::Size& size);
+
+    /**
+     * Splits one image axis into the segments bounded by the tile edges.
+     *
+     * @param[in]  tiles          The number of tiles along the axis.
+     * @param[in]  bin_size       The bin size along the axis.
+     * @param[in]  length         The image size along the axis.
+     * @param[out] bounds         The sorted segment boundaries.
+     * @param[out] first_segment  The first segment of each tile.
+     * @param[out] end_segment    One past the last segment of each tile.
+     */
+    static void Partition(
+        int32_t tiles,
+        int32_t bin_size,
+        int32_t length,
+        std::vector<int32_t>& bounds,
+        std::vector<int32_t>& first_segment,
+        std::vector<int32_t>& end_segment);
+
+    int32_t grid_size_;
+    cv::Size size_;
+    int32_t bin_width_;
+    int32_t bin_height_;
+
+    std::vector<int32_t> col_bounds_;
+    std::vector<int32_t> col_first_;
+    std::vector<int32_t> col_end_;
+    std::vector<int32_t> row_bounds_;
+    std::vector<int32_t> row_first_;
+    std::vector<int32_t> row_end_;
+
+    // Statistics of each cell formed by a row segment and a column segment.
+    std::vector<uint8_t> cell_min_;
+    std::vector<uint8_t> cell_max_;
+    std::vector<uint8_t> cell_valid_;
+
+    cv::Mat min_values_;
+    cv::Mat max_values_;
+  };
+}
+
+#endif  // IMAGE_UTIL_TILE_STATS_H_
@@ -0,0 +1,100 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef IMAGE_UTIL_WORKER_POOL_H_
+#define IMAGE_UTIL_WORKER_POOL_H_
+
+#include <stdint.h>
+
+// Boost Libraries
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace image_util
+{
+  /**
+   * A fixed set of threads that run a job together and wait for it to
+   * finish.
+   *
+   * The threads are created once and reused for every job, so splitting
+   * small pieces of work across them doesn't pay for creating and joining
+   * threads each time.
+   */
+  class WorkerPool
+  {
+  public:
+    /**
+     * The job to run.  It's called once per thread with the index of the
+     * thread and the number of threads.
+     */
+    typedef boost::function<void (int32_t, int32_t)> Job;
+
+    /**
+     * @param[in]  threads  The number of threads, including the one that
+     *                      calls Run(), or 0 to use one per core.
+     */
+    explicit WorkerPool(int32_t threads = 0);
+    ~WorkerPool();
+
+    /**
+     * @returns The number of threads, including the one that calls Run().
+     */
+    int32_t Size() const { return size_; }
+
+    /**
+     * Runs a job on every thread and waits for all of them to finish.  The
+     * calling thread runs it with index 0.  Concurrent calls run one after
+     * another.
+     *
+     * @param[in]  job  The job to run.
+     */
+    void Run(const Job& job);
+
+  private:
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+
+    void Work(int32_t index);
+
+    int32_t size_;
+    boost::thread_group threads_;
+
+    boost::mutex run_mutex_;
+    boost::mutex mutex_;
+    boost::condition_variable start_condition_;
+    boost::condition_variable done_condition_;
+
+    Job job_;
+    uint64_t generation_;
+    int32_t pending_;
+    bool stopping_;
+  };
+}
+
+#endif  // IMAGE_UTIL_WORKER_POOL_H_
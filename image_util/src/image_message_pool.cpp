@@ -0,0 +1,89 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <image_util/image_message_pool.h>
+
+#include <boost/make_shared.hpp>
+
+namespace image_util
+{
+  ImageMessagePool::ImageMessagePool(size_t max_size) :
+    max_size_(max_size)
+  {
+  }
+
+  sensor_msgs::ImagePtr ImageMessagePool::Get(
+      const std_msgs::Header& header,
+      const std::string& encoding,
+      const cv::Size& size,
+      int type,
+      cv::Mat& image)
+  {
+    sensor_msgs::ImagePtr message;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      for (size_t i = 0; i < messages_.size(); i++)
+      {
+        if (messages_[i].unique())
+        {
+          message = messages_[i];
+          break;
+        }
+      }
+
+      if (!message)
+      {
+        message = boost::make_shared<sensor_msgs::Image>();
+        if (messages_.size() < max_size_)
+        {
+          messages_.push_back(message);
+        }
+      }
+    }
+
+    message->header = header;
+    message->encoding = encoding;
+    message->is_bigendian = false;
+    message->height = size.height;
+    message->width = size.width;
+    message->step = size.width * CV_ELEM_SIZE(type);
+    message->data.resize(message->step * message->height);
+
+    if (message->data.empty())
+    {
+      image = cv::Mat(size, type);
+    }
+    else
+    {
+      image = cv::Mat(size.height, size.width, type, &message->data[0], message->step);
+    }
+
+    return message;
+  }
+}
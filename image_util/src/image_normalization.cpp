@@ -35,8 +35,20 @@
 
 #include <image_util/image_normalization.h>
 
+#include <algorithm>
+#include <cmath>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
 namespace image_util
 {
+  /**
+   * The minimum number of rows given to each thread when an image is split
+   * across threads.
+   */
+  static const int32_t _min_rows_per_thread = 64;
+
   void normalize_illumination(cv::Mat NormImage,
                               cv::Mat SourceImage,
                               cv::Mat& DestImage)
@@ -46,59 +58,162 @@ namespace image_util
     cv::Mat tempIm1;
     SourceImage.convertTo(tempIm1, CV_32FC1, 1.0, 0.0);
     cv::divide(tempIm1, NormImage, tempIm1, 1.0);
-    cv::Mat firstImage;
-    cv::Mat secondImage;
     tempIm1.convertTo(DestImage, CV_8UC1);
   }
 
-  cv::Mat generate_normalization_image(const std::vector<cv::Mat>& image_list)
+  NormalizationApplier::NormalizationApplier()
   {
-    cv::Mat norm_image;
-    if (image_list.empty())
+  }
+
+  NormalizationApplier::NormalizationApplier(
+      const cv::Mat& norm_image,
+      int32_t threads)
+  {
+    if (threads > 1)
     {
-      return cv::Mat();
+      pool_.reset(new WorkerPool(threads));
     }
 
-    const cv::Mat& rep_im = image_list.front();
-
-    cv::Mat image_sum(cv::Size(rep_im.cols, rep_im.rows), CV_64F);
+    SetNormImage(norm_image);
+  }
 
-    for (uint32_t i = 0; i < image_list.size(); i++)
+  bool NormalizationApplier::SetNormImage(const cv::Mat& norm_image)
+  {
+    double scale;
+    if (norm_image.type() == CV_32FC1)
     {
-      cv::Mat temp_im;
-      image_list[i].convertTo(temp_im, CV_64F, 1.0, 0.0);
-
-      image_sum = image_sum + temp_im;
+      scale = 1.0;
+    }
+    else if (norm_image.type() == CV_8UC1)
+    {
+      scale = 1.0 / 255.0;
+    }
+    else
+    {
+      ROS_ERROR("Normalization image must be of type CV_32FC1 or CV_8UC1.");
+      gain_.release();
+      return false;
     }
 
-    image_sum = image_sum / static_cast<double>(image_list.size());
+    // Gains are capped at 255, beyond which every non-zero pixel saturates
+    // anyway; this also covers normalization values of 0.
+    const double max_gain = 255.0;
+    gain_.create(norm_image.size(), CV_32SC1);
+    for (int32_t i = 0; i < norm_image.rows; i++)
+    {
+      uint32_t* gain = gain_.ptr<uint32_t>(i);
+      for (int32_t j = 0; j < norm_image.cols; j++)
+      {
+        double value = (norm_image.type() == CV_32FC1) ?
+            norm_image.at<float>(i, j) : norm_image.at<uint8_t>(i, j);
+        value *= scale;
 
-    cv::Mat mean_image;
-    image_sum.convertTo(mean_image, CV_8U);
-    cv::Mat temp_norm_image;
+        double g = (value > 1.0 / max_gain) ? 1.0 / value : max_gain;
+        gain[j] = static_cast<uint32_t>(g * 65536.0 + 0.5);
+      }
+    }
 
-    cv::medianBlur(mean_image, temp_norm_image, 45);
+    return true;
+  }
 
-    cv::Mat temp_norm_image2;
-    temp_norm_image.convertTo(temp_norm_image2, CV_32F);
-    double max1 = 0;
-    for (int32_t i = 0; i < temp_norm_image2.rows; i++)
+  void NormalizationApplier::ApplyRows(
+      int32_t row_start,
+      int32_t row_end,
+      const cv::Mat& gain,
+      const cv::Mat& source_image,
+      cv::Mat& dest_image)
+  {
+    const int32_t cols = source_image.cols;
+    for (int32_t i = row_start; i < row_end; i++)
     {
-      for (int32_t j = 0; j < temp_norm_image2.cols; j++)
+      const uint32_t* row_gain = gain.ptr<uint32_t>(i);
+      const uint8_t* src = source_image.ptr<uint8_t>(i);
+      uint8_t* dst = dest_image.ptr<uint8_t>(i);
+
+      // 255 * (255 << 16) still fits in 32 bits unsigned, so the product
+      // can't overflow.
+      for (int32_t j = 0; j < cols; j++)
       {
-        if (temp_norm_image2.at<float>(i, j) > max1)
-        {
-          max1 = temp_norm_image2.at<float>(i, j);
-        }
+        uint32_t value = (src[j] * row_gain[j] + 32768) >> 16;
+        dst[j] = static_cast<uint8_t>(std::min(value, 255u));
       }
     }
+  }
 
-    temp_norm_image2 = temp_norm_image2 * (255.0 / max1);
+  void NormalizationApplier::ApplyBand(
+      const cv::Mat& gain,
+      const cv::Mat& source_image,
+      cv::Mat& dest_image,
+      int32_t band,
+      int32_t bands)
+  {
+    int32_t rows = source_image.rows;
+    bands = std::max(1, std::min(bands, rows / _min_rows_per_thread));
+    if (band >= bands)
+    {
+      return;
+    }
 
-    cv::Mat temp_norm_image3;
-    temp_norm_image2.convertTo(temp_norm_image3, CV_8U, 1.0, 0.0);
+    ApplyRows(
+        (rows * band) / bands,
+        (rows * (band + 1)) / bands,
+        gain,
+        source_image,
+        dest_image);
+  }
+
+  bool NormalizationApplier::Apply(
+      const cv::Mat& source_image,
+      cv::Mat& dest_image) const
+  {
+    if (gain_.empty())
+    {
+      ROS_ERROR("Normalization image not set.");
+      return false;
+    }
 
+    if (source_image.type() != CV_8UC1 || source_image.size() != gain_.size())
+    {
+      ROS_ERROR("Image must be CV_8UC1 and %dx%d to be normalized.",
+          gain_.cols, gain_.rows);
+      return false;
+    }
 
+    dest_image.create(source_image.size(), CV_8UC1);
+
+    if (!pool_)
+    {
+      ApplyRows(0, source_image.rows, gain_, source_image, dest_image);
+      return true;
+    }
+
+    pool_->Run(boost::bind(
+        &NormalizationApplier::ApplyBand,
+        boost::cref(gain_),
+        boost::cref(source_image),
+        boost::ref(dest_image),
+        _1,
+        _2));
+
+    return true;
+  }
+
+  /**
+   * Computes a normalization image from the mean (or median) of a set of
+   * images by median filtering, scaling to full range, and smoothing.
+   */
+  static cv::Mat smooth_normalization_image(const cv::Mat& mean_image)
+  {
+    cv::Mat temp_norm_image;
+    cv::medianBlur(mean_image, temp_norm_image, 45);
+
+    double max1 = 0;
+    cv::minMaxLoc(temp_norm_image, 0, &max1);
+
+    cv::Mat temp_norm_image3;
+    temp_norm_image.convertTo(temp_norm_image3, CV_8U, 255.0 / max1, 0.0);
+
+    cv::Mat norm_image;
     cv::GaussianBlur(temp_norm_image3,
                      norm_image,
                      cv::Size(25, 25),
@@ -107,95 +222,293 @@ namespace image_util
 
     return norm_image;
   }
-  
-  void ContrastStretch(
-    int32_t grid_size, 
-    const cv::Mat& source_image,
-    cv::Mat& dest_image,
-    const cv::Mat& mask)
-  {   
-    int x_bin_w = std::floor(static_cast<double>(source_image.cols) / grid_size);
-    int y_bin_h = std::floor(static_cast<double>(source_image.rows) / grid_size);
-    
-    //ROS_ERROR("x_bin_w:%d  y_bin_h:%d", x_bin_w, y_bin_h);
-    
-    cv::Mat max_vals(grid_size + 1, grid_size + 1, CV_64F);
-    cv::Mat min_vals(grid_size + 1, grid_size + 1, CV_64F);
-    
-    bool has_mask = !mask.empty();
-    
-    for(int i = 0; i < grid_size + 1; i++)
-    {
-      for(int j = 0; j < grid_size + 1; j++)
+
+  cv::Mat generate_normalization_image(const std::vector<cv::Mat>& image_list)
+  {
+    NormalizationImageAccumulator accumulator;
+    for (uint32_t i = 0; i < image_list.size(); i++)
+    {
+      accumulator.Add(image_list[i]);
+    }
+
+    return accumulator.Finalize();
+  }
+
+  NormalizationImageAccumulator::NormalizationImageAccumulator(Mode mode) :
+    mode_(mode),
+    count_(0)
+  {
+  }
+
+  bool NormalizationImageAccumulator::Add(const cv::Mat& image)
+  {
+    if (image.depth() != CV_8U)
+    {
+      ROS_ERROR("Normalization images can only be generated from 8-bit images.");
+      return false;
+    }
+
+    if (count_ == 0)
+    {
+      if (mode_ == MEDIAN)
       {
-        double minVal = 0;
-        double maxVal = 255;
-        
-        cv::Rect roi = cv::Rect(j * x_bin_w  - x_bin_w / 2,
-                       i * y_bin_h - y_bin_h / 2, x_bin_w, y_bin_h);
-        roi.x = std::max(0, roi.x);
-        roi.y = std::max(0, roi.y);
-        roi.width = std::min(source_image.cols - roi.x, roi.width);
-        roi.height = std::min(source_image.rows - roi.y, roi.height);
-                       
-        if (has_mask)
-        {
-          //ROS_ERROR("x:%d  y:%d  w:%d  h:%d", roi.x, roi.y, roi.width, roi.height);
-          cv::minMaxLoc(source_image(roi), &minVal, &maxVal, 0, 0, mask(roi));
-        }
-        else
+        image.copyTo(median_);
+      }
+      else
+      {
+        sum_ = cv::Mat::zeros(image.size(), CV_MAKETYPE(CV_64F, image.channels()));
+        cv::accumulate(image, sum_);
+      }
+      count_++;
+      return true;
+    }
+
+    const cv::Mat& reference = (mode_ == MEDIAN) ? median_ : sum_;
+    if (image.size() != reference.size() ||
+        image.channels() != reference.channels())
+    {
+      ROS_ERROR("Normalization image size mismatch: %dx%d vs %dx%d.",
+          image.cols, image.rows, reference.cols, reference.rows);
+      return false;
+    }
+
+    if (mode_ == MEDIAN)
+    {
+      int32_t values = image.cols * image.channels();
+      for (int32_t i = 0; i < image.rows; i++)
+      {
+        const uint8_t* sample = image.ptr<uint8_t>(i);
+        uint8_t* median = median_.ptr<uint8_t>(i);
+        for (int32_t j = 0; j < values; j++)
         {
-          cv::minMaxLoc(source_image(roi), &minVal, &maxVal, 0, 0);
+          median[j] += (sample[j] > median[j]) - (sample[j] < median[j]);
         }
-        max_vals.at<double>(i, j) = maxVal;
-        min_vals.at<double>(i, j) = minVal;
       }
     }
+    else
+    {
+      cv::accumulate(image, sum_);
+    }
+
+    count_++;
+    return true;
+  }
+
+  cv::Mat NormalizationImageAccumulator::Finalize() const
+  {
+    if (count_ == 0)
+    {
+      return cv::Mat();
+    }
+
+    cv::Mat mean_image;
+    if (mode_ == MEDIAN)
+    {
+      mean_image = median_;
+    }
+    else
+    {
+      sum_.convertTo(mean_image, CV_8U, 1.0 / count_, 0.0);
+    }
+
+    return smooth_normalization_image(mean_image);
+  }
 
-    // Stretch contrast accordingly
-    for(int i = 0; i < source_image.rows; i++)
+  void NormalizationImageAccumulator::Reset()
+  {
+    count_ = 0;
+    sum_.release();
+    median_.release();
+  }
+
+  /**
+   * Stretches a range of rows of an image using the interpolated grid of
+   * tile maxima computed by ContrastStretch().
+   *
+   * Each row is processed in two passes: the interpolated maximum is built
+   * incrementally across the row in 16.16 fixed-point, and then each pixel is
+   * scaled and clamped in a simple loop over contiguous buffers.
+   */
+  static void ContrastStretchRows(
+      int32_t row_start,
+      int32_t row_end,
+      int32_t grid_size,
+      int32_t x_bin_w,
+      int32_t y_bin_h,
+      const cv::Mat& max_vals,
+      const cv::Mat& source_image,
+      cv::Mat& dest_image)
+  {
+    const int32_t cols = source_image.cols;
+    const double w = x_bin_w;
+    const double h = y_bin_h;
+
+    std::vector<double> knots(grid_size + 1);
+    std::vector<float> row_max(cols);
+
+    for (int32_t i = row_start; i < row_end; i++)
     {
-      int ii = i / y_bin_h;
-      double py = (i - ii * y_bin_h) / ((double) y_bin_h);
+      // Interpolate the grid vertically for this row.  Rows past the last
+      // full tile use the last row of the grid.
+      int32_t ii = std::min(i / y_bin_h, grid_size - 1);
+      double py = std::min(1.0, (i - ii * y_bin_h) / h);
 
-      for(int j = 0; j < source_image.cols; j++)
+      const double* max0 = max_vals.ptr<double>(ii);
+      const double* max1 = max_vals.ptr<double>(ii + 1);
+      for (int32_t jj = 0; jj <= grid_size; jj++)
       {
-        // Find relevant min and max values
-        int jj = j / x_bin_w;
-
-        // Stretch histogram
-        //double minVal = min_vals.at<double>(ii, jj);
-        double maxVal = max_vals.at<double>(ii, jj);
-
-        // interp x
-        double px = (j - jj * x_bin_w) / ((double) x_bin_w);
-
-        //4-point interpolation
-        double xM1 = maxVal + px * (max_vals.at<double>(ii, jj+1) - maxVal);
-        double xM2 = max_vals.at<double>(ii+1, jj) + px * (max_vals.at<double>(ii+1, jj+1) - max_vals.at<double>(ii+1, jj));
-        double M = xM1 + py * (xM2 - xM1);
-
-        //double xm1 = minVal + px*(min_vals.at<double>(ii, jj+1) - minVal);
-        //double xm2 = min_vals.at<double>(ii+1, jj) + px*(min_vals.at<double>(ii+1, jj+1) - min_vals.at<double>(ii+1, jj));
-        //double m = xm1 + py*(xm2 - xm1);
-        //minVal = m;
-        maxVal = M;
-
-        if(maxVal > 255) maxVal = 255;
-        //if(minVal < 0) minVal = 0;
-        
-        //minVal = 0; // Care about bringing up brightness rather than full contrast stretching?
-
-        // TODO: put a bound on maxVal (we don't want to stretch a value of 20 all the way to 255)
-        // (same applies to minVal if we aren't setting to 0 above
-
-        double val = source_image.at<uint8_t>(i,j);
-        val = val * 255.0 / maxVal;
-        if(val > 255) val = 255;
-        if(val < 0) val = 0;
-        dest_image.at<uint8_t>(i,j) = val;
+        knots[jj] = max0[jj] + py * (max1[jj] - max0[jj]);
       }
+
+      // Interpolate horizontally in fixed-point, one tile at a time.
+      for (int32_t jj = 0; jj < grid_size; jj++)
+      {
+        int32_t j_start = jj * x_bin_w;
+        int32_t j_end = (jj == grid_size - 1) ? cols : j_start + x_bin_w;
+
+        int32_t value = static_cast<int32_t>(knots[jj] * 65536.0 + 0.5);
+        int32_t step = static_cast<int32_t>(
+            std::floor((knots[jj + 1] - knots[jj]) * 65536.0 / w + 0.5));
+        int32_t end_value = static_cast<int32_t>(knots[jj + 1] * 65536.0 + 0.5);
+
+        for (int32_t j = j_start; j < j_end; j++)
+        {
+          // Columns past the last full tile use the last column of the grid.
+          int32_t fixed = (j - j_start < x_bin_w) ? value : end_value;
+          row_max[j] = fixed * (1.0f / 65536.0f);
+          value += step;
+        }
+      }
+
+      const uint8_t* src = source_image.ptr<uint8_t>(i);
+      uint8_t* dst = dest_image.ptr<uint8_t>(i);
+      for (int32_t j = 0; j < cols; j++)
+      {
+        // The maximum is clamped to [1, 255]: a maximum below 1 means the
+        // pixel is either 0 or saturates anyway.
+        float max_val = std::max(1.0f, std::min(255.0f, row_max[j]));
+        float val = std::min(255.0f, src[j] * 255.0f / max_val);
+        dst[j] = static_cast<uint8_t>(val);
+      }
+    }
+  }
+
+  void ContrastStretch(
+    int32_t grid_size, 
+    const cv::Mat& source_image,
+    cv::Mat& dest_image,
+    const cv::Mat& mask)
+  {
+    TileStats stats;
+    ContrastStretch(grid_size, source_image, dest_image, mask, stats);
+  }
+
+  /**
+   * Stretches one of a number of equal bands of rows of an image.  Bands
+   * past the number that the image can be split into are left empty.
+   */
+  static void ContrastStretchBand(
+      int32_t grid_size,
+      int32_t x_bin_w,
+      int32_t y_bin_h,
+      const cv::Mat& max_vals,
+      const cv::Mat& source_image,
+      cv::Mat& dest_image,
+      int32_t band,
+      int32_t bands)
+  {
+    int32_t rows = source_image.rows;
+    bands = std::max(1, std::min(bands, rows / _min_rows_per_thread));
+    if (band >= bands)
+    {
+      return;
+    }
+
+    ContrastStretchRows(
+        (rows * band) / bands,
+        (rows * (band + 1)) / bands,
+        grid_size,
+        x_bin_w,
+        y_bin_h,
+        max_vals,
+        source_image,
+        dest_image);
+  }
+
+  /**
+   * Computes the tile statistics for a contrast stretch and allocates the
+   * destination image.
+   *
+   * @returns False if the statistics couldn't be computed, in which case the
+   *          source image has been copied to the destination.
+   */
+  static bool PrepareContrastStretch(
+    int32_t grid_size,
+    const cv::Mat& source_image,
+    cv::Mat& dest_image,
+    const cv::Mat& mask,
+    TileStats& stats)
+  {
+    if (!stats.Calculate(grid_size, source_image, mask))
+    {
+      ROS_WARN("Failed to compute contrast stretch grid for a %dx%d image.",
+          source_image.cols, source_image.rows);
+      source_image.copyTo(dest_image);
+      return false;
+    }
+
+    dest_image.create(source_image.size(), CV_8U);
+    return true;
+  }
+
+  void ContrastStretch(
+    int32_t grid_size,
+    const cv::Mat& source_image,
+    cv::Mat& dest_image,
+    const cv::Mat& mask,
+    TileStats& stats)
+  {
+    if (!PrepareContrastStretch(grid_size, source_image, dest_image, mask, stats))
+    {
+      return;
     }
+
+    ContrastStretchRows(0, source_image.rows, grid_size, stats.BinWidth(),
+        stats.BinHeight(), stats.Maximums(), source_image, dest_image);
+  }
+
+  void ContrastStretch(
+    int32_t grid_size,
+    const cv::Mat& source_image,
+    cv::Mat& dest_image,
+    const cv::Mat& mask,
+    TileStats& stats,
+    WorkerPool& pool)
+  {
+    if (!PrepareContrastStretch(grid_size, source_image, dest_image, mask, stats))
+    {
+      return;
+    }
+
+    // Rows are stretched independently, so they're split into bands across
+    // the threads of the pool.
+    if (pool.Size() == 1)
+    {
+      ContrastStretchRows(0, source_image.rows, grid_size, stats.BinWidth(),
+          stats.BinHeight(), stats.Maximums(), source_image, dest_image);
+      return;
+    }
+
+    pool.Run(boost::bind(
+        &ContrastStretchBand,
+        grid_size,
+        stats.BinWidth(),
+        stats.BinHeight(),
+        boost::cref(stats.Maximums()),
+        boost::cref(source_image),
+        boost::ref(dest_image),
+        _1,
+        _2));
   }
 
   cv::Mat scale_2_8bit(const cv::Mat& image)
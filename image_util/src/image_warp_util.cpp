@@ -30,21 +30,160 @@
 #include <image_util/image_warp_util.h>
 
 #include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
 
 namespace image_util
 {
-  cv::Mat WarpImage(const cv::Mat& image, double roll, double pitch)
+  /**
+   * A pixel of N bytes, for copying pixels of any type.
+   */
+  template <int N>
+  struct RawPixel
   {
-    cv::Mat warped;
+    uint8_t bytes[N];
+  };
+
+  /**
+   * Rotates an image by 90, 180 or 270 degrees clockwise.  The 90 and 270
+   * degree cases are processed in square blocks so that both the reads and
+   * the writes stay in cache.
+   */
+  template <typename T>
+  static void RotatePixels(const cv::Mat& image, int32_t quarter_turns, cv::Mat& rotated)
+  {
+    const int32_t block = 32;
+    const int32_t rows = image.rows;
+    const int32_t cols = image.cols;
+
+    if (quarter_turns == 2)
+    {
+      for (int32_t i = 0; i < rows; i++)
+      {
+        const T* src = image.ptr<T>(rows - 1 - i);
+        T* dst = rotated.ptr<T>(i);
+        for (int32_t j = 0; j < cols; j++)
+        {
+          dst[j] = src[cols - 1 - j];
+        }
+      }
+      return;
+    }
+
+    for (int32_t i0 = 0; i0 < rotated.rows; i0 += block)
+    {
+      int32_t i1 = std::min(i0 + block, rotated.rows);
+      for (int32_t j0 = 0; j0 < rotated.cols; j0 += block)
+      {
+        int32_t j1 = std::min(j0 + block, rotated.cols);
+        for (int32_t i = i0; i < i1; i++)
+        {
+          T* dst = rotated.ptr<T>(i);
+          if (quarter_turns == 1)
+          {
+            // dst(i, j) = src(rows - 1 - j, i)
+            for (int32_t j = j0; j < j1; j++)
+            {
+              dst[j] = image.ptr<T>(rows - 1 - j)[i];
+            }
+          }
+          else
+          {
+            // dst(i, j) = src(j, cols - 1 - i)
+            for (int32_t j = j0; j < j1; j++)
+            {
+              dst[j] = image.ptr<T>(j)[cols - 1 - i];
+            }
+          }
+        }
+      }
+    }
+  }
+
+  void RotateImage(const cv::Mat& image, int32_t quarter_turns, cv::Mat& rotated)
+  {
+    quarter_turns = ((quarter_turns % 4) + 4) % 4;
+    if (quarter_turns == 0)
+    {
+      image.copyTo(rotated);
+      return;
+    }
 
+    // The rotation can't be done in place.
+    if (rotated.data == image.data)
+    {
+      cv::Mat temp;
+      RotateImage(image, quarter_turns, temp);
+      rotated = temp;
+      return;
+    }
+
+    if (quarter_turns == 2)
+    {
+      rotated.create(image.rows, image.cols, image.type());
+    }
+    else
+    {
+      rotated.create(image.cols, image.rows, image.type());
+    }
+
+    switch (image.elemSize())
+    {
+      case 1: RotatePixels<RawPixel<1> >(image, quarter_turns, rotated); break;
+      case 2: RotatePixels<RawPixel<2> >(image, quarter_turns, rotated); break;
+      case 3: RotatePixels<RawPixel<3> >(image, quarter_turns, rotated); break;
+      case 4: RotatePixels<RawPixel<4> >(image, quarter_turns, rotated); break;
+      case 6: RotatePixels<RawPixel<6> >(image, quarter_turns, rotated); break;
+      case 8: RotatePixels<RawPixel<8> >(image, quarter_turns, rotated); break;
+      case 12: RotatePixels<RawPixel<12> >(image, quarter_turns, rotated); break;
+      case 16: RotatePixels<RawPixel<16> >(image, quarter_turns, rotated); break;
+      default:
+      {
+        // Fall back to transposing and flipping for unusual pixel sizes.
+        cv::Mat temp = image;
+        for (int32_t i = 0; i < quarter_turns; i++)
+        {
+          cv::transpose(temp, temp);
+          cv::flip(temp, temp, 1);
+        }
+        temp.copyTo(rotated);
+      }
+    }
+  }
+
+  /**
+   * Gets the camera matrix, rotation and translation of the plane warp used
+   * to correct for pitch and roll.
+   */
+  static void GetWarpParameters(
+      const cv::Size& size,
+      double roll,
+      double pitch,
+      cv::Mat& K,
+      cv::Mat& R,
+      cv::Mat& T)
+  {
     // Initialize the camera matrix:
-    cv::Mat K = cv::Mat::eye(cv::Size(3, 3), CV_32F);
-    K.at<float>(0, 2) = static_cast<double>(image.cols - 1) / 2.0;
-    K.at<float>(1, 2) = static_cast<double>(image.rows - 1) / 2.0;
+    K = cv::Mat::eye(cv::Size(3, 3), CV_32F);
+    K.at<float>(0, 2) = static_cast<double>(size.width - 1) / 2.0;
+    K.at<float>(1, 2) = static_cast<double>(size.height - 1) / 2.0;
 
-    cv::Mat T = cv::Mat::zeros(cv::Size(3, 1), CV_32F);
+    T = cv::Mat::zeros(cv::Size(3, 1), CV_32F);
 
-    cv::Mat R = GetR(pitch, roll);
+    R = GetR(pitch, roll);
+  }
+
+  cv::Mat WarpImage(const cv::Mat& image, double roll, double pitch)
+  {
+    cv::Mat warped;
+
+    cv::Mat K;
+    cv::Mat R;
+    cv::Mat T;
+    GetWarpParameters(image.size(), roll, pitch, K, R, T);
 
     cv::detail::PlaneWarper warper;
     warper.warp(image, K, R, T, cv::INTER_LANCZOS4, 0, warped);
@@ -56,6 +195,198 @@ namespace image_util
     return warped;
   }
 
+  ImageWarper::ImageWarper(double tolerance, int32_t threads) :
+    tolerance_(tolerance),
+    valid_(false),
+    roll_(0),
+    pitch_(0),
+    build_count_(0)
+  {
+    if (threads > 1)
+    {
+      pool_.reset(new WorkerPool(threads));
+    }
+  }
+
+  void ImageWarper::BuildMaps(const cv::Size& size, double roll, double pitch)
+  {
+    cv::Mat K;
+    cv::Mat R;
+    cv::Mat T;
+    GetWarpParameters(size, roll, pitch, K, R, T);
+
+    cv::Mat xmap;
+    cv::Mat ymap;
+    cv::detail::PlaneWarper warper;
+    warper.buildMaps(size, K, R, T, xmap, ymap);
+
+    // Fixed-point maps halve the memory traffic of the remap and skip the
+    // float to fixed-point conversion it would otherwise do per pixel.
+    cv::convertMaps(xmap, ymap, map1_, map2_, CV_16SC2);
+
+    size_ = size;
+    roll_ = roll;
+    pitch_ = pitch;
+    valid_ = true;
+    build_count_++;
+  }
+
+  void ImageWarper::RemapRows(
+      int32_t row_start,
+      int32_t row_end,
+      const cv::Mat& image,
+      const cv::Mat& map1,
+      const cv::Mat& map2,
+      cv::Mat& warped)
+  {
+    cv::Mat warped_rows = warped.rowRange(row_start, row_end);
+    cv::remap(
+        image,
+        warped_rows,
+        map1.rowRange(row_start, row_end),
+        map2.rowRange(row_start, row_end),
+        cv::INTER_LANCZOS4,
+        cv::BORDER_CONSTANT);
+  }
+
+  void ImageWarper::RemapBand(
+      const cv::Mat& image,
+      const cv::Mat& map1,
+      const cv::Mat& map2,
+      cv::Mat& warped,
+      int32_t band,
+      int32_t bands)
+  {
+    int32_t rows = warped.rows;
+    bands = std::max(1, std::min(bands, rows / 32));
+    if (band >= bands)
+    {
+      return;
+    }
+
+    RemapRows(
+        (rows * band) / bands,
+        (rows * (band + 1)) / bands,
+        image,
+        map1,
+        map2,
+        warped);
+  }
+
+  void ImageWarper::Warp(
+      const cv::Mat& image,
+      double roll,
+      double pitch,
+      cv::Mat& warped)
+  {
+    // The camera matrix has unit focal length, so a small rotation d about
+    // an axis in the image plane moves a point at distance r from the
+    // principal point by at most about (1 + r^2) * d pixels.
+    double cx = static_cast<double>(image.cols - 1) / 2.0;
+    double cy = static_cast<double>(image.rows - 1) / 2.0;
+    double displacement = (1.0 + cx * cx + cy * cy) *
+        (std::fabs(roll - roll_) + std::fabs(pitch - pitch_));
+
+    if (!valid_ || image.size() != size_ || displacement > tolerance_)
+    {
+      BuildMaps(image.size(), roll, pitch);
+    }
+
+    // The remap can't write over its source.
+    if (warped.data == image.data)
+    {
+      warped = cv::Mat();
+    }
+    warped.create(map1_.size(), image.type());
+
+    if (!pool_)
+    {
+      RemapRows(0, warped.rows, image, map1_, map2_, warped);
+      return;
+    }
+
+    pool_->Run(boost::bind(
+        &ImageWarper::RemapBand,
+        boost::cref(image),
+        boost::cref(map1_),
+        boost::cref(map2_),
+        boost::ref(warped),
+        _1,
+        _2));
+  }
+
+  cv::Mat ImageWarper::Warp(const cv::Mat& image, double roll, double pitch)
+  {
+    cv::Mat warped;
+    Warp(image, roll, pitch, warped);
+    return warped;
+  }
+
+  cv::Mat GetPointWarp(double pitch, double roll, const cv::Size& image_size)
+  {
+    // This is the forward mapping of cv::detail::PlaneWarper::warpPoint for a
+    // camera matrix with unit focal length and the principal point at the
+    // image center, no translation, and a unit scale, followed by shifting
+    // the result back to the image center:
+    //
+    //   H = C * R * K^-1,  where K = [1 0 cx; 0 1 cy; 0 0 1] and C = K
+    double cx = static_cast<double>(image_size.width - 1) / 2.0;
+    double cy = static_cast<double>(image_size.height - 1) / 2.0;
+
+    cv::Mat R = GetR(pitch, roll);
+
+    cv::Mat M(3, 3, CV_64F);
+    for (int32_t i = 0; i < 3; i++)
+    {
+      double r0 = R.at<float>(i, 0);
+      double r1 = R.at<float>(i, 1);
+      double r2 = R.at<float>(i, 2);
+      M.at<double>(i, 0) = r0;
+      M.at<double>(i, 1) = r1;
+      M.at<double>(i, 2) = r2 - cx * r0 - cy * r1;
+    }
+
+    cv::Mat H(3, 3, CV_64F);
+    for (int32_t j = 0; j < 3; j++)
+    {
+      H.at<double>(0, j) = M.at<double>(0, j) + cx * M.at<double>(2, j);
+      H.at<double>(1, j) = M.at<double>(1, j) + cy * M.at<double>(2, j);
+      H.at<double>(2, j) = M.at<double>(2, j);
+    }
+
+    return H;
+  }
+
+  /**
+   * Applies a homography to an array of points stored as interleaved x, y
+   * floats.  The loop has no branches or calls so that it can be
+   * vectorized.  The arithmetic is done in double precision since the
+   * translation terms of the homography are on the order of the image size
+   * and would otherwise cost about a thousandth of a pixel to cancellation.
+   */
+  static void WarpPointArray(
+      const cv::Mat& homography,
+      const float* pts_in,
+      size_t count,
+      size_t stride,
+      float* pts_out)
+  {
+    double h[9];
+    for (int32_t i = 0; i < 9; i++)
+    {
+      h[i] = homography.at<double>(i / 3, i % 3);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+      double x = pts_in[i * stride];
+      double y = pts_in[i * stride + 1];
+      double w = 1.0 / (h[6] * x + h[7] * y + h[8]);
+      pts_out[i * stride] = static_cast<float>((h[0] * x + h[1] * y + h[2]) * w);
+      pts_out[i * stride + 1] = static_cast<float>((h[3] * x + h[4] * y + h[5]) * w);
+    }
+  }
+
   void WarpPoints(
       double pitch,
       double roll,
@@ -63,24 +394,18 @@ namespace image_util
       const cv::Mat& pts_in,
       cv::Mat& pts_out)
   {
-    // Initialize the camera matrix:
-    cv::Mat K = cv::Mat::eye(cv::Size(3, 3), CV_32F);
-    K.at<float>(0, 2) = static_cast<double>(image_size.width - 1) / 2.0;
-    K.at<float>(1, 2) = static_cast<double>(image_size.height - 1) / 2.0;
+    if (pts_in.type() != CV_32FC2)
+    {
+      ROS_ERROR("Points to warp must be of type CV_32FC2.");
+      return;
+    }
 
-    cv::detail::PlaneWarper warper;
+    cv::Mat H = GetPointWarp(pitch, roll, image_size);
 
-    cv::Mat T = cv::Mat::zeros(cv::Size(3, 1), CV_32F);
-    cv::Mat R = GetR(pitch, roll);
-    pts_in.copyTo(pts_out);
+    pts_out.create(pts_in.size(), pts_in.type());
     for (int32_t i = 0; i < pts_in.rows; ++i)
     {
-      cv::Point2f pt;
-      pt.x = pts_in.at<cv::Vec2f>(i, 0).val[0];
-      pt.y = pts_in.at<cv::Vec2f>(i, 0).val[1];
-      cv::Point2f pt2 = warper.warpPoint(pt, K, R, T);
-      pts_out.at<cv::Vec2f>(i, 0).val[0] = pt2.x + K.at<float>(0, 2);
-      pts_out.at<cv::Vec2f>(i, 0).val[1] = pt2.y + K.at<float>(1, 2);
+      WarpPointArray(H, pts_in.ptr<float>(i), pts_in.cols, 2, pts_out.ptr<float>(i));
     }
   }
 
@@ -92,25 +417,22 @@ namespace image_util
       std::vector<cv::KeyPoint>& pts_out)
   {
     pts_out = pts_in;
-
-    // Initialize the camera matrix:
-    cv::Mat K = cv::Mat::eye(cv::Size(3, 3), CV_32F);
-    K.at<float>(0, 2) = static_cast<double>(image_size.width - 1) / 2.0;
-    K.at<float>(1, 2) = static_cast<double>(image_size.height - 1) / 2.0;
-
-    cv::detail::PlaneWarper warper;
-
-    cv::Mat T = cv::Mat::zeros(cv::Size(3, 1), CV_32F);
-    cv::Mat R = GetR(pitch, roll);
-
-    for (uint32_t i = 0; i < pts_in.size(); i++)
+    if (pts_in.empty())
     {
-      pts_out[i].pt = warper.warpPoint(pts_in[i].pt, K, R, T);
-      pts_out[i].pt.x += K.at<float>(0, 2);
-      pts_out[i].pt.y += K.at<float>(1, 2);
+      return;
     }
-  }
 
+    cv::Mat H = GetPointWarp(pitch, roll, image_size);
+
+    // The key point coordinates are strided through the key point array.
+    const size_t stride = sizeof(cv::KeyPoint) / sizeof(float);
+    WarpPointArray(
+        H,
+        &pts_in[0].pt.x,
+        pts_in.size(),
+        stride,
+        &pts_out[0].pt.x);
+  }
 
   cv::Mat GetR(double pitch, double roll, double yaw)
   {
@@ -151,16 +473,22 @@ namespace image_util
       return cv::Mat();
     }
 
+    if (!pool_)
+    {
+      pool_.reset(new WorkerPool());
+    }
+
     ros::WallTime T1 = ros::WallTime::now();
     cv::Mat T_rigid = EstimateNominalAngle(kp1_matched_,
                                            kp2_matched_,
                                            cv::Size(im1_.cols, im1_.rows),
                                            nominal_pitch,
-                                           nominal_roll);
+                                           nominal_roll,
+                                           *pool_);
 
     ros::WallTime T2 = ros::WallTime::now();
 
-    ROS_ERROR("Estimate Nominal Angle time = %g", (T2 - T1).toSec());
+    ROS_DEBUG("Estimate Nominal Angle time = %g", (T2 - T1).toSec());
     cv::Mat R = GetR(nominal_pitch, nominal_roll);
 
     if (show_image_diff)
@@ -202,17 +530,257 @@ namespace image_util
     return R;
   }
 
+  /**
+   * A pitch and roll hypothesis evaluated by
+   * PitchAndRollEstimator::EstimateNominalAngle().
+   */
+  struct AngleHypothesis
+  {
+    AngleHypothesis() :
+      pitch(0.0),
+      roll(0.0),
+      seed(0),
+      success(false),
+      rms_error(0.0)
+    {
+    }
+
+    AngleHypothesis(double pitch, double roll, uint32_t seed) :
+      pitch(pitch),
+      roll(roll),
+      seed(seed),
+      success(false),
+      rms_error(0.0)
+    {
+    }
+
+    double Cost() const
+    {
+      return success ? rms_error : 1e20;
+    }
+
+    double pitch;
+    double roll;
+    uint32_t seed;
+    bool success;
+    double rms_error;
+    cv::Mat T_rigid;
+  };
+
+  static void EvaluateAngle(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      const cv::Size& image_size,
+      AngleHypothesis& hypothesis)
+  {
+    cv::Mat kp1_warped;
+    WarpPoints(hypothesis.pitch, hypothesis.roll, image_size, points1, kp1_warped);
+
+    cv::Mat kp2_warped;
+    WarpPoints(hypothesis.pitch, hypothesis.roll, image_size, points2, kp2_warped);
+
+    cv::Mat inliers1;
+    cv::Mat inliers2;
+    cv::Mat T_affine = ComputeLooseAffine2DTransform(
+        kp1_warped,
+        kp2_warped,
+        inliers1,
+        inliers2,
+        hypothesis.T_rigid,
+        hypothesis.rms_error,
+        hypothesis.seed);
+
+    hypothesis.success = !T_affine.empty();
+  }
+
+  static void EvaluateAngleSubset(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      const cv::Size& image_size,
+      std::vector<AngleHypothesis>& hypotheses,
+      size_t start,
+      size_t stride)
+  {
+    for (size_t i = start; i < hypotheses.size(); i += stride)
+    {
+      EvaluateAngle(points1, points2, image_size, hypotheses[i]);
+    }
+  }
+
+  /**
+   * Evaluates a set of hypotheses on a worker pool, interleaving them across
+   * the threads so that neighboring cells, which tend to take similar
+   * amounts of time, are spread evenly.
+   */
+  static void EvaluateAngles(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      const cv::Size& image_size,
+      WorkerPool& pool,
+      std::vector<AngleHypothesis>& hypotheses)
+  {
+    if (pool.Size() == 1 || hypotheses.size() == 1)
+    {
+      EvaluateAngleSubset(points1, points2, image_size, hypotheses, 0, 1);
+      return;
+    }
+
+    pool.Run(boost::bind(
+        &EvaluateAngleSubset,
+        boost::cref(points1),
+        boost::cref(points2),
+        boost::cref(image_size),
+        boost::ref(hypotheses),
+        _1,
+        _2));
+  }
+
+  /**
+   * Refines the best hypothesis with a Nelder-Mead search on the RMS error,
+   * starting from a simplex with the given step sizes, until the simplex is
+   * smaller than the given resolution.
+   *
+   * Every vertex is evaluated with the same seed, so that differences in the
+   * RMS error are due to the pitch and roll rather than the RANSAC samples.
+   */
+  static void RefineAngle(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      const cv::Size& image_size,
+      WorkerPool& pool,
+      double dp,
+      double dr,
+      double min_dp,
+      double min_dr,
+      uint32_t seed,
+      AngleHypothesis& best)
+  {
+    const int32_t max_evaluations = 40;
+
+    std::vector<AngleHypothesis> simplex;
+    simplex.push_back(AngleHypothesis(best.pitch, best.roll, seed));
+    simplex.push_back(AngleHypothesis(best.pitch + dp, best.roll, seed));
+    simplex.push_back(AngleHypothesis(best.pitch, best.roll + dr, seed));
+    EvaluateAngles(points1, points2, image_size, pool, simplex);
+    int32_t evaluations = 3;
+
+    while (evaluations < max_evaluations)
+    {
+      // Order the vertices from best to worst.
+      for (int32_t i = 1; i < 3; i++)
+      {
+        for (int32_t j = i; j > 0 && simplex[j].Cost() < simplex[j - 1].Cost(); j--)
+        {
+          std::swap(simplex[j], simplex[j - 1]);
+        }
+      }
+
+      double p_extent = std::max(
+          std::fabs(simplex[1].pitch - simplex[0].pitch),
+          std::fabs(simplex[2].pitch - simplex[0].pitch));
+      double r_extent = std::max(
+          std::fabs(simplex[1].roll - simplex[0].roll),
+          std::fabs(simplex[2].roll - simplex[0].roll));
+      if (p_extent < min_dp && r_extent < min_dr)
+      {
+        break;
+      }
+
+      double cp = (simplex[0].pitch + simplex[1].pitch) / 2.0;
+      double cr = (simplex[0].roll + simplex[1].roll) / 2.0;
+
+      AngleHypothesis reflected(
+          2.0 * cp - simplex[2].pitch, 2.0 * cr - simplex[2].roll, seed);
+      EvaluateAngle(points1, points2, image_size, reflected);
+      evaluations++;
+
+      if (reflected.Cost() < simplex[0].Cost())
+      {
+        AngleHypothesis expanded(
+            3.0 * cp - 2.0 * simplex[2].pitch, 3.0 * cr - 2.0 * simplex[2].roll, seed);
+        EvaluateAngle(points1, points2, image_size, expanded);
+        evaluations++;
+
+        simplex[2] = expanded.Cost() < reflected.Cost() ? expanded : reflected;
+      }
+      else if (reflected.Cost() < simplex[1].Cost())
+      {
+        simplex[2] = reflected;
+      }
+      else
+      {
+        AngleHypothesis contracted(
+            (cp + simplex[2].pitch) / 2.0, (cr + simplex[2].roll) / 2.0, seed);
+        EvaluateAngle(points1, points2, image_size, contracted);
+        evaluations++;
+
+        if (contracted.Cost() < simplex[2].Cost())
+        {
+          simplex[2] = contracted;
+        }
+        else
+        {
+          // Shrink the simplex towards the best vertex.
+          for (int32_t i = 1; i < 3; i++)
+          {
+            simplex[i] = AngleHypothesis(
+                (simplex[0].pitch + simplex[i].pitch) / 2.0,
+                (simplex[0].roll + simplex[i].roll) / 2.0,
+                seed);
+          }
+          std::vector<AngleHypothesis> shrunk(simplex.begin() + 1, simplex.end());
+          EvaluateAngles(points1, points2, image_size, pool, shrunk);
+          std::copy(shrunk.begin(), shrunk.end(), simplex.begin() + 1);
+          evaluations += 2;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < simplex.size(); i++)
+    {
+      if (simplex[i].Cost() < best.Cost())
+      {
+        best = simplex[i];
+      }
+    }
+  }
+
   cv::Mat PitchAndRollEstimator::EstimateNominalAngle(
       const cv::Mat& points1,
       const cv::Mat& points2,
       const cv::Size& image_size,
       double& nominal_pitch,
-      double& nominal_roll)
+      double& nominal_roll,
+      int32_t threads,
+      bool refine)
+  {
+    WorkerPool pool(threads);
+    return EstimateNominalAngle(
+        points1,
+        points2,
+        image_size,
+        nominal_pitch,
+        nominal_roll,
+        pool,
+        refine);
+  }
+
+  cv::Mat PitchAndRollEstimator::EstimateNominalAngle(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      const cv::Size& image_size,
+      double& nominal_pitch,
+      double& nominal_roll,
+      WorkerPool& pool,
+      bool refine)
   {
     // Max number of iterations per angle, per scale
     const int32_t max_iterations = 5;
     const int32_t num_octaves = 5;
 
+    // The number of grid octaves searched before switching to Nelder-Mead
+    const int32_t refine_octaves = 2;
+
     double pitch_range = 0.02 * 3.14159/180.0;
     double min_pitch = -std::abs(pitch_range / 2.0);
     double max_pitch = std::abs(pitch_range / 2.0);
@@ -221,78 +789,74 @@ namespace image_util
     double min_roll = -std::abs(roll_range / 2.0);
     double max_roll = std::abs(roll_range / 2.0);
 
-    cv::Mat T_rigid_final = cv::Mat();
-    for (int32_t octave_idx = 0; octave_idx < num_octaves; ++octave_idx)
+    int32_t grid_octaves = refine ? refine_octaves : num_octaves;
+
+    AngleHypothesis best;
+    double dp = 0.0;
+    double dr = 0.0;
+    std::vector<AngleHypothesis> cells(max_iterations * max_iterations);
+    for (int32_t octave_idx = 0; octave_idx < grid_octaves; ++octave_idx)
     {
-      double dp = (max_pitch - min_pitch) /
+      dp = (max_pitch - min_pitch) /
           static_cast<double>(max_iterations - 1);
-      double dr = (max_roll - min_roll) /
+      dr = (max_roll - min_roll) /
           static_cast<double>(max_iterations - 1);
 
-      double min_diff = 1e20;
-      nominal_pitch = 0.0;
-      nominal_roll = 0.0;
-
-
       for (int32_t pitch_idx = 0; pitch_idx < max_iterations; ++pitch_idx)
       {
-        double cur_pitch = min_pitch + dp * pitch_idx;
         for (int32_t roll_idx = 0; roll_idx < max_iterations; ++roll_idx)
         {
-          double cur_roll = min_roll + dr * roll_idx;
-
-          cv::Mat kp1_warped;
-          image_util::WarpPoints(cur_pitch,
-                     cur_roll,
-                     image_size,
-                     points1,
-                     kp1_warped);
-
-          cv::Mat kp2_warped;
-          image_util::WarpPoints(cur_pitch,
-                     cur_roll,
-                     image_size,
-                     points2,
-                     kp2_warped);
-
-          cv::Mat T_rigid;
-          cv::Mat T_affine;
-          double rms_error;
-          bool success = EstimateTransforms(kp1_warped,
-                                            kp2_warped,
-                                            T_affine,
-                                            T_rigid,
-                                            rms_error);
-          if (!success)
-          {
-            continue;
-          }
+          int32_t cell = pitch_idx * max_iterations + roll_idx;
+          cells[cell] = AngleHypothesis(
+              min_pitch + dp * pitch_idx,
+              min_roll + dr * roll_idx,
+              octave_idx * cells.size() + cell + 1);
+        }
+      }
 
-          double cur_diff = rms_error;
+      EvaluateAngles(points1, points2, image_size, pool, cells);
 
-          if (cur_diff < min_diff)
-          {
-            min_diff = cur_diff;
-
-            nominal_pitch = cur_pitch;
-            nominal_roll = cur_roll;
-            T_rigid_final = T_rigid;
-          }
+      // Pick the best cell in the same order as a serial search would, so
+      // that ties are broken the same way.
+      best = AngleHypothesis();
+      for (size_t i = 0; i < cells.size(); i++)
+      {
+        if (cells[i].success && cells[i].Cost() < best.Cost())
+        {
+          best = cells[i];
         }
       }
 
-      min_pitch = nominal_pitch - std::abs(dp * 2 / 3);
-      max_pitch = nominal_pitch + std::abs(dp * 2 / 3);
+      min_pitch = best.pitch - std::abs(dp * 2 / 3);
+      max_pitch = best.pitch + std::abs(dp * 2 / 3);
 
 
-      min_roll = nominal_roll - std::abs(dr * 2 / 3);
-      max_roll = nominal_roll + std::abs(dr * 2 / 3);
+      min_roll = best.roll - std::abs(dr * 2 / 3);
+      max_roll = best.roll + std::abs(dr * 2 / 3);
     }
 
-    cv::Mat R = GetR(nominal_pitch,
-                     nominal_roll);
+    if (refine)
+    {
+      // Each octave of the grid search reduces the step size by a factor of
+      // 3, so stop at the resolution the remaining octaves would reach.
+      double resolution = std::pow(3.0, num_octaves - grid_octaves);
+      RefineAngle(
+          points1,
+          points2,
+          image_size,
+          pool,
+          dp / 3.0,
+          dr / 3.0,
+          dp / resolution,
+          dr / resolution,
+          num_octaves * cells.size() + 1,
+          best);
+    }
+
+    nominal_pitch = best.pitch;
+    nominal_roll = best.roll;
 
-    return T_rigid_final;
+    return best.T_rigid;
   }
 
   bool PitchAndRollEstimator::ComputeGeometricMatches()
@@ -437,10 +1001,16 @@ namespace image_util
   // PitchAndRollEstimatorQueue()
   //
   //////////////////////////////////////////////////////////////////////////////
-  PitchAndRollEstimatorQueue::PitchAndRollEstimatorQueue()
+  PitchAndRollEstimatorQueue::PitchAndRollEstimatorQueue() :
+    pitch_sum_(0.0),
+    roll_sum_(0.0),
+    expired_samples_(0),
+    mean_pitch_(0.0),
+    mean_roll_(0.0),
+    median_pitch_(0.0),
+    median_roll_(0.0)
   {
     SetBufferSize();
-    ComputeStats();
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -452,6 +1022,11 @@ namespace image_util
   {
     pitches_.set_capacity(buff_size);
     rolls_.set_capacity(buff_size);
+    sorted_pitches_.reserve(buff_size);
+    sorted_rolls_.reserve(buff_size);
+
+    // Shrinking the buffers may have dropped samples.
+    ComputeStats();
   }
 
 
@@ -502,18 +1077,23 @@ namespace image_util
       const cv::Mat& points2,
       const cv::Size& image_size)
   {
+    if (!pool_)
+    {
+      pool_.reset(new WorkerPool());
+    }
+
     double pitch = 0.0;
     double roll = 0.0;
     cv::Mat T = PitchAndRollEstimator::EstimateNominalAngle(points1,
                                                             points2,
                                                             image_size,
                                                             pitch,
-                                                            roll);
+                                                            roll,
+                                                            *pool_);
 
     if (!T.empty())
     {
       LoadNewData(pitch, roll);
-      ComputeStats();
     }
   }
 
@@ -554,9 +1134,37 @@ namespace image_util
   void PitchAndRollEstimatorQueue::LoadNewData(double new_pitch,
                                                double new_roll)
   {
+    if (pitches_.capacity() == 0)
+    {
+      return;
+    }
+
+    // When the buffers are full the oldest sample is pushed out, so take it
+    // out of the statistics as well.
+    bool full = pitches_.full();
+    double old_pitch = full ? pitches_.front() : 0.0;
+    double old_roll = full ? rolls_.front() : 0.0;
+
     pitches_.push_back(new_pitch);
     rolls_.push_back(new_roll);
-    ComputeStats();
+
+    ReplaceSorted(sorted_pitches_, old_pitch, full, new_pitch);
+    ReplaceSorted(sorted_rolls_, old_roll, full, new_roll);
+
+    pitch_sum_ += new_pitch - old_pitch;
+    roll_sum_ += new_roll - old_roll;
+
+    // Subtracting expired samples slowly accumulates rounding error in the
+    // sums, so recompute them once per buffer length, which keeps the cost
+    // per sample constant.
+    if (full && ++expired_samples_ >= static_cast<int32_t>(pitches_.capacity()))
+    {
+      expired_samples_ = 0;
+      pitch_sum_ = std::accumulate(pitches_.begin(), pitches_.end(), 0.0);
+      roll_sum_ = std::accumulate(rolls_.begin(), rolls_.end(), 0.0);
+    }
+
+    UpdateStats();
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -565,48 +1173,97 @@ namespace image_util
   //
   //////////////////////////////////////////////////////////////////////////////
   void PitchAndRollEstimatorQueue::ComputeStats()
+  {
+    sorted_pitches_.assign(pitches_.begin(), pitches_.end());
+    sorted_rolls_.assign(rolls_.begin(), rolls_.end());
+
+    std::sort(sorted_pitches_.begin(), sorted_pitches_.end());
+    std::sort(sorted_rolls_.begin(), sorted_rolls_.end());
+
+    pitch_sum_ = std::accumulate(pitches_.begin(), pitches_.end(), 0.0);
+    roll_sum_ = std::accumulate(rolls_.begin(), rolls_.end(), 0.0);
+    expired_samples_ = 0;
+
+    UpdateStats();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  //
+  // UpdateStats()
+  //
+  //////////////////////////////////////////////////////////////////////////////
+  void PitchAndRollEstimatorQueue::UpdateStats()
   {
     mean_pitch_ = 0.0;
     mean_roll_ = 0.0;
-    median_pitch_ = 0.0;
-    median_roll_ = 0.0;
 
-    if (pitches_.empty())
+    if (!pitches_.empty())
     {
-      return;
+      double N = static_cast<double>(pitches_.size());
+      mean_pitch_ = pitch_sum_ / N;
+      mean_roll_ = roll_sum_ / N;
     }
 
-    std::vector<double> temp_pitch;
-    std::vector<double> temp_roll;
-    temp_pitch.assign(pitches_.begin(), pitches_.end());
-    temp_roll.assign(rolls_.begin(), rolls_.end());
-
-    std::sort(temp_pitch.begin(), temp_pitch.end());
-    std::sort(temp_roll.begin(), temp_roll.end());
-
-    double pitch_sum = 0.0;
-    double roll_sum = 0.0;
+    median_pitch_ = Median(sorted_pitches_);
+    median_roll_ = Median(sorted_rolls_);
+  }
 
-    for (int32_t i = 0; i < (int32_t)temp_pitch.size(); ++i)
+  //////////////////////////////////////////////////////////////////////////////
+  //
+  // ReplaceSorted()
+  //
+  //////////////////////////////////////////////////////////////////////////////
+  void PitchAndRollEstimatorQueue::ReplaceSorted(std::vector<double>& sorted,
+                                                 double old_value,
+                                                 bool remove,
+                                                 double new_value)
+  {
+    if (!remove)
     {
-      pitch_sum += temp_pitch[i];
-      roll_sum += temp_roll[i];
+      sorted.insert(
+          std::upper_bound(sorted.begin(), sorted.end(), new_value),
+          new_value);
+      return;
     }
 
-    double N = static_cast<double>(temp_pitch.size());
-    mean_pitch_ = pitch_sum / N;
-    mean_roll_ = roll_sum / N;
-
-    int32_t mid_idx = static_cast<int32_t>(temp_pitch.size() - 1) / 2;
-    if (temp_pitch.size() % 2 == 0)
+    // Shift the elements between the old and new positions by one instead of
+    // erasing and inserting, so that the window size never changes.
+    std::vector<double>::iterator old_it =
+        std::lower_bound(sorted.begin(), sorted.end(), old_value);
+    if (new_value >= old_value)
     {
-      median_pitch_ = (temp_pitch[mid_idx] + temp_pitch[mid_idx + 1]) / 2.0;
-      median_roll_ = (temp_roll[mid_idx] + temp_roll[mid_idx + 1]) / 2.0;
+      std::vector<double>::iterator new_it =
+          std::upper_bound(old_it, sorted.end(), new_value);
+      std::copy(old_it + 1, new_it, old_it);
+      *(new_it - 1) = new_value;
     }
     else
     {
-      median_pitch_ = temp_pitch[mid_idx];
-      median_roll_ = temp_roll[mid_idx];
+      std::vector<double>::iterator new_it =
+          std::upper_bound(sorted.begin(), old_it, new_value);
+      std::copy_backward(new_it, old_it, old_it + 1);
+      *new_it = new_value;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  //
+  // Median()
+  //
+  //////////////////////////////////////////////////////////////////////////////
+  double PitchAndRollEstimatorQueue::Median(const std::vector<double>& sorted)
+  {
+    if (sorted.empty())
+    {
+      return 0.0;
     }
+
+    int32_t mid_idx = static_cast<int32_t>(sorted.size() - 1) / 2;
+    if (sorted.size() % 2 == 0)
+    {
+      return (sorted[mid_idx] + sorted[mid_idx + 1]) / 2.0;
+    }
+
+    return sorted[mid_idx];
   }
 }
@@ -0,0 +1,258 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <image_util/latest_frame_worker.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+
+#include <boost/bind.hpp>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+namespace image_util
+{
+  LatestFrameWorker::LatestFrameWorker() :
+    diagnostic_period_(1.0),
+    running_(false),
+    processed_(0),
+    dropped_(0),
+    total_latency_(0),
+    max_latency_(0),
+    total_age_(0),
+    total_processed_(0),
+    total_dropped_(0)
+  {
+  }
+
+  LatestFrameWorker::~LatestFrameWorker()
+  {
+    Stop();
+  }
+
+  void LatestFrameWorker::Start(
+      const std::string& name,
+      const Callback& callback,
+      ros::NodeHandle& node,
+      double diagnostic_period)
+  {
+    Stop();
+
+    name_ = name;
+    callback_ = callback;
+    diagnostic_period_ = diagnostic_period;
+    diagnostic_pub_ = node.advertise<diagnostic_msgs::DiagnosticArray>(
+        "/diagnostics", 1);
+    last_diagnostic_time_ = ros::WallTime::now();
+    total_processed_ = 0;
+    total_dropped_ = 0;
+    pending_.reset();
+
+    running_ = true;
+    thread_ = boost::thread(boost::bind(&LatestFrameWorker::Run, this));
+  }
+
+  void LatestFrameWorker::Stop()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      if (!running_)
+      {
+        return;
+      }
+      running_ = false;
+      pending_.reset();
+    }
+    condition_.notify_all();
+    thread_.join();
+  }
+
+  void LatestFrameWorker::AddFrame(const sensor_msgs::ImageConstPtr& image)
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      if (!running_)
+      {
+        return;
+      }
+
+      if (pending_)
+      {
+        dropped_++;
+        total_dropped_++;
+      }
+      pending_ = image;
+      pending_time_ = ros::WallTime::now();
+    }
+    condition_.notify_one();
+  }
+
+  image_transport::Subscriber LatestFrameWorker::Subscribe(
+      image_transport::ImageTransport& it,
+      const std::string& topic,
+      const Callback& callback,
+      bool use_worker,
+      const std::string& name,
+      ros::NodeHandle& node)
+  {
+    if (!use_worker)
+    {
+      return it.subscribe(topic, 1, callback);
+    }
+
+    Start(name, callback, node);
+    return it.subscribe(topic, 1, &LatestFrameWorker::AddFrame, this);
+  }
+
+  int32_t LatestFrameWorker::ProcessedCount()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return total_processed_;
+  }
+
+  int32_t LatestFrameWorker::DroppedCount()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return total_dropped_;
+  }
+
+  void LatestFrameWorker::Run()
+  {
+    while (true)
+    {
+      sensor_msgs::ImageConstPtr image;
+      ros::WallTime received;
+      {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (running_ && !pending_)
+        {
+          // Wake up periodically so diagnostics are published even when no
+          // frames arrive.
+          condition_.timed_wait(lock,
+              boost::posix_time::milliseconds(
+                  static_cast<int64_t>(diagnostic_period_ * 1000)));
+          PublishDiagnostics(ros::WallTime::now());
+        }
+
+        if (!running_)
+        {
+          return;
+        }
+
+        image.swap(pending_);
+        received = pending_time_;
+      }
+
+      try
+      {
+        callback_(image);
+      }
+      catch (const std::exception& e)
+      {
+        ROS_ERROR("Failed to process image: %s", e.what());
+      }
+
+      ros::WallTime now = ros::WallTime::now();
+      double latency = (now - received).toSec();
+      double age = (ros::Time::now() - image->header.stamp).toSec();
+
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      processed_++;
+      total_processed_++;
+      total_latency_ += latency;
+      max_latency_ = std::max(max_latency_, latency);
+      total_age_ += age;
+      PublishDiagnostics(now);
+    }
+  }
+
+  void LatestFrameWorker::PublishDiagnostics(const ros::WallTime& now)
+  {
+    // Called with the mutex held.
+    if ((now - last_diagnostic_time_).toSec() < diagnostic_period_)
+    {
+      return;
+    }
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = name_ + ": frame worker";
+    if (processed_ == 0 && dropped_ > 0)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "Frames received but none processed";
+    }
+    else
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "Processing latest frames";
+    }
+
+    double frames = std::max(1, processed_);
+    char buffer[64];
+    diagnostic_msgs::KeyValue value;
+
+    value.key = "processed";
+    std::snprintf(buffer, sizeof(buffer), "%d", processed_);
+    value.value = buffer;
+    status.values.push_back(value);
+
+    value.key = "dropped";
+    std::snprintf(buffer, sizeof(buffer), "%d", dropped_);
+    value.value = buffer;
+    status.values.push_back(value);
+
+    value.key = "average latency (ms)";
+    std::snprintf(buffer, sizeof(buffer), "%.3f", total_latency_ * 1000.0 / frames);
+    value.value = buffer;
+    status.values.push_back(value);
+
+    value.key = "max latency (ms)";
+    std::snprintf(buffer, sizeof(buffer), "%.3f", max_latency_ * 1000.0);
+    value.value = buffer;
+    status.values.push_back(value);
+
+    value.key = "average age at output (ms)";
+    std::snprintf(buffer, sizeof(buffer), "%.3f", total_age_ * 1000.0 / frames);
+    value.value = buffer;
+    status.values.push_back(value);
+
+    diagnostic_msgs::DiagnosticArray diagnostics;
+    diagnostics.header.stamp = ros::Time::now();
+    diagnostics.status.push_back(status);
+    diagnostic_pub_.publish(diagnostics);
+
+    last_diagnostic_time_ = now;
+    processed_ = 0;
+    dropped_ = 0;
+    total_latency_ = 0;
+    max_latency_ = 0;
+    total_age_ = 0;
+  }
+}
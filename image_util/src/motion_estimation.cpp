@@ -30,6 +30,12 @@
 #include <image_util/motion_estimation.h>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread.hpp>
 
 namespace image_util
 {
@@ -349,217 +355,708 @@ namespace image_util
     PrintMatrix(Rtemp4);
   }
 
-  cv::Mat ComputeRigid2DTransform(
+  /**
+   * A pair of corresponding 2D points, packed so that the RANSAC inner loop
+   * reads both points of a match from the same cache line.
+   */
+  struct PointPair2D
+  {
+    double x1;
+    double y1;
+    double x2;
+    double y2;
+  };
+
+  /**
+   * Copies 1xN or Nx1 CV_32FC2 point arrays into an array of point pairs.
+   */
+  static void PackPointPairs(
       const cv::Mat& points1,
       const cv::Mat& points2,
+      std::vector<PointPair2D>& pairs)
+  {
+    bool row_order = points1.rows > 1;
+    int32_t num_points = row_order ? points1.rows : points1.cols;
+
+    pairs.resize(num_points);
+    for (int32_t i = 0; i < num_points; i++)
+    {
+      int32_t row = row_order ? i : 0;
+      int32_t col = row_order ? 0 : i;
+      const cv::Vec2f& point1 = points1.at<cv::Vec2f>(row, col);
+      const cv::Vec2f& point2 = points2.at<cv::Vec2f>(row, col);
+      pairs[i].x1 = point1[0];
+      pairs[i].y1 = point1[1];
+      pairs[i].x2 = point2[0];
+      pairs[i].y2 = point2[1];
+    }
+  }
+
+  /**
+   * Copies the selected point pairs into 1xN or Nx1 CV_32FC2 inlier arrays.
+   */
+  static void UnpackPointPairs(
+      const std::vector<PointPair2D>& pairs,
+      const std::vector<uint32_t>& indices,
+      bool row_order,
       cv::Mat& inliers1,
-      cv::Mat& inliers2,
-      std::vector<uint32_t> &good_points, 
-      int32_t max_iterations,
-      double max_error)
+      cv::Mat& inliers2)
   {
-    cv::Mat T;
-    // Here we are trying to compute the transformation matrix T, where T most
-    // closely satisfies the relationship
-    // T*[points1(i);1] = [points2(i);1] for inlying points in both sets
-    // We use RANSAC to exclude outliers
+    int32_t rows = row_order ? indices.size() : 1;
+    int32_t cols = row_order ? 1 : indices.size();
+    inliers1 = cv::Mat(rows, cols, CV_32FC2);
+    inliers2 = cv::Mat(rows, cols, CV_32FC2);
+
+    cv::Vec2f* inlier1 = inliers1.ptr<cv::Vec2f>();
+    cv::Vec2f* inlier2 = inliers2.ptr<cv::Vec2f>();
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+      const PointPair2D& pair = pairs[indices[i]];
+      inlier1[i] = cv::Vec2f(pair.x1, pair.y1);
+      inlier2[i] = cv::Vec2f(pair.x2, pair.y2);
+    }
+  }
 
-    // First build the input vectors
-    bool row_order = false;
-    if (!ValidPointsForTransform(points1, points2))
+  /**
+   * Computes the transform for a 3 point RANSAC sample.
+   *
+   * This is equivalent to solving for the affine transform [M t] that maps
+   * the sample exactly with LaLinearSolve and then applying
+   * RegularizeTransform, but works on the stack in closed form.  The result
+   * is stored in the transposed abbreviated form X = [R'; t'], where R is the
+   * orthonormal matrix nearest to M and t is the translation of the affine
+   * transform.
+   *
+   * @param[in]  a      The first sample
+   * @param[in]  b      The second sample
+   * @param[in]  c      The third sample
+   * @param[out] X      The transform
+   * @param[out] cn     The condition number of M
+   * @param[out] rnorm  ||R'R - I|| for the computed R
+   *
+   * @retval Returns false if the sample points are collinear or M is singular
+   */
+  static bool SolveSample(
+      const PointPair2D& a,
+      const PointPair2D& b,
+      const PointPair2D& c,
+      double X[3][2],
+      double& cn,
+      double& rnorm)
+  {
+    // Solve M * [b1 - a1, c1 - a1] = [b2 - a2, c2 - a2] for M.
+    double dx1 = b.x1 - a.x1;
+    double dy1 = b.y1 - a.y1;
+    double dx2 = c.x1 - a.x1;
+    double dy2 = c.y1 - a.y1;
+    double det = dx1 * dy2 - dx2 * dy1;
+    if (det == 0.0)
     {
-      ROS_ERROR("Invalid points for calculating transform.");
-      return T;
+      return false;
     }
 
-    uint32_t NumPoints = points1.cols;
-    if (points1.rows > 1)
+    double qx1 = b.x2 - a.x2;
+    double qy1 = b.y2 - a.y2;
+    double qx2 = c.x2 - a.x2;
+    double qy2 = c.y2 - a.y2;
+
+    double m00 = (qx1 * dy2 - qx2 * dy1) / det;
+    double m01 = (qx2 * dx1 - qx1 * dx2) / det;
+    double m10 = (qy1 * dy2 - qy2 * dy1) / det;
+    double m11 = (qy2 * dx1 - qy1 * dx2) / det;
+
+    X[2][0] = a.x2 - (m00 * a.x1 + m01 * a.y1);
+    X[2][1] = a.y2 - (m10 * a.x1 + m11 * a.y1);
+
+    // The SVD of a 2x2 matrix [p q; r s] has a closed form.  With
+    //   e = (p + s) / 2, f = (p - s) / 2, g = (r + q) / 2, h = (r - q) / 2
+    // the singular values are sqrt(e^2 + h^2) +/- sqrt(f^2 + g^2), and U*Vt
+    // is the rotation [e -h; h e] / sqrt(e^2 + h^2) if the determinant is
+    // positive, or the reflection [f g; g -f] / sqrt(f^2 + g^2) otherwise.
+    double p = m00;
+    double q = m10;
+    double r = m01;
+    double s = m11;
+
+    double e = (p + s) / 2.0;
+    double f = (p - s) / 2.0;
+    double g = (r + q) / 2.0;
+    double h = (r - q) / 2.0;
+    double eh = std::sqrt(e * e + h * h);
+    double fg = std::sqrt(f * f + g * g);
+
+    double sigma_min = std::fabs(eh - fg);
+    if (sigma_min == 0.0)
     {
-      row_order = true;
-      NumPoints = points1.rows;
+      return false;
     }
+    cn = (eh + fg) / sigma_min;
 
-    // Setup matrices for holding all of the points
-    LaGenMatDouble sourceA(NumPoints, 2);
-    LaGenMatDouble sourceA_aug(NumPoints, 3);
-    LaGenMatDouble sourceB(NumPoints, 2);
-    LaGenMatDouble tempA(NumPoints, 2);
+    if (eh > fg)
+    {
+      X[0][0] = e / eh;
+      X[0][1] = -h / eh;
+      X[1][0] = h / eh;
+      X[1][1] = e / eh;
+    }
+    else
+    {
+      X[0][0] = f / fg;
+      X[0][1] = g / fg;
+      X[1][0] = g / fg;
+      X[1][1] = -f / fg;
+    }
 
-    double xmax = -1.0e20;
-    double xmin = 1.0e20;
-    double ymax = xmax;
-    double ymin = xmin;
+    double rtr00 = X[0][0] * X[0][0] + X[1][0] * X[1][0] - 1.0;
+    double rtr01 = X[0][0] * X[0][1] + X[1][0] * X[1][1];
+    double rtr11 = X[0][1] * X[0][1] + X[1][1] * X[1][1] - 1.0;
+    rnorm = std::sqrt(rtr00 * rtr00 + 2.0 * rtr01 * rtr01 + rtr11 * rtr11);
 
-    // Convert from cv::Mat to LaGenMatDouble
-    for (uint32_t i = 0; i < NumPoints; i++)
+    return true;
+  }
+
+  /**
+   * Finds the point pairs that a transform maps to within the error bound
+   * of each other, storing their indices in the pre-sized inliers array.
+   *
+   * @returns The number of inliers.
+   */
+  static size_t FindInliers(
+      const std::vector<PointPair2D>& pairs,
+      const double X[3][2],
+      double max_error,
+      std::vector<uint32_t>& inliers)
+  {
+    double max_error_sq = max_error * max_error;
+    size_t count = 0;
+    for (size_t i = 0; i < pairs.size(); i++)
     {
-      // Points from first frame
-      if (row_order)
-      {
-        sourceA(i, 0) = points1.at<cv::Vec2f>(i, 0)[0];
-        sourceA(i, 1) = points1.at<cv::Vec2f>(i, 0)[1];
-        sourceB(i, 0) = points2.at<cv::Vec2f>(i, 0)[0];
-        sourceB(i, 1) = points2.at<cv::Vec2f>(i, 0)[1];
-        sourceA_aug(i, 0) = points1.at<cv::Vec2f>(i, 0)[0];
-        sourceA_aug(i, 1) = points1.at<cv::Vec2f>(i, 0)[1];
-      }
-      else
-      {
-        sourceA(i, 0) = points1.at<cv::Vec2f>(0, i)[0];
-        sourceA(i, 1) = points1.at<cv::Vec2f>(0, i)[1];
-        sourceB(i, 0) = points2.at<cv::Vec2f>(0, i)[0];
-        sourceB(i, 1) = points2.at<cv::Vec2f>(0, i)[1];
-        sourceA_aug(i, 0) = points1.at<cv::Vec2f>(0, i)[0];
-        sourceA_aug(i, 1) = points1.at<cv::Vec2f>(0, i)[1];
-      }
-      sourceA_aug(i, 2) = 1.0;
+      const PointPair2D& pair = pairs[i];
+      double dx = pair.x1 * X[0][0] + pair.y1 * X[1][0] + X[2][0] - pair.x2;
+      double dy = pair.x1 * X[0][1] + pair.y1 * X[1][1] + X[2][1] - pair.y2;
 
-      // Find the range of the data;
-      if (sourceA(i, 0) > xmax)
-      {
-        xmax = sourceA(i, 0);
-      }
-      else if (sourceA(i, 0) < xmin)
-      {
-        xmin = sourceA(i, 0);
-      }
+      // Always write the index, but only keep it if the point is an inlier.
+      inliers[count] = i;
+      count += (dx * dx + dy * dy < max_error_sq) ? 1 : 0;
+    }
 
-      if (sourceA(i, 1) > ymax)
+    return count;
+  }
+
+  /**
+   * Fits and scores hypotheses for the 2D RANSAC loops.  Each hypothesis is
+   * fit to 3 point pairs, rejected if it is far from rigid, and scored by
+   * the number of pairs it maps to within max_error of each other.
+   */
+  class Rigid2DSampler
+  {
+  public:
+    static const uint32_t NumberOfPointsToSample = 3;
+
+    Rigid2DSampler(const std::vector<PointPair2D>& pairs, double max_error) :
+      pairs_(pairs),
+      max_error_(max_error)
+    {
+    }
+
+    /**
+     * Evaluates the hypothesis fit to the sampled pairs.
+     *
+     * @param[in]  sample   The indices of the sampled pairs
+     * @param[out] inliers  The indices of the inliers, which must be sized
+     *                      to the number of pairs
+     *
+     * @returns The number of inliers, or 0 if the hypothesis is rejected.
+     */
+    size_t Evaluate(
+        const std::vector<uint32_t>& sample,
+        std::vector<uint32_t>& inliers)
+    {
+      const double maxRNorm = 0.000000000000001;
+
+      // When multiple potential matches are allowed, the sample has the
+      // potential to be exactly singular, in which case the transform is
+      // obviously no good.
+      double X[3][2];
+      double cn;  // condition number
+      double rnorm;
+      if (!SolveSample(pairs_[sample[0]], pairs_[sample[1]], pairs_[sample[2]], X, cn, rnorm))
       {
-        ymax = sourceA(i, 1);
+        return 0;
       }
-      else if (sourceA(i, 1) < ymin)
+
+      // Check to see whether the rotation matrix is close to valid
+      // TODO(kkozak): Parameterize this
+      if (fabs(cn - 1.0) > .1 || rnorm > maxRNorm)
       {
-        ymin = sourceA(i, 1);
+        return 0;
       }
-    }
-
-    // Specify RANSAC Parameters:
-    uint32_t NumberOfPointsToSample = 3;
-    uint32_t MinNumValidPointsNeeded = 6;
-    double   EscapeLevel = 0.8;
-    // Perhaps change this to be a fraction of max range or make it a parameter
-    double   MaxReprojError = max_error;
-    double   maxRNorm = 0.000000000000001;
 
+      return FindInliers(pairs_, X, max_error_, inliers);
+    }
 
-    // Setup the matrices for doing the sample estimates of the Transformation
-    // Matrix
-    LaGenMatDouble A(NumberOfPointsToSample, 3);
-    LaGenMatDouble B(NumberOfPointsToSample, 2);
-    LaGenMatDouble X(3, 2);
-    LaGenMatDouble X_good(3, 2);
-
+  private:
+    const std::vector<PointPair2D>& pairs_;
+    double max_error_;
+  };
 
-    // Do RANSAC
-    for (uint32_t i = 0; i < max_iterations; ++i)
+  /**
+   * A pair of corresponding 3D points.
+   */
+  struct PointPair3D
+  {
+    double x1;
+    double y1;
+    double z1;
+    double x2;
+    double y2;
+    double z2;
+  };
+
+  /**
+   * Fits and scores hypotheses for the 3D RANSAC loops.  Each hypothesis is
+   * a least squares fit to 6 point pairs, with the rotation replaced by the
+   * nearest orthonormal matrix.  It is rejected if it is far from rigid, and
+   * scored by the number of pairs it maps to within max_error of each other.
+   *
+   * Each sampler owns its LAPACK++ work matrices, so separate threads must
+   * use separate samplers.
+   */
+  class Rigid3DSampler
+  {
+  public:
+    static const uint32_t NumberOfPointsToSample = 6;
+
+    Rigid3DSampler(const std::vector<PointPair3D>& pairs, double max_error) :
+      pairs_(pairs),
+      max_error_(max_error),
+      A_(NumberOfPointsToSample, 4),
+      B_(NumberOfPointsToSample, 3),
+      X_(4, 3)
     {
-      std::vector<uint32_t> p1;
+    }
 
-      // Generate a random set of indices
-      RandPermSet(NumPoints, NumberOfPointsToSample, p1);
+    /**
+     * Evaluates the hypothesis fit to the sampled pairs.
+     *
+     * @param[in]  sample   The indices of the sampled pairs
+     * @param[out] inliers  The indices of the inliers, which must be sized
+     *                      to the number of pairs
+     *
+     * @returns The number of inliers, or 0 if the hypothesis is rejected.
+     */
+    size_t Evaluate(
+        const std::vector<uint32_t>& sample,
+        std::vector<uint32_t>& inliers)
+    {
+      const double maxRNorm = 0.000000000000001;
 
-      // Fill the matrices used to solve for the Sample Transformation Matrix, X
-      for (uint32_t j = 0; j < p1.size(); j++)
+      // Fill the matrices used to solve for the Sample Transformation Matrix
+      for (uint32_t j = 0; j < sample.size(); j++)
       {
-        A(j, 0) = sourceA(p1[j], 0);
-        A(j, 1) = sourceA(p1[j], 1);
-        A(j, 2) = 1.0;
-
-        B(j, 0) = sourceB(p1[j], 0);
-        B(j, 1) = sourceB(p1[j], 1);
+        const PointPair3D& pair = pairs_[sample[j]];
+        A_(j, 0) = pair.x1;
+        A_(j, 1) = pair.y1;
+        A_(j, 2) = pair.z1;
+        A_(j, 3) = 1.0;
+
+        B_(j, 0) = pair.x2;
+        B_(j, 1) = pair.y2;
+        B_(j, 2) = pair.z2;
       }
 
-      // Solve for the Transformation matrix, X
+      double cn;
+      double rnorm;
       try
       {
-        LaLinearSolve(A, X, B);
+        LaLinearSolve(A_, X_, B_);
+        RegularizeTransform(X_, cn, rnorm);
       }
       catch (const std::exception& e)
       {
-        // ROS_INFO("Got LaLinearSolve Error ignore OK: %s", e.what());
-        // when multiple potential matches are allowed, this has the potential
-        // to be exactly singular
-        continue;
+        return 0;
       }
 
-      double cn;  // condition number
-      double rnorm;
-      RegularizeTransform(X, cn, rnorm);
-
       // Check to see whether the rotation matrix is close to valid
       // TODO(kkozak): Parameterize this
-      if (fabs(cn - 1.0) > .1 || rnorm > maxRNorm)
+      if (fabs(cn - 1.0) > 0.1 || rnorm > maxRNorm)
       {
-        // ROS_ERROR("Did not meet condition number or rnorm criteria: cn = %f,
-        // rnorm = %g",cn,rnorm);
-        continue;
+        return 0;
       }
 
-      // tempA is a list vectors between projected points and actual points
-      tempA = sourceB;
-      // The following implements: tempA = sourceA_aug * X - sourceB;
-      Blas_Mat_Mat_Mult(sourceA_aug, X, tempA, false, false, 1.0, -1.0);
-
-      // Find all of the points within the re-projection error bound (add their
-      // indices to temp_points)
-      std::vector<uint32_t> temp_points;
-      for (int j = 0; j < tempA.rows(); j++)
+      double X[4][3];
+      for (int32_t i = 0; i < 4; i++)
       {
-        double dist = sqrt(pow(tempA(j, 0), 2) + pow(tempA(j, 1), 2));
-
-        if (dist < MaxReprojError)
+        for (int32_t j = 0; j < 3; j++)
         {
-          temp_points.push_back(j);
+          X[i][j] = X_(i, j);
         }
       }
 
-      if (temp_points.size() > good_points.size())
+      // Find all of the points within the re-projection error bound,
+      // always writing the index but only keeping it for inliers.
+      double max_error_sq = max_error_ * max_error_;
+      size_t count = 0;
+      for (size_t i = 0; i < pairs_.size(); i++)
+      {
+        const PointPair3D& pair = pairs_[i];
+        double dx = pair.x1 * X[0][0] + pair.y1 * X[1][0] + pair.z1 * X[2][0] + X[3][0] - pair.x2;
+        double dy = pair.x1 * X[0][1] + pair.y1 * X[1][1] + pair.z1 * X[2][1] + X[3][1] - pair.y2;
+        double dz = pair.x1 * X[0][2] + pair.y1 * X[1][2] + pair.z1 * X[2][2] + X[3][2] - pair.z2;
+
+        inliers[count] = i;
+        count += (dx * dx + dy * dy + dz * dz < max_error_sq) ? 1 : 0;
+      }
+
+      return count;
+    }
+
+  private:
+    const std::vector<PointPair3D>& pairs_;
+    double max_error_;
+
+    LaGenMatDouble A_;
+    LaGenMatDouble B_;
+    LaGenMatDouble X_;
+  };
+
+  /**
+   * The serial RANSAC loop shared by the transform estimators.  The samples
+   * are drawn with the global rand() if seed is NULL, and from the state
+   * pointed to by seed otherwise.
+   *
+   * Nothing is allocated inside the loop by the 2D sampler.
+   *
+   * @param[in]  pairs           The point pairs
+   * @param[in]  max_iterations  The maximum number of samples to try
+   * @param[in]  max_error       The inlier distance threshold
+   * @param[in]  min_points      The minimum number of inliers for a valid
+   *                             transform
+   * @param[in]  seed            The sample generator state, or NULL
+   * @param[out] good_points     The indices of the largest consensus set
+   */
+  template <class Sampler, class PointPair>
+  static void Ransac(
+      const std::vector<PointPair>& pairs,
+      uint32_t max_iterations,
+      double max_error,
+      uint32_t min_points,
+      uint32_t* seed,
+      std::vector<uint32_t>& good_points)
+  {
+    const double EscapeLevel = 0.8;
+
+    uint32_t NumPoints = pairs.size();
+    uint32_t escape_count = std::max(
+        min_points,
+        static_cast<uint32_t>(EscapeLevel * static_cast<double>(NumPoints)));
+
+    Sampler sampler(pairs, max_error);
+
+    std::vector<uint32_t> best_points(NumPoints);
+    std::vector<uint32_t> temp_points(NumPoints);
+    size_t best_count = 0;
+
+    std::vector<uint32_t> p1;
+    p1.reserve(Sampler::NumberOfPointsToSample);
+
+    for (uint32_t i = 0; i < max_iterations; ++i)
+    {
+      // Generate a random set of indices
+      if (seed)
+      {
+        RandPermSet(NumPoints, Sampler::NumberOfPointsToSample, p1, *seed);
+      }
+      else
+      {
+        RandPermSet(NumPoints, Sampler::NumberOfPointsToSample, p1);
+      }
+
+      size_t count = sampler.Evaluate(p1, temp_points);
+      if (count > best_count)
       {
-        good_points = temp_points;
+        best_count = count;
+        best_points.swap(temp_points);
       }
 
-      if (good_points.size() >= MinNumValidPointsNeeded
-          && good_points.size() >= static_cast<uint32_t>(EscapeLevel*static_cast<double>(NumPoints)))
+      if (best_count >= escape_count)
       {
         break;
         // We've met the escape criteria, so we don't need to keep iterating
       }
-    }  // end of 100 iterations
+    }
 
+    good_points.assign(best_points.begin(), best_points.begin() + best_count);
+  }
 
-    if (good_points.size() >= MinNumValidPointsNeeded)
+  /**
+   * Derives the sample generator state for one iteration of a parallel
+   * RANSAC search from the search seed, so that each sample is the same no
+   * matter which thread draws it.
+   */
+  static uint32_t IterationSeed(uint32_t seed, uint32_t iteration)
+  {
+    uint32_t state = seed + iteration * 0x9e3779b9u;
+    state ^= state >> 16;
+    state *= 0x85ebca6bu;
+    state ^= state >> 13;
+    state *= 0xc2b2ae35u;
+    state ^= state >> 16;
+    return state;
+  }
+
+  /**
+   * The consensus shared by the workers of a parallel RANSAC search.
+   *
+   * The workers take blocks of iterations in order, and report the best
+   * hypothesis of each block.  The search ends at the first iteration whose
+   * hypothesis meets the escape criterion, which is also the hypothesis the
+   * serial loop would have stopped on, since every earlier one had fewer
+   * inliers.  Otherwise the best hypothesis wins, with ties going to the
+   * earliest iteration.  Either way the result doesn't depend on the number
+   * of threads or how they are scheduled.
+   */
+  class RansacConsensus
+  {
+  public:
+    RansacConsensus(uint32_t max_iterations, uint32_t escape_count) :
+      escape_count_(escape_count),
+      next_iteration_(0),
+      escape_iteration_(max_iterations),
+      best_iteration_(max_iterations),
+      best_count_(0)
     {
-      // Compute a final transform using all the valid points.
-      if (row_order)
+    }
+
+    /**
+     * Gets the next block of iterations to evaluate.
+     *
+     * @returns False if there are no iterations left before the end of the
+     *          search.
+     */
+    bool NextBlock(uint32_t& start, uint32_t& end)
+    {
+      const uint32_t block_size = 16;
+
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      start = next_iteration_;
+      end = std::min(start + block_size, escape_iteration_);
+      next_iteration_ = end;
+      return start < end;
+    }
+
+    /**
+     * Reports the best hypothesis of a block.
+     */
+    void Report(
+        uint32_t iteration,
+        const std::vector<uint32_t>& inliers,
+        size_t count)
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      if (iteration >= escape_iteration_)
       {
-        inliers1 = cv::Mat(good_points.size(), 1, CV_32FC2);
-        inliers2 = cv::Mat(good_points.size(), 1, CV_32FC2);
+        return;
       }
-      else
+
+      // An escaping hypothesis has more inliers than any before it, and
+      // replaces any later hypothesis that was reported first.
+      bool escape = count >= escape_count_;
+      if (escape)
       {
-        inliers1 = cv::Mat(1, good_points.size(), CV_32FC2);
-        inliers2 = cv::Mat(1, good_points.size(), CV_32FC2);
+        escape_iteration_ = iteration;
       }
 
-      for (uint32_t i = 0; i < good_points.size(); ++i)
+      if (escape || count > best_count_ || (count == best_count_ && iteration < best_iteration_))
+      {
+        best_iteration_ = iteration;
+        best_count_ = count;
+        best_points_.assign(inliers.begin(), inliers.begin() + count);
+      }
+    }
+
+    /**
+     * Gets the number of inliers which ends the search.
+     */
+    uint32_t EscapeCount() const
+    {
+      return escape_count_;
+    }
+
+    /**
+     * Gets the inliers of the winning hypothesis once the workers are done.
+     */
+    void Result(std::vector<uint32_t>& good_points)
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      good_points = best_points_;
+    }
+
+  private:
+    boost::mutex mutex_;
+
+    uint32_t escape_count_;
+    uint32_t next_iteration_;
+    uint32_t escape_iteration_;
+
+    uint32_t best_iteration_;
+    size_t best_count_;
+    std::vector<uint32_t> best_points_;
+  };
+
+  /**
+   * A worker of a parallel RANSAC search, which evaluates blocks of
+   * iterations with its own sampler until the search is done.
+   */
+  template <class Sampler, class PointPair>
+  static void RansacWorker(
+      const std::vector<PointPair>& pairs,
+      double max_error,
+      uint32_t seed,
+      RansacConsensus& consensus)
+  {
+    Sampler sampler(pairs, max_error);
+
+    uint32_t NumPoints = pairs.size();
+    std::vector<uint32_t> best_points(NumPoints);
+    std::vector<uint32_t> temp_points(NumPoints);
+
+    std::vector<uint32_t> p1;
+    p1.reserve(Sampler::NumberOfPointsToSample);
+
+    uint32_t start;
+    uint32_t end;
+    while (consensus.NextBlock(start, end))
+    {
+      uint32_t best_iteration = start;
+      size_t best_count = 0;
+      for (uint32_t i = start; i < end; i++)
       {
-        if (row_order)
+        uint32_t state = IterationSeed(seed, i);
+        RandPermSet(NumPoints, Sampler::NumberOfPointsToSample, p1, state);
+
+        size_t count = sampler.Evaluate(p1, temp_points);
+        if (count > best_count)
         {
-          inliers1.at<cv::Vec2f>(i, 0) =
-              cv::Vec2f(sourceA(good_points[i], 0), sourceA(good_points[i], 1));
-          inliers2.at<cv::Vec2f>(i, 0) =
-              cv::Vec2f(sourceB(good_points[i], 0), sourceB(good_points[i], 1));
+          best_iteration = i;
+          best_count = count;
+          best_points.swap(temp_points);
         }
-        else
+
+        // The rest of the block can't affect the result.
+        if (best_count >= consensus.EscapeCount())
         {
-          inliers1.at<cv::Vec2f>(0, i) =
-              cv::Vec2f(sourceA(good_points[i], 0), sourceA(good_points[i], 1));
-          inliers2.at<cv::Vec2f>(0, i) =
-              cv::Vec2f(sourceB(good_points[i], 0), sourceB(good_points[i], 1));
+          break;
         }
       }
 
+      consensus.Report(best_iteration, best_points, best_count);
+    }
+  }
+
+  /**
+   * Runs a RANSAC search with the iterations spread across the threads of a
+   * worker pool.  The result is the same for a given seed regardless of the
+   * number of threads.
+   *
+   * @param[in]  pairs           The point pairs
+   * @param[in]  max_iterations  The maximum number of samples to try
+   * @param[in]  max_error       The inlier distance threshold
+   * @param[in]  min_points      The minimum number of inliers for a valid
+   *                             transform
+   * @param[in]  seed            The seed for the sample generators
+   * @param[in]  pool            The threads to run the iterations on
+   * @param[out] good_points     The indices of the winning consensus set
+   */
+  template <class Sampler, class PointPair>
+  static void ParallelRansac(
+      const std::vector<PointPair>& pairs,
+      uint32_t max_iterations,
+      double max_error,
+      uint32_t min_points,
+      uint32_t seed,
+      WorkerPool& pool,
+      std::vector<uint32_t>& good_points)
+  {
+    const double EscapeLevel = 0.8;
+
+    uint32_t escape_count = std::max(
+        min_points,
+        static_cast<uint32_t>(EscapeLevel * static_cast<double>(pairs.size())));
+
+    RansacConsensus consensus(max_iterations, escape_count);
+
+    if (pool.Size() == 1)
+    {
+      RansacWorker<Sampler>(pairs, max_error, seed, consensus);
+    }
+    else
+    {
+      // The workers take their iterations from the consensus, so they don't
+      // need their thread index.
+      pool.Run(boost::bind(
+          &RansacWorker<Sampler, PointPair>,
+          boost::cref(pairs),
+          max_error,
+          seed,
+          boost::ref(consensus)));
+    }
+
+    consensus.Result(good_points);
+  }
+
+  /**
+   * Computes the rigid 2D transform.  The RANSAC search runs serially with
+   * the global rand() if seed is NULL, and on the pool with per-iteration
+   * seeds derived from seed otherwise.
+   */
+  static cv::Mat Rigid2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      std::vector<uint32_t> &good_points,
+      int32_t max_iterations,
+      double max_error,
+      const uint32_t* seed,
+      WorkerPool* pool)
+  {
+    cv::Mat T;
+    // Here we are trying to compute the transformation matrix T, where T most
+    // closely satisfies the relationship
+    // T*[points1(i);1] = [points2(i);1] for inlying points in both sets
+    // We use RANSAC to exclude outliers
+
+    // First build the input vectors
+    if (!ValidPointsForTransform(points1, points2))
+    {
+      ROS_ERROR("Invalid points for calculating transform.");
+      return T;
+    }
+
+    bool row_order = points1.rows > 1;
+
+    std::vector<PointPair2D> pairs;
+    PackPointPairs(points1, points2, pairs);
+
+    uint32_t MinNumValidPointsNeeded = 6;
+
+    if (seed)
+    {
+      ParallelRansac<Rigid2DSampler>(
+          pairs, std::max(0, max_iterations), max_error, MinNumValidPointsNeeded, *seed, *pool, good_points);
+    }
+    else
+    {
+      Ransac<Rigid2DSampler>(
+          pairs, std::max(0, max_iterations), max_error, MinNumValidPointsNeeded, NULL, good_points);
+    }
+
+    if (good_points.size() >= MinNumValidPointsNeeded)
+    {
+      // Compute a final transform using all the valid points.
+      UnpackPointPairs(pairs, good_points, row_order, inliers1, inliers2);
+
       T = LeastSqauresRigid2DTransform(inliers1, inliers2);
     }
     else
@@ -571,13 +1068,63 @@ namespace image_util
     return T;
   }
 
-  cv::Mat ComputeLooseAffine2DTransform(
+  cv::Mat ComputeRigid2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      std::vector<uint32_t> &good_points, 
+      int32_t max_iterations,
+      double max_error)
+  {
+    return Rigid2DTransform(
+        points1, points2, inliers1, inliers2, good_points, max_iterations, max_error, NULL, NULL);
+  }
+
+  cv::Mat ComputeRigid2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      std::vector<uint32_t> &good_points,
+      int32_t max_iterations,
+      double max_error,
+      uint32_t seed,
+      int32_t threads)
+  {
+    WorkerPool pool(threads);
+    return Rigid2DTransform(
+        points1, points2, inliers1, inliers2, good_points, max_iterations, max_error, &seed, &pool);
+  }
+
+  cv::Mat ComputeRigid2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      std::vector<uint32_t> &good_points,
+      int32_t max_iterations,
+      double max_error,
+      uint32_t seed,
+      WorkerPool& pool)
+  {
+    return Rigid2DTransform(
+        points1, points2, inliers1, inliers2, good_points, max_iterations, max_error, &seed, &pool);
+  }
+
+  /**
+   * Computes the loose affine transform.  The RANSAC samples are drawn with
+   * the global rand() if seed is NULL, and from the state pointed to by seed
+   * otherwise.
+   */
+  static cv::Mat LooseAffine2DTransform(
       const cv::Mat& points1,
       const cv::Mat& points2,
       cv::Mat& inliers1,
       cv::Mat& inliers2,
       cv::Mat& T_rigid,
-      double& rms_error)
+      double& rms_error,
+      uint32_t* seed)
   {
     cv::Mat Affine;
     std::vector<uint32_t> good_points;
@@ -587,211 +1134,45 @@ namespace image_util
     // We use RANSAC to exclude outliers
 
     // First build the input vectors
-    bool row_order = true;
     if (!ValidPointsForTransform(points1, points2))
     {
       ROS_ERROR("Invalid points for calculating transform.");
       return Affine;
     }
 
-    uint32_t NumPoints = points1.cols;
-    if (points1.rows > 1)
-    {
-      row_order = false;
-      NumPoints = points1.rows;
-    }
-
-    // Setup matrices for holding all of the points
-    LaGenMatDouble sourceA(NumPoints, 2);
-    LaGenMatDouble sourceA_aug(NumPoints, 3);
-    LaGenMatDouble sourceB(NumPoints, 2);
-    LaGenMatDouble tempA(NumPoints, 2);
-
-    double xmax = -1.0e20;
-    double xmin = 1.0e20;
-    double ymax = xmax;
-    double ymin = xmin;
-
-    // Convert from cv::Mat to LaGenMatDouble
-    for (uint32_t i = 0; i < NumPoints; i++)
-    {
-      // Points from first frame
-      if (row_order)
-      {
-        sourceA(i, 0) = points1.at<cv::Vec2f>(0, i)[0];
-        sourceA(i, 1) = points1.at<cv::Vec2f>(0, i)[1];
-        sourceB(i, 0) = points2.at<cv::Vec2f>(0, i)[0];
-        sourceB(i, 1) = points2.at<cv::Vec2f>(0, i)[1];
-        sourceA_aug(i, 0) = points1.at<cv::Vec2f>(0, i)[0];
-        sourceA_aug(i, 1) = points1.at<cv::Vec2f>(0, i)[1];
-      }
-      else
-      {
-        sourceA(i, 0) = points1.at<cv::Vec2f>(i, 0)[0];
-        sourceA(i, 1) = points1.at<cv::Vec2f>(i, 0)[1];
-        sourceB(i, 0) = points2.at<cv::Vec2f>(i, 0)[0];
-        sourceB(i, 1) = points2.at<cv::Vec2f>(i, 0)[1];
-        sourceA_aug(i, 0) = points1.at<cv::Vec2f>(i, 0)[0];
-        sourceA_aug(i, 1) = points1.at<cv::Vec2f>(i, 0)[1];
-      }
-      sourceA_aug(i, 2) = 1.0;
-
-      // Find the range of the data;
-      if (sourceA(i, 0) > xmax)
-      {
-        xmax = sourceA(i, 0);
-      }
-      else if (sourceA(i, 0) < xmin)
-      {
-        xmin = sourceA(i, 0);
-      }
+    bool row_order = points1.rows > 1;
 
-      if (sourceA(i, 1) > ymax)
-      {
-        ymax = sourceA(i, 1);
-      }
-      else if (sourceA(i, 1) < ymin)
-      {
-        ymin = sourceA(i, 1);
-      }
-    }
+    std::vector<PointPair2D> pairs;
+    PackPointPairs(points1, points2, pairs);
 
     // Specify RANSAC Parameters:
-    uint32_t NumberOfPointsToSample = 3;
     uint32_t MaxNumberOfIterations = 100;
     uint32_t MinNumValidPointsNeeded = 6;
-    double   EscapeLevel = 0.8;
     // Perhaps change this to be a fraction of max range or make it a parameter
     double   MaxReprojError = 30;  // Use a looser reprojection error to capture
                                    // inliers in cases where there is strong
                                    // perspective distortion
-    double   maxRNorm = 0.000000000000001;
-
-
-    // Setup the matrices for doing the sample estimates of the Transformation
-    // Matrix
-    LaGenMatDouble A(NumberOfPointsToSample, 3);
-    LaGenMatDouble B(NumberOfPointsToSample, 2);
-    LaGenMatDouble X(3, 2);
-    LaGenMatDouble X_good(3, 2);
-
-    // Do RANSAC
-    for (uint32_t i = 0; i < MaxNumberOfIterations; ++i)
-    {
-      std::vector<uint32_t> p1;
-
-      // Generate a random set of indices
-      RandPermSet(NumPoints, NumberOfPointsToSample, p1);
-
-      // Fill the matrices used to solve for the Sample Transformation Matrix, X
-      for (uint32_t j = 0; j < p1.size(); j++)
-      {
-        A(j, 0) = sourceA(p1[j], 0);
-        A(j, 1) = sourceA(p1[j], 1);
-        A(j, 2) = 1.0;
-
-        B(j, 0) = sourceB(p1[j], 0);
-        B(j, 1) = sourceB(p1[j], 1);
-      }
-
-      // Solve for the Transformation matrix, X
-      try
-      {
-        LaLinearSolve(A, X, B);
-      }
-      catch (const std::exception& e)
-      {
-        // when multiple potential matches are allowed, this has the potential
-        // to be exactly singular, and when it is, LAPACK may/will throw an
-        // exception.  In those cases, the computed transform would obviously
-        // be no good so just continue;
-        continue;
-      }
-
-      double cn;  // condition number
-      double rnorm;
-      RegularizeTransform(X, cn, rnorm);
-
-      // Check to see whether the rotation matrix is close to valid
-      // TODO(kkozak): Parameterize this
-      if (fabs(cn - 1.0) > .1 || rnorm > maxRNorm)
-      {
-        // ROS_ERROR("Did not meet condition number or rnorm criteria: cn = %f,
-        // rnorm = %g",cn,rnorm);
-        continue;
-      }
-
-      // tempA is a list vectors between projected points and actual points
-      tempA = sourceB;
-      //  The following implements: tempA = sourceA_aug * X - sourceB;
-      Blas_Mat_Mat_Mult(sourceA_aug, X, tempA, false, false, 1.0, -1.0);
-
-      // Find all of the points within the re-projection error bound (add their
-      // indices to temp_points)
-      std::vector<uint32_t> temp_points;
-      for (int j = 0; j < tempA.rows(); j++)
-      {
-        double dist = sqrt(pow(tempA(j, 0), 2) + pow(tempA(j, 1), 2));
-
-        if (dist < MaxReprojError)
-        {
-          temp_points.push_back(j);
-        }
-      }
-
-      if (temp_points.size() > good_points.size())
-      {
-        good_points = temp_points;
-      }
-
-      if (good_points.size() >= MinNumValidPointsNeeded
-          && good_points.size() >= static_cast<uint32_t>(EscapeLevel * static_cast<double>(NumPoints)))
-      {
-        break;
-        // We've met the escape criteria, so we don't need to keep iterating
-      }
-    }  // end of 100 iterations
 
+    Ransac<Rigid2DSampler>(
+        pairs, MaxNumberOfIterations, MaxReprojError, MinNumValidPointsNeeded, seed, good_points);
 
     if (good_points.size() >= MinNumValidPointsNeeded)
     {
-      if (row_order)
-      {
-        inliers1 = cv::Mat(cv::Size(good_points.size(), 1), CV_32FC2);
-        inliers2 = cv::Mat(cv::Size(good_points.size(), 1), CV_32FC2);
-      }
-      else
-      {
-        inliers1 = cv::Mat(cv::Size(1, good_points.size()), CV_32FC2);
-        inliers2 = cv::Mat(cv::Size(1, good_points.size()), CV_32FC2);
-      }
+      UnpackPointPairs(pairs, good_points, row_order, inliers1, inliers2);
 
       // Compute a final transform using all the valid points
       LaGenMatDouble A1(good_points.size(), 3);
       LaGenMatDouble B1(good_points.size(), 2);
+      LaGenMatDouble X(3, 2);
       for (uint32_t i = 0; i < good_points.size(); ++i)
       {
-        A1(i, 0) = sourceA(good_points[i], 0);
-        A1(i, 1) = sourceA(good_points[i], 1);
+        const PointPair2D& pair = pairs[good_points[i]];
+        A1(i, 0) = pair.x1;
+        A1(i, 1) = pair.y1;
         A1(i, 2) = 1.0;
 
-        B1(i, 0) = sourceB(good_points[i], 0);
-        B1(i, 1) = sourceB(good_points[i], 1);
-
-        if (row_order)
-        {
-          inliers1.at<cv::Vec2f>(i, 0) =
-              cv::Vec2f(sourceA(good_points[i], 0), sourceA(good_points[i], 1));
-          inliers2.at<cv::Vec2f>(i, 0) =
-              cv::Vec2f(sourceB(good_points[i], 0), sourceB(good_points[i], 1));
-        }
-        else
-        {
-          inliers1.at<cv::Vec2f>(0, i) =
-              cv::Vec2f(sourceA(good_points[i], 0), sourceA(good_points[i], 1));
-          inliers2.at<cv::Vec2f>(0, i) =
-              cv::Vec2f(sourceB(good_points[i], 0), sourceB(good_points[i], 1));
-        }
+        B1(i, 0) = pair.x2;
+        B1(i, 1) = pair.y2;
       }
       // Solve for the Transformation matrix, X
       LaLinearSolve(A1, X, B1);
@@ -811,7 +1192,7 @@ namespace image_util
 
       // Compute the Mean Squared Error
       // tempA is a list vectors between projected points and actual points
-      tempA = B1;
+      LaGenMatDouble tempA = B1;
       // The following implements: tempA = sourceA_aug * X - sourceB;
       LaGenMatDouble X_short_temp = X;
       double cn1;
@@ -874,7 +1255,41 @@ namespace image_util
     return Affine;
   }
 
-  cv::Mat ComputeRigid3DTransform(cv::Mat& points1, cv::Mat& points2)
+  cv::Mat ComputeLooseAffine2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      cv::Mat& T_rigid,
+      double& rms_error)
+  {
+    return LooseAffine2DTransform(
+        points1, points2, inliers1, inliers2, T_rigid, rms_error, NULL);
+  }
+
+  cv::Mat ComputeLooseAffine2DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      cv::Mat& inliers1,
+      cv::Mat& inliers2,
+      cv::Mat& T_rigid,
+      double& rms_error,
+      uint32_t seed)
+  {
+    return LooseAffine2DTransform(
+        points1, points2, inliers1, inliers2, T_rigid, rms_error, &seed);
+  }
+
+  /**
+   * Computes the rigid 3D transform.  The RANSAC search runs serially with
+   * the global rand() if seed is NULL, and on the pool with per-iteration
+   * seeds derived from seed otherwise.
+   */
+  static cv::Mat Rigid3DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      const uint32_t* seed,
+      WorkerPool* pool)
   {
     cv::Mat T;
     // Here we are trying to compute the transformation matrix T, where T most
@@ -899,139 +1314,37 @@ namespace image_util
 
     uint32_t NumPoints = points1.cols;
 
-    // Setup matrices for holding all of the points
-    LaGenMatDouble sourceA(NumPoints, 3);
-    LaGenMatDouble sourceA_aug(NumPoints, 4);
-    LaGenMatDouble sourceB(NumPoints, 3);
-    LaGenMatDouble tempA(NumPoints, 3);
-
-    double xmax = -1.0e20;
-    double xmin = 1.0e20;
-    double ymax = xmax;
-    double ymin = xmin;
-
-    // Convert from cv::Mat to LaGenMatDouble
+    std::vector<PointPair3D> pairs(NumPoints);
     for (uint32_t i = 0; i < NumPoints; i++)
     {
-      // Points from first frame
-      sourceA(i, 0) = points1.at<cv::Vec3f>(0, i)[0];
-      sourceA(i, 1) = points1.at<cv::Vec3f>(0, i)[1];
-      sourceA(i, 2) = points1.at<cv::Vec3f>(0, i)[2];
-
-      // Find the range of the data;
-      if (sourceA(i, 0) > xmax)
-      {
-        xmax = sourceA(i, 0);
-      }
-      else if (sourceA(i, 0) < xmin)
-      {
-        xmin = sourceA(i, 0);
-      }
-
-      if (sourceA(i, 1) > ymax)
-      {
-        ymax = sourceA(i, 1);
-      }
-      else if (sourceA(i, 1) < ymin)
-      {
-        ymin = sourceA(i, 1);
-      }
-
-      // setup augmented vectors
-      sourceA_aug(i, 0) = points1.at<cv::Vec3f>(0, i)[0];
-      sourceA_aug(i, 1) = points1.at<cv::Vec3f>(0, i)[1];
-      sourceA_aug(i, 2) = points1.at<cv::Vec3f>(0, i)[2];
-      sourceA_aug(i, 3) = 1.0;
-
-      sourceB(i, 0) = points2.at<cv::Vec3f>(0, i)[0];
-      sourceB(i, 1) = points2.at<cv::Vec3f>(0, i)[1];
-      sourceB(i, 2) = points2.at<cv::Vec3f>(0, i)[2];
+      const cv::Vec3f& point1 = points1.at<cv::Vec3f>(0, i);
+      const cv::Vec3f& point2 = points2.at<cv::Vec3f>(0, i);
+      pairs[i].x1 = point1[0];
+      pairs[i].y1 = point1[1];
+      pairs[i].z1 = point1[2];
+      pairs[i].x2 = point2[0];
+      pairs[i].y2 = point2[1];
+      pairs[i].z2 = point2[2];
     }
 
     // Specify RANSAC Parameters:
-    uint32_t NumberOfPointsToSample = 6;
     uint32_t MaxNumberOfIterations = 100;
     uint32_t MinNumValidPointsNeeded = 8;
-    double   EscapeLevel = 0.8;
     // Perhaps change this to be a fraction of max range or make it a parameter
     double   MaxReprojError = 1.0;
-    double   maxRNorm = 0.000000000000001;
     std::vector<uint32_t> good_points;
 
-    // Setup the matrices for doing the sample estimates of the Transformation
-    // Matrix
-    LaGenMatDouble A(NumberOfPointsToSample, 4);
-    LaGenMatDouble B(NumberOfPointsToSample, 3);
-    LaGenMatDouble X(4, 3);
-    LaGenMatDouble X_good(4, 3);
-
-    // Do RANSAC
-    for (uint32_t i = 0; i < MaxNumberOfIterations; ++i)
+    if (NumPoints >= Rigid3DSampler::NumberOfPointsToSample)
     {
-      std::vector<uint32_t> p1;
-
-      // Generate a random set of indices
-      RandPermSet(NumPoints, NumberOfPointsToSample, p1);
-
-      // Fill the matrices used to solve for the Sample Transformation Matrix, X
-      for (uint32_t j = 0; j < p1.size(); j++)
+      if (seed)
       {
-        A(j, 0) = sourceA(p1[j], 0);
-        A(j, 1) = sourceA(p1[j], 1);
-        A(j, 2) = sourceA(p1[j], 2);
-        A(j, 3) = 1.0;
-
-        B(j, 0) = sourceB(p1[j], 0);
-        B(j, 1) = sourceB(p1[j], 1);
-        B(j, 2) = sourceB(p1[j], 2);
+        ParallelRansac<Rigid3DSampler>(
+            pairs, MaxNumberOfIterations, MaxReprojError, MinNumValidPointsNeeded, *seed, *pool, good_points);
       }
-
-      // Solve for the Transformation matrix, X
-      LaLinearSolve(A, X, B);
-
-      double cn;
-      double rnorm;
-      RegularizeTransform(X, cn, rnorm);
-
-      // Check to see whether the rotation matrix is close to valid
-      // TODO(kkozak): Parameterize this
-      if (fabs(cn - 1.0) > 0.1 || rnorm > maxRNorm)
-      {
-        // ROS_ERROR("Did not meet condition number or rnorm criteria: "
-        // "cn = %f, rnorm = %f",cn,rnorm);
-        continue;
-      }
-
-      // tempA is a list vectors between projected points and actual points
-      tempA = sourceB;
-      // The following implements: tempA = sourceA_aug * X - sourceB;
-      Blas_Mat_Mat_Mult(sourceA_aug, X, tempA, false, false, 1.0, -1.0);
-
-
-      // Find all of the points within the re-projection error bound (add their
-      // indices to temp_points)
-      std::vector<uint32_t> temp_points;
-      for (int j = 0; j < tempA.rows(); j++)
-      {
-        double dist = sqrt(pow(tempA(j, 0), 2) + pow(tempA(j, 1), 2) +
-                           pow(tempA(j, 2), 2));
-
-        if (dist < MaxReprojError)
-        {
-          temp_points.push_back(j);
-        }
-      }
-
-      if (temp_points.size() > good_points.size())
-      {
-        good_points = temp_points;
-      }
-
-      if (good_points.size() >= MinNumValidPointsNeeded
-          && good_points.size() >= static_cast<uint32_t>(EscapeLevel*static_cast<double>(NumPoints)))
+      else
       {
-        break;
-        // We've met the escape criteria, so we don't need to keep iterating
+        Ransac<Rigid3DSampler>(
+            pairs, MaxNumberOfIterations, MaxReprojError, MinNumValidPointsNeeded, NULL, good_points);
       }
     }
 
@@ -1041,16 +1354,18 @@ namespace image_util
       // valid points
       LaGenMatDouble A1(good_points.size(), 4);
       LaGenMatDouble B1(good_points.size(), 3);
+      LaGenMatDouble X(4, 3);
       for (uint32_t i = 0; i < good_points.size(); ++i)
       {
-        A1(i, 0) = sourceA(good_points[i], 0);
-        A1(i, 1) = sourceA(good_points[i], 1);
-        A1(i, 2) = sourceA(good_points[i], 2);
+        const PointPair3D& pair = pairs[good_points[i]];
+        A1(i, 0) = pair.x1;
+        A1(i, 1) = pair.y1;
+        A1(i, 2) = pair.z1;
         A1(i, 3) = 1.0;
 
-        B1(i, 0) = sourceB(good_points[i], 0);
-        B1(i, 1) = sourceB(good_points[i], 1);
-        B1(i, 2) = sourceB(good_points[i], 2);
+        B1(i, 0) = pair.x2;
+        B1(i, 1) = pair.y2;
+        B1(i, 2) = pair.z2;
       }
 
       // Solve for the Transformation matrix, X
@@ -1072,6 +1387,30 @@ namespace image_util
     return T;
   }
 
+  cv::Mat ComputeRigid3DTransform(cv::Mat& points1, cv::Mat& points2)
+  {
+    return Rigid3DTransform(points1, points2, NULL, NULL);
+  }
+
+  cv::Mat ComputeRigid3DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      uint32_t seed,
+      int32_t threads)
+  {
+    WorkerPool pool(threads);
+    return Rigid3DTransform(points1, points2, &seed, &pool);
+  }
+
+  cv::Mat ComputeRigid3DTransform(
+      const cv::Mat& points1,
+      const cv::Mat& points2,
+      uint32_t seed,
+      WorkerPool& pool)
+  {
+    return Rigid3DTransform(points1, points2, &seed, &pool);
+  }
+
   void RegularizeTransform(
       LaGenMatDouble &T,
       double &conditionNum,
@@ -1161,4 +1500,29 @@ namespace image_util
     }
     return;
   }
+  void RandPermSet(
+      uint32_t max_num,
+      uint32_t total_samples,
+      std::vector<uint32_t>& indices,
+      uint32_t& seed)
+  {
+    indices.clear();
+
+    if (total_samples > max_num)
+    {
+      ROS_ERROR("Total samples is greater than max number. %d > %d",
+                (int)total_samples,
+                (int)max_num);
+      return;
+    }
+
+    while (indices.size() < total_samples)
+    {
+      uint32_t sample = static_cast<uint32_t>(rand_r(&seed) % static_cast<int>(max_num));
+      if (std::find(indices.begin(), indices.end(), sample) == indices.end())
+      {
+        indices.push_back(sample);
+      }
+    }
+  }
 }
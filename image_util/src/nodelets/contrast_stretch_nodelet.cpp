@@ -29,6 +29,9 @@
 
 #include <string>
 
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
@@ -38,7 +41,10 @@
 #include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/Image.h>
 #include <cv_bridge/cv_bridge.h>
+#include <image_util/latest_frame_worker.h>
+#include <image_util/image_message_pool.h>
 #include <image_util/image_normalization.h>
+#include <image_util/worker_pool.h>
 
 #include <math_util/math_util.h>
 
@@ -54,6 +60,7 @@ namespace image_util
 
     ~ContrastStretchNodelet()
     {
+      worker_.Stop();
     }
 
     void onInit()
@@ -62,6 +69,15 @@ namespace image_util
       ros::NodeHandle &priv = getPrivateNodeHandle();
 
       priv.param("bins", bins_, bins_);
+
+      // The image is stretched on the callback thread unless more threads
+      // are requested.
+      int32_t threads = 1;
+      priv.param("threads", threads, threads);
+      if (threads > 1)
+      {
+        stretch_pool_.reset(new WorkerPool(threads));
+      }
       
       std::string mask;
       priv.param("mask", mask, std::string(""));
@@ -72,26 +88,56 @@ namespace image_util
 
       image_transport::ImageTransport it(node);
       image_pub_ = it.advertise("normalized_image", 1);
-      image_sub_ = it.subscribe("image", 1, &ContrastStretchNodelet::ImageCallback, this);
+
+      bool worker_thread = false;
+      priv.param("worker_thread", worker_thread, worker_thread);
+      image_sub_ = worker_.Subscribe(
+          it,
+          "image",
+          boost::bind(&ContrastStretchNodelet::ImageCallback, this, _1),
+          worker_thread,
+          getName(),
+          node);
     }
 
     void ImageCallback(const sensor_msgs::ImageConstPtr& image)
     {
-      cv_bridge::CvImagePtr cv_image = cv_bridge::toCvCopy(image);
-
-      image_util::ContrastStretch(bins_, cv_image->image, cv_image->image, mask_);
+      // Stretch straight from the received image into a pooled message.
+      cv_bridge::CvImageConstPtr cv_image = cv_bridge::toCvShare(image);
+
+      cv::Mat stretched;
+      sensor_msgs::ImagePtr output = pool_.Get(
+          image->header,
+          image->encoding,
+          cv_image->image.size(),
+          cv_image->image.type(),
+          stretched);
+      if (stretch_pool_)
+      {
+        image_util::ContrastStretch(
+            bins_, cv_image->image, stretched, mask_, stats_, *stretch_pool_);
+      }
+      else
+      {
+        image_util::ContrastStretch(
+            bins_, cv_image->image, stretched, mask_, stats_);
+      }
 
-      image_pub_.publish(cv_image->toImageMsg());
+      image_pub_.publish(output);
     }
 
   private:
     int32_t bins_;
     
     cv::Mat mask_;
+    TileStats stats_;
+    boost::shared_ptr<WorkerPool> stretch_pool_;
+    ImageMessagePool pool_;
 
     image_transport::Subscriber image_sub_;
     image_transport::Publisher image_pub_;
 
+    LatestFrameWorker worker_;
   };
 }
 
@@ -29,6 +29,8 @@
 
 #include <string>
 
+#include <boost/bind.hpp>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -38,6 +40,8 @@
 #include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/Image.h>
 #include <cv_bridge/cv_bridge.h>
+#include <image_util/latest_frame_worker.h>
+#include <image_util/image_message_pool.h>
 #include <math_util/math_util.h>
 
 namespace image_util
@@ -56,6 +60,7 @@ namespace image_util
 
     ~DrawTextNodelet()
     {
+      worker_.Stop();
     }
 
     void onInit()
@@ -71,15 +76,35 @@ namespace image_util
 
       image_transport::ImageTransport it(node);
       image_pub_ = it.advertise("stamped_image", 1);
-      image_sub_ = it.subscribe("image", 1, &DrawTextNodelet::ImageCallback, this);
+
+      bool worker_thread = false;
+      priv.param("worker_thread", worker_thread, worker_thread);
+      image_sub_ = worker_.Subscribe(
+          it,
+          "image",
+          boost::bind(&DrawTextNodelet::ImageCallback, this, _1),
+          worker_thread,
+          getName(),
+          node);
     }
 
     void ImageCallback(const sensor_msgs::ImageConstPtr& image)
     {
-      cv_bridge::CvImagePtr cv_image = cv_bridge::toCvCopy(image);
+      // The received image may be shared with other subscribers, so it's
+      // copied once into a pooled message and drawn on there.
+      cv_bridge::CvImageConstPtr cv_image = cv_bridge::toCvShare(image);
+
+      cv::Mat stamped;
+      sensor_msgs::ImagePtr output = pool_.Get(
+          image->header,
+          image->encoding,
+          cv_image->image.size(),
+          cv_image->image.type(),
+          stamped);
+      cv_image->image.copyTo(stamped);
 
       cv::putText(
-        cv_image->image, 
+        stamped, 
         text_,
         cv::Point(offset_x_, offset_y_),
         cv::FONT_HERSHEY_SIMPLEX, 
@@ -87,7 +112,7 @@ namespace image_util
         cv::Scalar(255, 255, 255),
         font_thickness_);
 
-      image_pub_.publish(cv_image->toImageMsg());
+      image_pub_.publish(output);
     }
 
   private:
@@ -96,9 +121,13 @@ namespace image_util
     double offset_y_;
     double font_scale_;
     int font_thickness_;
+
+    ImageMessagePool pool_;
     
     image_transport::Subscriber image_sub_;
     image_transport::Publisher image_pub_;
+
+    LatestFrameWorker worker_;
   };
 }
 
@@ -0,0 +1,471 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <cstdio>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/Image.h>
+#include <cv_bridge/cv_bridge.h>
+#include <image_util/latest_frame_worker.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include <image_util/image_message_pool.h>
+#include <image_util/image_normalization.h>
+#include <image_util/image_warp_util.h>
+#include <image_util/tile_stats.h>
+#include <image_util/worker_pool.h>
+
+#include <math_util/math_util.h>
+
+namespace image_util
+{
+  /**
+   * Runs an ordered list of the image_util operations on each image in a
+   * single callback:
+   *
+   *   scale             ~scale/scale
+   *   rotate            ~rotate/angle
+   *   normalize         ~normalize/normalization_image, ~normalize/threads
+   *   contrast_stretch  ~contrast_stretch/bins, ~contrast_stretch/mask
+   *   draw_text         ~draw_text/text, offset_x, offset_y, font_scale,
+   *                     font_thickness
+   *
+   * The stages are listed in the ~stages parameter, and take the same
+   * parameters as the corresponding nodelets in a sub-namespace named after
+   * the stage.
+   *
+   * Each stage reads the output of the previous one directly.  Scaling and
+   * rotation alternate between two buffers that are kept between frames, the
+   * point operations run in place, and the last stage writes straight into
+   * the published message.  Consecutive rotations are combined into one, and
+   * stages that do nothing are dropped.
+   *
+   * The average time of each stage is published on /diagnostics every
+   * ~diagnostic_period seconds.
+   */
+  class ImagePipelineNodelet : public nodelet::Nodelet
+  {
+  public:
+    ImagePipelineNodelet() :
+      diagnostic_period_(1.0),
+      frames_(0)
+    {
+    }
+
+    ~ImagePipelineNodelet()
+    {
+      worker_.Stop();
+    }
+
+    void onInit()
+    {
+      ros::NodeHandle &node = getNodeHandle();
+      ros::NodeHandle &priv = getPrivateNodeHandle();
+
+      priv.param("diagnostic_period", diagnostic_period_, diagnostic_period_);
+
+      std::vector<std::string> stage_names;
+      XmlRpc::XmlRpcValue stages;
+      if (priv.getParam("stages", stages) &&
+          stages.getType() == XmlRpc::XmlRpcValue::TypeArray)
+      {
+        for (int32_t i = 0; i < stages.size(); i++)
+        {
+          if (stages[i].getType() == XmlRpc::XmlRpcValue::TypeString)
+          {
+            stage_names.push_back(static_cast<std::string>(stages[i]));
+          }
+        }
+      }
+      else
+      {
+        ROS_WARN("No image pipeline stages specified.");
+      }
+
+      for (size_t i = 0; i < stage_names.size(); i++)
+      {
+        AddStage(ros::NodeHandle(priv, stage_names[i]), stage_names[i]);
+      }
+
+      image_transport::ImageTransport it(node);
+      image_pub_ = it.advertise("processed_image", 1);
+
+      bool worker_thread = false;
+      priv.param("worker_thread", worker_thread, worker_thread);
+      image_sub_ = worker_.Subscribe(
+          it,
+          "image",
+          boost::bind(&ImagePipelineNodelet::ImageCallback, this, _1),
+          worker_thread,
+          getName(),
+          node);
+      diagnostic_pub_ = node.advertise<diagnostic_msgs::DiagnosticArray>(
+          "/diagnostics", 1);
+
+      last_diagnostic_time_ = ros::WallTime::now();
+    }
+
+    void ImageCallback(const sensor_msgs::ImageConstPtr& image)
+    {
+      if (stages_.empty())
+      {
+        image_pub_.publish(image);
+        return;
+      }
+
+      cv_bridge::CvImageConstPtr cv_image = cv_bridge::toCvShare(image);
+
+      const cv::Mat* current = &cv_image->image;
+      bool owned = false;
+      int32_t next_buffer = 0;
+      sensor_msgs::ImagePtr output;
+
+      for (size_t i = 0; i < stages_.size(); i++)
+      {
+        Stage& stage = *stages_[i];
+        ros::WallTime start = ros::WallTime::now();
+
+        cv::Size size = OutputSize(stage, current->size());
+        bool last = (i + 1 == stages_.size());
+
+        // Pick where this stage writes: the published message for the last
+        // stage, the current buffer for point operations, or otherwise the
+        // buffer that isn't being read.
+        cv::Mat target;
+        if (last)
+        {
+          output = pool_.Get(
+              image->header, image->encoding, size, current->type(), target);
+        }
+        else if (owned && IsPointOperation(stage))
+        {
+          target = *current;
+        }
+        else
+        {
+          buffers_[next_buffer].create(size, current->type());
+          target = buffers_[next_buffer];
+          next_buffer = 1 - next_buffer;
+        }
+
+        RunStage(stage, *current, target);
+
+        if (!last)
+        {
+          // Point at the persistent buffer, not the local header.
+          current = (target.data == buffers_[0].data) ? &buffers_[0] : &buffers_[1];
+          owned = true;
+        }
+
+        stage.total_time += (ros::WallTime::now() - start).toSec();
+      }
+
+      image_pub_.publish(output);
+
+      frames_++;
+      PublishDiagnostics();
+    }
+
+  private:
+    struct Stage
+    {
+      enum Type { SCALE, ROTATE, NORMALIZE, CONTRAST_STRETCH, DRAW_TEXT };
+
+      Stage() :
+        scale(1.0),
+        quarter_turns(0),
+        bins(8),
+        offset_x(0),
+        offset_y(0),
+        font_scale(1.0),
+        font_thickness(1),
+        total_time(0)
+      {
+      }
+
+      Type type;
+      std::string name;
+
+      double scale;
+      int32_t quarter_turns;
+
+      NormalizationApplier normalizer;
+
+      int32_t bins;
+      cv::Mat mask;
+      TileStats stats;
+      boost::shared_ptr<WorkerPool> pool;
+
+      std::string text;
+      double offset_x;
+      double offset_y;
+      double font_scale;
+      int font_thickness;
+
+      double total_time;
+    };
+    typedef boost::shared_ptr<Stage> StagePtr;
+
+    void AddStage(const ros::NodeHandle& priv, const std::string& name)
+    {
+      StagePtr stage(new Stage());
+      stage->name = name;
+
+      if (name == "scale")
+      {
+        stage->type = Stage::SCALE;
+        priv.param("scale", stage->scale, stage->scale);
+        if (stage->scale == 1.0)
+        {
+          return;
+        }
+      }
+      else if (name == "rotate")
+      {
+        // Positive angles are clockwise turns.
+        stage->type = Stage::ROTATE;
+        double angle = 0;
+        priv.param("angle", angle, angle);
+        int32_t angle_90 = static_cast<int32_t>(math_util::ToNearest(angle, 90));
+        stage->quarter_turns = ((angle_90 / 90) % 4 + 4) % 4;
+
+        if (!stages_.empty() && stages_.back()->type == Stage::ROTATE)
+        {
+          Stage& previous = *stages_.back();
+          previous.quarter_turns = (previous.quarter_turns + stage->quarter_turns) % 4;
+          if (previous.quarter_turns == 0)
+          {
+            stages_.pop_back();
+          }
+          return;
+        }
+
+        if (stage->quarter_turns == 0)
+        {
+          return;
+        }
+      }
+      else if (name == "normalize")
+      {
+        stage->type = Stage::NORMALIZE;
+        std::string filename;
+        int32_t threads = 1;
+        priv.param("normalization_image", filename, filename);
+        priv.param("threads", threads, threads);
+
+        cv::Mat norm_image;
+        if (!filename.empty())
+        {
+          norm_image = cv::imread(filename, 0);
+        }
+        stage->normalizer = NormalizationApplier(norm_image, threads);
+        if (!stage->normalizer.Initialized())
+        {
+          ROS_ERROR("Failed to load normalization image: %s", filename.c_str());
+          return;
+        }
+      }
+      else if (name == "contrast_stretch")
+      {
+        stage->type = Stage::CONTRAST_STRETCH;
+        int32_t threads = 1;
+        priv.param("bins", stage->bins, stage->bins);
+        priv.param("threads", threads, threads);
+        if (threads > 1)
+        {
+          stage->pool.reset(new WorkerPool(threads));
+        }
+        std::string mask;
+        priv.param("mask", mask, std::string(""));
+        if (!mask.empty())
+        {
+          stage->mask = cv::imread(mask, 0);
+        }
+      }
+      else if (name == "draw_text")
+      {
+        stage->type = Stage::DRAW_TEXT;
+        stage->text = "label";
+        priv.param("text", stage->text, stage->text);
+        priv.param("offset_x", stage->offset_x, stage->offset_x);
+        priv.param("offset_y", stage->offset_y, stage->offset_y);
+        priv.param("font_scale", stage->font_scale, stage->font_scale);
+        priv.param("font_thickness", stage->font_thickness, stage->font_thickness);
+      }
+      else
+      {
+        ROS_ERROR("Unknown image pipeline stage: %s", name.c_str());
+        return;
+      }
+
+      stages_.push_back(stage);
+    }
+
+    static bool IsPointOperation(const Stage& stage)
+    {
+      return stage.type == Stage::NORMALIZE ||
+          stage.type == Stage::CONTRAST_STRETCH ||
+          stage.type == Stage::DRAW_TEXT;
+    }
+
+    static cv::Size OutputSize(const Stage& stage, const cv::Size& size)
+    {
+      if (stage.type == Stage::SCALE)
+      {
+        return cv::Size(
+            math_util::Round(size.width * stage.scale),
+            math_util::Round(size.height * stage.scale));
+      }
+      else if (stage.type == Stage::ROTATE && stage.quarter_turns % 2 == 1)
+      {
+        return cv::Size(size.height, size.width);
+      }
+
+      return size;
+    }
+
+    void RunStage(Stage& stage, const cv::Mat& source, cv::Mat& target)
+    {
+      switch (stage.type)
+      {
+        case Stage::SCALE:
+          cv::resize(source, target, target.size());
+          break;
+        case Stage::ROTATE:
+          RotateImage(source, stage.quarter_turns, target);
+          break;
+        case Stage::NORMALIZE:
+          if (!stage.normalizer.Apply(source, target))
+          {
+            source.copyTo(target);
+          }
+          break;
+        case Stage::CONTRAST_STRETCH:
+          if (stage.pool)
+          {
+            ContrastStretch(stage.bins, source, target, stage.mask, stage.stats, *stage.pool);
+          }
+          else
+          {
+            ContrastStretch(stage.bins, source, target, stage.mask, stage.stats);
+          }
+          break;
+        case Stage::DRAW_TEXT:
+          if (target.data != source.data)
+          {
+            source.copyTo(target);
+          }
+          cv::putText(
+            target,
+            stage.text,
+            cv::Point(stage.offset_x, stage.offset_y),
+            cv::FONT_HERSHEY_SIMPLEX,
+            stage.font_scale,
+            cv::Scalar(255, 255, 255),
+            stage.font_thickness);
+          break;
+      }
+    }
+
+    void PublishDiagnostics()
+    {
+      ros::WallTime now = ros::WallTime::now();
+      if ((now - last_diagnostic_time_).toSec() < diagnostic_period_)
+      {
+        return;
+      }
+
+      diagnostic_msgs::DiagnosticStatus status;
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.name = getName() + ": image pipeline";
+      status.message = "Average stage times";
+
+      char buffer[64];
+      diagnostic_msgs::KeyValue value;
+      value.key = "frames";
+      std::snprintf(buffer, sizeof(buffer), "%d", frames_);
+      value.value = buffer;
+      status.values.push_back(value);
+
+      for (size_t i = 0; i < stages_.size(); i++)
+      {
+        value.key = stages_[i]->name + " (ms)";
+        std::snprintf(buffer, sizeof(buffer), "%.3f",
+            stages_[i]->total_time * 1000.0 / frames_);
+        value.value = buffer;
+        status.values.push_back(value);
+
+        stages_[i]->total_time = 0;
+      }
+
+      diagnostic_msgs::DiagnosticArray diagnostics;
+      diagnostics.header.stamp = ros::Time::now();
+      diagnostics.status.push_back(status);
+      diagnostic_pub_.publish(diagnostics);
+
+      frames_ = 0;
+      last_diagnostic_time_ = now;
+    }
+
+    double diagnostic_period_;
+    ros::WallTime last_diagnostic_time_;
+    int32_t frames_;
+
+    std::vector<StagePtr> stages_;
+    cv::Mat buffers_[2];
+    ImageMessagePool pool_;
+
+    image_transport::Subscriber image_sub_;
+    image_transport::Publisher image_pub_;
+    ros::Publisher diagnostic_pub_;
+
+    LatestFrameWorker worker_;
+  };
+}
+
+// Register nodelet plugin
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_DECLARE_CLASS(
+    image_util,
+    image_pipeline,
+    image_util::ImagePipelineNodelet,
+    nodelet::Nodelet)
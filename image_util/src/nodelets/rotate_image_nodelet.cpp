@@ -29,6 +29,8 @@
 
 #include <string>
 
+#include <boost/bind.hpp>
+
 #include <opencv2/core/core.hpp>
 
 #include <ros/ros.h>
@@ -37,6 +39,9 @@
 #include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/Image.h>
 #include <cv_bridge/cv_bridge.h>
+#include <image_util/latest_frame_worker.h>
+#include <image_util/image_message_pool.h>
+#include <image_util/image_warp_util.h>
 
 #include <math_util/math_util.h>
 
@@ -47,13 +52,13 @@ namespace image_util
   public:
     RotateImageNodelet() :
       angle_(0),
-      operations_(0),
-      flip_axis_(false)
+      quarter_turns_(0)
     {
     }
 
     ~RotateImageNodelet()
     {
+      worker_.Stop();
     }
 
     void onInit()
@@ -63,42 +68,59 @@ namespace image_util
 
       priv.param("angle", angle_, angle_);
 
+      // Positive angles are clockwise turns.
       int32_t angle_90 = static_cast<int32_t>(math_util::ToNearest(angle_, 90));
-      flip_axis_ = angle_90 > 0 ? 1 : 0;
-      operations_ = std::abs(angle_90 / 90);
+      quarter_turns_ = ((angle_90 / 90) % 4 + 4) % 4;
 
       image_transport::ImageTransport it(node);
       image_pub_ = it.advertise("rotated_image", 1);
-      image_sub_ = it.subscribe("image", 1, &RotateImageNodelet::ImageCallback, this);
+
+      bool worker_thread = false;
+      priv.param("worker_thread", worker_thread, worker_thread);
+      image_sub_ = worker_.Subscribe(
+          it,
+          "image",
+          boost::bind(&RotateImageNodelet::ImageCallback, this, _1),
+          worker_thread,
+          getName(),
+          node);
     }
 
     void ImageCallback(const sensor_msgs::ImageConstPtr& image)
     {
-      if (operations_ == 0)
+      if (quarter_turns_ == 0)
       {
         image_pub_.publish(image);
         return;
       }
 
-      cv_bridge::CvImagePtr cv_image = cv_bridge::toCvCopy(image);
+      // Rotate straight from the received image into a pooled message.
+      cv_bridge::CvImageConstPtr cv_image = cv_bridge::toCvShare(image);
 
-      for (int32_t i = 0; i < operations_; i++)
+      cv::Size size(cv_image->image.rows, cv_image->image.cols);
+      if (quarter_turns_ == 2)
       {
-        cv::transpose(cv_image->image, cv_image->image);
-        cv::flip(cv_image->image, cv_image->image, flip_axis_);
+        size = cv_image->image.size();
       }
 
-      image_pub_.publish(cv_image->toImageMsg());
+      cv::Mat rotated;
+      sensor_msgs::ImagePtr output = pool_.Get(
+          image->header, image->encoding, size, cv_image->image.type(), rotated);
+      RotateImage(cv_image->image, quarter_turns_, rotated);
+
+      image_pub_.publish(output);
     }
 
   private:
     double angle_;
-    int32_t operations_;
-    bool flip_axis_;
+    int32_t quarter_turns_;
+
+    ImageMessagePool pool_;
 
     image_transport::Subscriber image_sub_;
     image_transport::Publisher image_pub_;
 
+    LatestFrameWorker worker_;
   };
 }
 
@@ -29,6 +29,8 @@
 
 #include <string>
 
+#include <boost/bind.hpp>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -38,6 +40,7 @@
 #include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/Image.h>
 #include <cv_bridge/cv_bridge.h>
+#include <image_util/latest_frame_worker.h>
 #include <math_util/math_util.h>
 
 namespace image_util
@@ -52,6 +55,7 @@ namespace image_util
 
     ~ScaleImageNodelet()
     {
+      worker_.Stop();
     }
 
     void onInit()
@@ -63,7 +67,16 @@ namespace image_util
 
       image_transport::ImageTransport it(node);
       image_pub_ = it.advertise("scaled_image", 1);
-      image_sub_ = it.subscribe("image", 1, &ScaleImageNodelet::ImageCallback, this);
+
+      bool worker_thread = false;
+      priv.param("worker_thread", worker_thread, worker_thread);
+      image_sub_ = worker_.Subscribe(
+          it,
+          "image",
+          boost::bind(&ScaleImageNodelet::ImageCallback, this, _1),
+          worker_thread,
+          getName(),
+          node);
     }
 
     void ImageCallback(const sensor_msgs::ImageConstPtr& image)
@@ -95,6 +108,8 @@ namespace image_util
 
     image_transport::Subscriber image_sub_;
     image_transport::Publisher image_pub_;
+
+    LatestFrameWorker worker_;
   };
 }
 
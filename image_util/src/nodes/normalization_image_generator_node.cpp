@@ -59,7 +59,7 @@ class NormalizationImageNode
 
   bool image_written_;
 
-  std::vector<cv::Mat> image_array_;
+  image_util::NormalizationImageAccumulator accumulator_;
 
 
   void get_parameters()
@@ -83,6 +83,16 @@ class NormalizationImageNode
 
     ROS_ERROR("Planning to write normalization image to: %s",
               filename_.c_str());
+
+    bool use_median;
+    nh_.param(ros::this_node::getName() + "/use_median",
+              use_median,
+              false);
+    if (use_median)
+    {
+      accumulator_ = image_util::NormalizationImageAccumulator(
+          image_util::NormalizationImageAccumulator::MEDIAN);
+    }
   }
 
 
@@ -109,9 +119,12 @@ class NormalizationImageNode
                 image_count_,
                 max_num_to_average_);
 
-      cv_bridge::CvImagePtr im_ptr = cv_bridge::toCvCopy(msg);
-      cv::Mat image(im_ptr->image);
-      image_array_.push_back(image);
+      cv_bridge::CvImageConstPtr im_ptr = cv_bridge::toCvShare(msg);
+      if (!accumulator_.Add(im_ptr->image))
+      {
+        image_count_--;
+        return;
+      }
       if (image_count_ >= max_num_to_average_)
       {
         generate_and_write_image();
@@ -122,7 +135,7 @@ class NormalizationImageNode
 
   void generate_and_write_image()
   {
-    cv::Mat norm_im = image_util::generate_normalization_image(image_array_);
+    cv::Mat norm_im = accumulator_.Finalize();
     if (!norm_im.empty())
     {
       try
@@ -165,7 +178,7 @@ class NormalizationImageNode
 
   void shut_down()
   {
-    if (!image_written_ && image_array_.size() > 25)
+    if (!image_written_ && accumulator_.Count() > 25)
     {
       generate_and_write_image();
       fprintf(stderr, "\nNode killed before enough frames received to generate "
@@ -29,22 +29,87 @@
 
 #include <image_util/rolling_normalization.h>
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
 namespace image_util
 {
+  /**
+   * Scales a blur kernel size for a decimated image, keeping it odd and at
+   * least 3.
+   */
+  static int32_t ScaleKernelSize(int32_t size, int32_t decimation)
+  {
+    int32_t scaled = size / decimation;
+    if (scaled % 2 == 0)
+    {
+      scaled++;
+    }
+
+    return std::max(3, scaled);
+  }
+
   RollingNormalization::RollingNormalization(int32_t size) :
     max_size_(size),
-    samples_(0)
+    samples_(0),
+    restarted_(true),
+    reduced_(false),
+    decimation_(1),
+    update_interval_(1),
+    background_(false),
+    samples_since_update_(0),
+    update_pending_(false),
+    updating_(false),
+    stopping_(false)
   {
     
   }
+
+  RollingNormalization::RollingNormalization(
+      int32_t size,
+      int32_t decimation,
+      int32_t update_interval,
+      bool background) :
+    max_size_(size),
+    samples_(0),
+    restarted_(true),
+    reduced_(true),
+    decimation_(std::max(1, decimation)),
+    update_interval_(std::max(1, update_interval)),
+    background_(background),
+    samples_since_update_(0),
+    update_pending_(false),
+    updating_(false),
+    stopping_(false)
+  {
+    if (background_)
+    {
+      update_thread_ = boost::thread(
+          boost::bind(&RollingNormalization::UpdateThread, this));
+    }
+  }
   
   RollingNormalization::~RollingNormalization()
   {
-  
+    if (background_)
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      update_condition_.notify_all();
+      update_thread_.join();
+    }
   }
     
   cv::Mat RollingNormalization::AddSample(const cv::Mat& image)
   {
+    if (reduced_)
+    {
+      return AddReducedSample(image);
+    }
+
     if (samples_ == 0)
     {
       image.convertTo(average_image_, CV_64F, 1.0, 0.0);
@@ -72,16 +137,7 @@ namespace image_util
     cv::Mat temp_norm_image2;
     temp_norm_image.convertTo(temp_norm_image2, CV_32F);
     double max1 = 0;
-    for (int32_t i = 0; i < temp_norm_image2.rows; i++)
-    {
-      for (int32_t j = 0; j < temp_norm_image2.cols; j++)
-      {
-        if (temp_norm_image2.at<float>(i, j) > max1)
-        {
-          max1 = temp_norm_image2.at<float>(i, j);
-        }
-      }
-    }
+    cv::minMaxLoc(temp_norm_image2, 0, &max1);
 
     temp_norm_image2 = temp_norm_image2 * (255.0 / max1);
 
@@ -96,4 +152,166 @@ namespace image_util
                      5);
     return norm_image_;
   }
+
+  cv::Mat RollingNormalization::AddReducedSample(const cv::Mat& image)
+  {
+    cv::Size reduced_size(
+        std::max(1, image.cols / decimation_),
+        std::max(1, image.rows / decimation_));
+
+    // Restart the average if the image size changes.
+    if (image.size() != image_size_)
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      image_size_ = image.size();
+      samples_ = 0;
+      samples_since_update_ = 0;
+      restarted_ = true;
+    }
+
+    cv::Mat reduced;
+    if (decimation_ > 1)
+    {
+      cv::resize(image, reduced, reduced_size, 0, 0, cv::INTER_AREA);
+    }
+    else
+    {
+      reduced = image;
+    }
+
+    // Update the running average in place: this is the same recurrence as
+    // the full resolution average, avg = (avg * s + x) / (s + 1).
+    if (samples_ == 0)
+    {
+      reduced.convertTo(average_image_, CV_32F);
+    }
+    else
+    {
+      cv::accumulateWeighted(reduced, average_image_, 1.0 / (samples_ + 1.0));
+    }
+
+    samples_++;
+    if (samples_ > max_size_)
+    {
+      samples_ = max_size_;
+    }
+
+    samples_since_update_++;
+    bool first = restarted_;
+    restarted_ = false;
+    if (!first && samples_since_update_ < update_interval_)
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      return norm_image_;
+    }
+    samples_since_update_ = 0;
+
+    // The first update after a restart is always computed immediately, so
+    // callers never get an empty or mis-sized normalization image.
+    if (!background_ || first)
+    {
+      cv::Mat norm_image = ComputeNormImage(
+          average_image_, decimation_, image_size_);
+
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      norm_image_ = norm_image;
+      return norm_image_;
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    average_image_.copyTo(pending_average_);
+    update_pending_ = true;
+    update_condition_.notify_one();
+
+    return norm_image_;
+  }
+
+  cv::Mat RollingNormalization::WaitForUpdate()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while ((update_pending_ || updating_) && !stopping_)
+    {
+      idle_condition_.wait(lock);
+    }
+
+    return norm_image_;
+  }
+
+  cv::Mat RollingNormalization::ComputeNormImage(
+      const cv::Mat& average,
+      int32_t decimation,
+      const cv::Size& size)
+  {
+    cv::Mat mean_image;
+    average.convertTo(mean_image, CV_8U);
+
+    cv::Mat median_image;
+    cv::medianBlur(mean_image, median_image, ScaleKernelSize(25, decimation));
+
+    double max_val = 0;
+    cv::minMaxLoc(median_image, 0, &max_val);
+
+    cv::Mat scaled_image;
+    median_image.convertTo(
+        scaled_image, CV_8U, max_val > 0 ? 255.0 / max_val : 1.0, 0.0);
+
+    int32_t kernel_size = ScaleKernelSize(15, decimation);
+    double sigma = 5.0 / decimation;
+    cv::Mat blurred_image;
+    cv::GaussianBlur(scaled_image,
+                     blurred_image,
+                     cv::Size(kernel_size, kernel_size),
+                     sigma,
+                     sigma);
+
+    if (blurred_image.size() == size)
+    {
+      return blurred_image;
+    }
+
+    cv::Mat norm_image;
+    cv::resize(blurred_image, norm_image, size, 0, 0, cv::INTER_LINEAR);
+
+    return norm_image;
+  }
+
+  void RollingNormalization::UpdateThread()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (true)
+    {
+      while (!update_pending_ && !stopping_)
+      {
+        update_condition_.wait(lock);
+      }
+
+      if (stopping_)
+      {
+        idle_condition_.notify_all();
+        return;
+      }
+
+      cv::Mat average = pending_average_;
+      pending_average_ = cv::Mat();
+      cv::Size size = image_size_;
+      update_pending_ = false;
+      updating_ = true;
+
+      lock.unlock();
+      cv::Mat norm_image = ComputeNormImage(average, decimation_, size);
+      lock.lock();
+
+      // Drop results for an image size that has since changed.
+      if (norm_image.size() == image_size_)
+      {
+        norm_image_ = norm_image;
+      }
+
+      updating_ = false;
+      if (!update_pending_)
+      {
+        idle_condition_.notify_all();
+      }
+    }
+  }
 }
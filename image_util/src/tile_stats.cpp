@@ -0,0 +1,220 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <image_util/tile_stats.h>
+
+#include <algorithm>
+
+namespace image_util
+{
+  TileStats::TileStats() :
+    grid_size_(0),
+    bin_width_(0),
+    bin_height_(0)
+  {
+  }
+
+  void TileStats::Partition(
+      int32_t tiles,
+      int32_t bin_size,
+      int32_t length,
+      std::vector<int32_t>& bounds,
+      std::vector<int32_t>& first_segment,
+      std::vector<int32_t>& end_segment)
+  {
+    std::vector<int32_t> starts(tiles);
+    std::vector<int32_t> ends(tiles);
+
+    bounds.clear();
+    for (int32_t i = 0; i < tiles; i++)
+    {
+      // The tile is centered on the bin corner and then shifted, rather than
+      // shrunk, to fit inside the start of the image.
+      starts[i] = std::max(0, i * bin_size - bin_size / 2);
+      ends[i] = std::min(length, starts[i] + bin_size);
+      bounds.push_back(starts[i]);
+      bounds.push_back(ends[i]);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    first_segment.resize(tiles);
+    end_segment.resize(tiles);
+    for (int32_t i = 0; i < tiles; i++)
+    {
+      first_segment[i] = std::lower_bound(
+          bounds.begin(), bounds.end(), starts[i]) - bounds.begin();
+      end_segment[i] = std::lower_bound(
+          bounds.begin(), bounds.end(), ends[i]) - bounds.begin();
+    }
+  }
+
+  bool TileStats::UpdateLayout(int32_t grid_size, const cv::Size& size)
+  {
+    if (grid_size == grid_size_ && size == size_)
+    {
+      return true;
+    }
+
+    grid_size_ = 0;
+    if (grid_size <= 0 || size.width < grid_size || size.height < grid_size)
+    {
+      return false;
+    }
+
+    bin_width_ = size.width / grid_size;
+    bin_height_ = size.height / grid_size;
+    Partition(grid_size + 1, bin_width_, size.width,
+        col_bounds_, col_first_, col_end_);
+    Partition(grid_size + 1, bin_height_, size.height,
+        row_bounds_, row_first_, row_end_);
+
+    size_t cells = (row_bounds_.size() - 1) * (col_bounds_.size() - 1);
+    cell_min_.resize(cells);
+    cell_max_.resize(cells);
+    cell_valid_.resize(cells);
+
+    min_values_.create(grid_size + 1, grid_size + 1, CV_64F);
+    max_values_.create(grid_size + 1, grid_size + 1, CV_64F);
+
+    grid_size_ = grid_size;
+    size_ = size;
+
+    return true;
+  }
+
+  bool TileStats::Calculate(
+      int32_t grid_size,
+      const cv::Mat& image,
+      const cv::Mat& mask)
+  {
+    if (image.type() != CV_8UC1)
+    {
+      ROS_ERROR("Tile statistics require an 8-bit, single channel image.");
+      return false;
+    }
+
+    bool has_mask = !mask.empty();
+    if (has_mask && (mask.type() != CV_8UC1 || mask.size() != image.size()))
+    {
+      ROS_ERROR("Tile statistics mask must be 8-bit and match the image size.");
+      return false;
+    }
+
+    if (!UpdateLayout(grid_size, image.size()))
+    {
+      return false;
+    }
+
+    std::fill(cell_min_.begin(), cell_min_.end(), 255);
+    std::fill(cell_max_.begin(), cell_max_.end(), 0);
+    std::fill(cell_valid_.begin(), cell_valid_.end(), has_mask ? 0 : 1);
+
+    // Stream over the rows once, folding each row segment into its cell.
+    int32_t col_segments = col_bounds_.size() - 1;
+    int32_t row_segments = row_bounds_.size() - 1;
+    for (int32_t rs = 0; rs < row_segments; rs++)
+    {
+      uint8_t* cell_min = &cell_min_[rs * col_segments];
+      uint8_t* cell_max = &cell_max_[rs * col_segments];
+      uint8_t* cell_valid = &cell_valid_[rs * col_segments];
+
+      for (int32_t i = row_bounds_[rs]; i < row_bounds_[rs + 1]; i++)
+      {
+        const uint8_t* pixels = image.ptr<uint8_t>(i);
+        const uint8_t* mask_pixels = has_mask ? mask.ptr<uint8_t>(i) : 0;
+
+        for (int32_t cs = 0; cs < col_segments; cs++)
+        {
+          uint8_t min_val = cell_min[cs];
+          uint8_t max_val = cell_max[cs];
+          int32_t start = col_bounds_[cs];
+          int32_t end = col_bounds_[cs + 1];
+
+          if (!has_mask)
+          {
+            for (int32_t j = start; j < end; j++)
+            {
+              min_val = std::min(min_val, pixels[j]);
+              max_val = std::max(max_val, pixels[j]);
+            }
+          }
+          else
+          {
+            // Masked out pixels are forced to 255 for the minimum and 0 for
+            // the maximum, which keeps the loop free of branches.
+            uint8_t valid = 0;
+            for (int32_t j = start; j < end; j++)
+            {
+              uint8_t keep = mask_pixels[j] ? 0xFF : 0x00;
+              min_val = std::min(min_val, static_cast<uint8_t>(pixels[j] | ~keep));
+              max_val = std::max(max_val, static_cast<uint8_t>(pixels[j] & keep));
+              valid |= keep;
+            }
+            cell_valid[cs] |= valid;
+          }
+
+          cell_min[cs] = min_val;
+          cell_max[cs] = max_val;
+        }
+      }
+    }
+
+    // Combine the cells covered by each tile.
+    for (int32_t i = 0; i <= grid_size_; i++)
+    {
+      double* min_row = min_values_.ptr<double>(i);
+      double* max_row = max_values_.ptr<double>(i);
+      for (int32_t j = 0; j <= grid_size_; j++)
+      {
+        uint8_t min_val = 255;
+        uint8_t max_val = 0;
+        bool valid = false;
+        for (int32_t rs = row_first_[i]; rs < row_end_[i]; rs++)
+        {
+          for (int32_t cs = col_first_[j]; cs < col_end_[j]; cs++)
+          {
+            int32_t cell = rs * col_segments + cs;
+            if (cell_valid_[cell])
+            {
+              min_val = std::min(min_val, cell_min_[cell]);
+              max_val = std::max(max_val, cell_max_[cell]);
+              valid = true;
+            }
+          }
+        }
+
+        min_row[j] = valid ? min_val : 0;
+        max_row[j] = valid ? max_val : 0;
+      }
+    }
+
+    return true;
+  }
+}
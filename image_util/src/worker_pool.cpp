@@ -0,0 +1,125 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <image_util/worker_pool.h>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+namespace image_util
+{
+  WorkerPool::WorkerPool(int32_t threads) :
+    size_(threads),
+    generation_(0),
+    pending_(0),
+    stopping_(false)
+  {
+    if (size_ <= 0)
+    {
+      size_ = static_cast<int32_t>(boost::thread::hardware_concurrency());
+    }
+    size_ = std::max(1, size_);
+
+    for (int32_t i = 1; i < size_; i++)
+    {
+      threads_.create_thread(boost::bind(&WorkerPool::Work, this, i));
+    }
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    start_condition_.notify_all();
+    threads_.join_all();
+  }
+
+  void WorkerPool::Run(const Job& job)
+  {
+    boost::unique_lock<boost::mutex> run_lock(run_mutex_);
+    if (size_ == 1)
+    {
+      job(0, 1);
+      return;
+    }
+
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      job_ = job;
+      pending_ = size_ - 1;
+      generation_++;
+    }
+    start_condition_.notify_all();
+
+    job(0, size_);
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (pending_ > 0)
+    {
+      done_condition_.wait(lock);
+    }
+    job_ = Job();
+  }
+
+  void WorkerPool::Work(int32_t index)
+  {
+    uint64_t generation = 0;
+    while (true)
+    {
+      Job job;
+      {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (!stopping_ && generation_ == generation)
+        {
+          start_condition_.wait(lock);
+        }
+
+        if (stopping_)
+        {
+          return;
+        }
+
+        generation = generation_;
+        job = job_;
+      }
+
+      job(index, size_);
+
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      pending_--;
+      if (pending_ == 0)
+      {
+        done_condition_.notify_all();
+      }
+    }
+  }
+}
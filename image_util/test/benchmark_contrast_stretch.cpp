@@ -0,0 +1,174 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+/**
+ * Offline benchmark of image_util::ContrastStretch.
+ *
+ * Synthetic 8-bit images are stretched repeatedly at several resolutions and
+ * the throughput is written to stdout as JSON, in frames per second.
+ *
+ * Usage: benchmark_contrast_stretch [min_seconds_per_case]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <image_util/image_normalization.h>
+
+struct Resolution
+{
+  int32_t width;
+  int32_t height;
+};
+
+static const Resolution _resolutions[] = {
+    { 640, 480 }, { 1280, 960 }, { 1624, 1224 }, { 2448, 2048 } };
+static const size_t _num_resolutions = sizeof(_resolutions) / sizeof(_resolutions[0]);
+static const int32_t _grid_sizes[] = { 4, 8, 16 };
+static const size_t _num_grid_sizes = sizeof(_grid_sizes) / sizeof(_grid_sizes[0]);
+
+// Accumulates outputs so the compiler can't discard the benchmarked work.
+static volatile int32_t _sink = 0;
+
+struct Result
+{
+  int32_t width;
+  int32_t height;
+  int32_t grid_size;
+  size_t frames;
+  double fps;
+};
+
+/**
+ * Create an image with smooth illumination falloff, texture, and a few
+ * saturated pixels, so that the tile maxima vary across the image.
+ */
+static cv::Mat SyntheticImage(int32_t width, int32_t height)
+{
+  cv::Mat image(height, width, CV_8U);
+  srand(0);
+  for (int32_t i = 0; i < height; i++)
+  {
+    uint8_t* row = image.ptr<uint8_t>(i);
+    for (int32_t j = 0; j < width; j++)
+    {
+      double dx = (j - width / 2.0) / width;
+      double dy = (i - height / 2.0) / height;
+      double falloff = 1.0 - 1.5 * (dx * dx + dy * dy);
+      int32_t value = static_cast<int32_t>(falloff * 160) + rand() % 48;
+      if (rand() % 1000 == 0)
+      {
+        value = 255;
+      }
+      row[j] = static_cast<uint8_t>(std::max(0, std::min(255, value)));
+    }
+  }
+
+  return image;
+}
+
+/**
+ * Stretch the image repeatedly until at least min_seconds have elapsed.
+ */
+static Result TimeCase(
+    const cv::Mat& image,
+    int32_t grid_size,
+    double min_seconds)
+{
+  cv::Mat stretched;
+
+  // Warm up.
+  image_util::ContrastStretch(grid_size, image, stretched);
+
+  Result result;
+  result.width = image.cols;
+  result.height = image.rows;
+  result.grid_size = grid_size;
+  result.frames = 0;
+
+  ros::WallTime start = ros::WallTime::now();
+  double elapsed = 0;
+  do
+  {
+    image_util::ContrastStretch(grid_size, image, stretched);
+    _sink += stretched.at<uint8_t>(stretched.rows / 2, stretched.cols / 2);
+    result.frames++;
+    elapsed = (ros::WallTime::now() - start).toSec();
+  }
+  while (elapsed < min_seconds);
+
+  result.fps = result.frames / elapsed;
+
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  double min_seconds = 1.0;
+  if (argc > 1)
+  {
+    min_seconds = std::max(0.01, std::strtod(argv[1], NULL));
+  }
+
+  std::vector<Result> results;
+  for (size_t i = 0; i < _num_resolutions; i++)
+  {
+    cv::Mat image = SyntheticImage(
+        _resolutions[i].width, _resolutions[i].height);
+    for (size_t j = 0; j < _num_grid_sizes; j++)
+    {
+      results.push_back(TimeCase(image, _grid_sizes[j], min_seconds));
+    }
+  }
+
+  std::printf("{\n  \"min_seconds\": %g,\n", min_seconds);
+  std::printf("  \"contrast_stretch\": [\n");
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result& result = results[i];
+    std::printf(
+        "    { \"width\": %d, \"height\": %d, \"grid_size\": %d, "
+        "\"frames\": %lu, \"fps\": %.1f }%s\n",
+        result.width,
+        result.height,
+        result.grid_size,
+        static_cast<unsigned long>(result.frames),
+        result.fps,
+        (i + 1 < results.size()) ? "," : "");
+  }
+  std::printf("  ]\n}\n");
+
+  return 0;
+}
@@ -0,0 +1,205 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+/**
+ * Offline benchmark of the RANSAC transform estimators in motion_estimation.
+ *
+ * Synthetic matches related by a rigid transform, with a fraction of random
+ * outliers, are fit repeatedly and the throughput is written to stdout as
+ * JSON, in calls per second.
+ *
+ * Usage: benchmark_motion_estimation [min_seconds_per_case]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <image_util/motion_estimation.h>
+
+static const int32_t _num_points[] = { 50, 200, 1000 };
+static const size_t _num_cases = sizeof(_num_points) / sizeof(_num_points[0]);
+
+// The fraction of the matches which are outliers.  This is high enough that
+// the RANSAC loops never meet their escape criteria.
+static const double _outlier_fraction = 0.3;
+
+// Accumulates outputs so the compiler can't discard the benchmarked work.
+static volatile float _sink = 0;
+
+enum Estimator
+{
+  RIGID_2D,
+  LOOSE_AFFINE_2D
+};
+
+struct Result
+{
+  const char* estimator;
+  int32_t num_points;
+  size_t calls;
+  double calls_per_second;
+};
+
+/**
+ * Create matches in a 640x480 image related by a small rotation and
+ * translation, with half a pixel of noise and some random outliers.
+ */
+static void SyntheticMatches(
+    int32_t num_points,
+    cv::Mat& points1,
+    cv::Mat& points2)
+{
+  srand(0);
+  points1.create(num_points, 1, CV_32FC2);
+  points2.create(num_points, 1, CV_32FC2);
+
+  double angle = 3.0 * M_PI / 180.0;
+  double c = std::cos(angle);
+  double s = std::sin(angle);
+  for (int32_t i = 0; i < num_points; i++)
+  {
+    double x = rand() % 640;
+    double y = rand() % 480;
+    points1.at<cv::Vec2f>(i, 0) = cv::Vec2f(x, y);
+
+    if (rand() < _outlier_fraction * RAND_MAX)
+    {
+      points2.at<cv::Vec2f>(i, 0) = cv::Vec2f(rand() % 640, rand() % 480);
+    }
+    else
+    {
+      double noise_x = (rand() % 1000) / 1000.0 - 0.5;
+      double noise_y = (rand() % 1000) / 1000.0 - 0.5;
+      points2.at<cv::Vec2f>(i, 0) = cv::Vec2f(
+          c * x - s * y + 12.0 + noise_x,
+          s * x + c * y - 5.0 + noise_y);
+    }
+  }
+}
+
+static cv::Mat Estimate(
+    Estimator estimator,
+    const cv::Mat& points1,
+    const cv::Mat& points2)
+{
+  cv::Mat inliers1;
+  cv::Mat inliers2;
+  if (estimator == RIGID_2D)
+  {
+    std::vector<uint32_t> good_points;
+    return image_util::ComputeRigid2DTransform(
+        points1, points2, inliers1, inliers2, good_points);
+  }
+
+  cv::Mat T_rigid;
+  double rms_error;
+  return image_util::ComputeLooseAffine2DTransform(
+      points1, points2, inliers1, inliers2, T_rigid, rms_error);
+}
+
+/**
+ * Estimate the transform repeatedly until at least min_seconds have elapsed.
+ */
+static Result TimeCase(
+    Estimator estimator,
+    int32_t num_points,
+    double min_seconds)
+{
+  cv::Mat points1;
+  cv::Mat points2;
+  SyntheticMatches(num_points, points1, points2);
+
+  // Warm up.
+  Estimate(estimator, points1, points2);
+
+  Result result;
+  result.estimator = estimator == RIGID_2D ?
+      "ComputeRigid2DTransform" : "ComputeLooseAffine2DTransform";
+  result.num_points = num_points;
+  result.calls = 0;
+
+  ros::WallTime start = ros::WallTime::now();
+  double elapsed = 0;
+  do
+  {
+    cv::Mat T = Estimate(estimator, points1, points2);
+    if (!T.empty())
+    {
+      _sink += T.at<float>(0, 2);
+    }
+    result.calls++;
+    elapsed = (ros::WallTime::now() - start).toSec();
+  }
+  while (elapsed < min_seconds);
+
+  result.calls_per_second = result.calls / elapsed;
+
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  double min_seconds = 1.0;
+  if (argc > 1)
+  {
+    min_seconds = std::max(0.01, std::strtod(argv[1], NULL));
+  }
+
+  std::vector<Result> results;
+  for (size_t i = 0; i < _num_cases; i++)
+  {
+    results.push_back(TimeCase(RIGID_2D, _num_points[i], min_seconds));
+    results.push_back(TimeCase(LOOSE_AFFINE_2D, _num_points[i], min_seconds));
+  }
+
+  std::printf("{\n  \"min_seconds\": %g,\n", min_seconds);
+  std::printf("  \"motion_estimation\": [\n");
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result& result = results[i];
+    std::printf(
+        "    { \"estimator\": \"%s\", \"points\": %d, "
+        "\"calls\": %lu, \"calls_per_second\": %.1f }%s\n",
+        result.estimator,
+        result.num_points,
+        static_cast<unsigned long>(result.calls),
+        result.calls_per_second,
+        (i + 1 < results.size()) ? "," : "");
+  }
+  std::printf("  ]\n}\n");
+
+  return 0;
+}
@@ -27,6 +27,10 @@
 //
 // *****************************************************************************
 
+// C++ Standard Library
+#include <cmath>
+#include <cstdlib>
+
 // GTEST Library
 #include <gtest/gtest.h>
 
@@ -41,6 +45,7 @@
 
 #include <image_util/image_normalization.h>
 #include <image_util/motion_estimation.h>
+#include <image_util/rolling_normalization.h>
 #include <image_util/image_warp_util.h> // The library to test
 
 /**
@@ -276,6 +281,428 @@ TEST(ImageNormalizationTests, Test1)
 }
 
 
+TEST(ImageNormalizationTests, ContrastStretch)
+{
+  // A uniform image is stretched to full scale, including the rows and
+  // columns past the last full tile of the grid.
+  cv::Mat uniform(487, 643, CV_8U, cv::Scalar(100));
+  cv::Mat stretched;
+  image_util::ContrastStretch(8, uniform, stretched);
+  ASSERT_EQ(uniform.size(), stretched.size());
+  ASSERT_EQ(CV_8U, stretched.type());
+  double min_val = 0;
+  double max_val = 0;
+  cv::minMaxLoc(stretched, &min_val, &max_val);
+  EXPECT_EQ(255, min_val);
+  EXPECT_EQ(255, max_val);
+
+  // The result of stretching in-place matches the result of stretching into
+  // a separate image.
+  cv::Mat gradient(480, 640, CV_8U);
+  for (int32_t i = 0; i < gradient.rows; i++)
+  {
+    for (int32_t j = 0; j < gradient.cols; j++)
+    {
+      gradient.at<uint8_t>(i, j) = static_cast<uint8_t>((i / 4 + j / 8) % 200);
+    }
+  }
+  image_util::ContrastStretch(8, gradient, stretched);
+  cv::Mat in_place = gradient.clone();
+  image_util::ContrastStretch(8, in_place, in_place);
+  for (int32_t i = 0; i < gradient.rows; i++)
+  {
+    for (int32_t j = 0; j < gradient.cols; j++)
+    {
+      ASSERT_EQ(stretched.at<uint8_t>(i, j), in_place.at<uint8_t>(i, j));
+      ASSERT_GE(stretched.at<uint8_t>(i, j), gradient.at<uint8_t>(i, j));
+    }
+  }
+}
+
+
+/**
+ * @brief      The original double-precision implementation of
+ *             ContrastStretch(), used as a reference.
+ *
+ * The image dimensions must be multiples of the grid size.
+ */
+static void ReferenceContrastStretch(
+    int32_t grid_size,
+    const cv::Mat& source_image,
+    cv::Mat& dest_image,
+    const cv::Mat& mask)
+{
+  int x_bin_w = std::floor(static_cast<double>(source_image.cols) / grid_size);
+  int y_bin_h = std::floor(static_cast<double>(source_image.rows) / grid_size);
+
+  cv::Mat max_vals(grid_size + 1, grid_size + 1, CV_64F);
+
+  for (int i = 0; i < grid_size + 1; i++)
+  {
+    for (int j = 0; j < grid_size + 1; j++)
+    {
+      double minVal = 0;
+      double maxVal = 255;
+
+      cv::Rect roi = cv::Rect(j * x_bin_w  - x_bin_w / 2,
+                     i * y_bin_h - y_bin_h / 2, x_bin_w, y_bin_h);
+      roi.x = std::max(0, roi.x);
+      roi.y = std::max(0, roi.y);
+      roi.width = std::min(source_image.cols - roi.x, roi.width);
+      roi.height = std::min(source_image.rows - roi.y, roi.height);
+
+      if (!mask.empty())
+      {
+        cv::minMaxLoc(source_image(roi), &minVal, &maxVal, 0, 0, mask(roi));
+      }
+      else
+      {
+        cv::minMaxLoc(source_image(roi), &minVal, &maxVal, 0, 0);
+      }
+      max_vals.at<double>(i, j) = maxVal;
+    }
+  }
+
+  dest_image.create(source_image.size(), CV_8U);
+  for (int i = 0; i < source_image.rows; i++)
+  {
+    int ii = i / y_bin_h;
+    double py = (i - ii * y_bin_h) / ((double) y_bin_h);
+
+    for (int j = 0; j < source_image.cols; j++)
+    {
+      int jj = j / x_bin_w;
+      double maxVal = max_vals.at<double>(ii, jj);
+      double px = (j - jj * x_bin_w) / ((double) x_bin_w);
+
+      double xM1 = maxVal + px * (max_vals.at<double>(ii, jj+1) - maxVal);
+      double xM2 = max_vals.at<double>(ii+1, jj) + px * (max_vals.at<double>(ii+1, jj+1) - max_vals.at<double>(ii+1, jj));
+      maxVal = xM1 + py * (xM2 - xM1);
+
+      if(maxVal > 255) maxVal = 255;
+
+      double val = source_image.at<uint8_t>(i,j);
+      val = val * 255.0 / maxVal;
+      if(val > 255) val = 255;
+      if(val < 0) val = 0;
+      dest_image.at<uint8_t>(i,j) = val;
+    }
+  }
+}
+
+static void ExpectWithinOne(const cv::Mat& expected, const cv::Mat& actual)
+{
+  ASSERT_EQ(expected.size(), actual.size());
+  ASSERT_EQ(expected.type(), actual.type());
+  for (int32_t i = 0; i < expected.rows; i++)
+  {
+    for (int32_t j = 0; j < expected.cols; j++)
+    {
+      ASSERT_LE(std::abs(expected.at<uint8_t>(i, j) - actual.at<uint8_t>(i, j)), 1)
+        << "at row " << i << ", column " << j;
+    }
+  }
+}
+
+TEST(ImageNormalizationTests, ContrastStretchMatchesReference)
+{
+  // Random texture under a brightness that varies across the grid, so that
+  // the tile maximums are all different.
+  std::srand(0);
+  cv::Mat textured(480, 640, CV_8U);
+  for (int32_t i = 0; i < textured.rows; i++)
+  {
+    for (int32_t j = 0; j < textured.cols; j++)
+    {
+      int32_t brightness = 20 + (i * 7 + j * 3) % 236;
+      textured.at<uint8_t>(i, j) = static_cast<uint8_t>(std::rand() % brightness);
+    }
+  }
+
+  cv::Mat expected;
+  cv::Mat stretched;
+  for (int32_t grid_size = 4; grid_size <= 16; grid_size *= 2)
+  {
+    ReferenceContrastStretch(grid_size, textured, expected, cv::Mat());
+    image_util::ContrastStretch(grid_size, textured, stretched);
+    ExpectWithinOne(expected, stretched);
+  }
+
+  // Saturate a pattern of bands and mask them out, leaving some valid
+  // pixels in each tile.
+  cv::Mat mask(textured.size(), CV_8U, cv::Scalar(255));
+  cv::Mat masked = textured.clone();
+  for (int32_t i = 0; i < textured.rows; i++)
+  {
+    for (int32_t j = 0; j < textured.cols; j++)
+    {
+      if ((i / 16 + j / 16) % 3 == 0)
+      {
+        mask.at<uint8_t>(i, j) = 0;
+        masked.at<uint8_t>(i, j) = 255;
+      }
+    }
+  }
+
+  ReferenceContrastStretch(8, masked, expected, mask);
+  image_util::ContrastStretch(8, masked, stretched, mask);
+  ExpectWithinOne(expected, stretched);
+
+  // Splitting the rows across a worker pool gives the same result, and the
+  // pool can be reused between images.
+  image_util::WorkerPool pool(4);
+  image_util::TileStats stats;
+  cv::Mat pooled;
+  image_util::ContrastStretch(8, textured, pooled, cv::Mat(), stats, pool);
+  image_util::ContrastStretch(8, masked, pooled, mask, stats, pool);
+  ASSERT_EQ(stretched.size(), pooled.size());
+  for (int32_t i = 0; i < stretched.rows; i++)
+  {
+    for (int32_t j = 0; j < stretched.cols; j++)
+    {
+      ASSERT_EQ(stretched.at<uint8_t>(i, j), pooled.at<uint8_t>(i, j));
+    }
+  }
+}
+
+
+TEST(ImageNormalizationTests, TileStats)
+{
+  cv::Mat image(243, 321, CV_8U);
+  cv::Mat mask(image.size(), CV_8U);
+  for (int32_t i = 0; i < image.rows; i++)
+  {
+    for (int32_t j = 0; j < image.cols; j++)
+    {
+      image.at<uint8_t>(i, j) = static_cast<uint8_t>((i * 31 + j * 17) % 251);
+      mask.at<uint8_t>(i, j) = ((i / 20 + j / 30) % 3 == 0) ? 0 : 255;
+    }
+  }
+  // Mask out an entire tile.
+  mask(cv::Rect(0, 0, 60, 40)).setTo(cv::Scalar(0));
+
+  // The statistics match per tile cv::minMaxLoc calls, both with and without
+  // a mask and when reusing the same object.
+  image_util::TileStats stats;
+  for (int32_t m = 0; m < 2; m++)
+  {
+    const cv::Mat& tile_mask = (m == 0) ? cv::Mat() : mask;
+    ASSERT_TRUE(stats.Calculate(7, image, tile_mask));
+    int32_t w = image.cols / 7;
+    int32_t h = image.rows / 7;
+    for (int32_t i = 0; i <= 7; i++)
+    {
+      for (int32_t j = 0; j <= 7; j++)
+      {
+        cv::Rect roi(std::max(0, j * w - w / 2), std::max(0, i * h - h / 2), w, h);
+        roi.width = std::min(image.cols - roi.x, roi.width);
+        roi.height = std::min(image.rows - roi.y, roi.height);
+
+        double min_val = 0;
+        double max_val = 0;
+        if (tile_mask.empty())
+        {
+          cv::minMaxLoc(image(roi), &min_val, &max_val);
+        }
+        else
+        {
+          cv::minMaxLoc(image(roi), &min_val, &max_val, 0, 0, tile_mask(roi));
+        }
+        EXPECT_EQ(min_val, stats.Minimums().at<double>(i, j));
+        EXPECT_EQ(max_val, stats.Maximums().at<double>(i, j));
+      }
+    }
+  }
+
+  EXPECT_FALSE(stats.Calculate(400, image));
+}
+
+
+TEST(ImageNormalizationTests, RollingNormalizationReduced)
+{
+  std::vector<cv::Mat> images;
+  for (int32_t k = 0; k < 7; k++)
+  {
+    cv::Mat image(120, 160, CV_8U);
+    for (int32_t i = 0; i < image.rows; i++)
+    {
+      for (int32_t j = 0; j < image.cols; j++)
+      {
+        // Vignetting with texture that changes between frames.
+        int32_t vignetting = 200 - (std::abs(i - 60) + std::abs(j - 80)) / 2;
+        image.at<uint8_t>(i, j) = static_cast<uint8_t>(
+            vignetting - (i * 7 + j * 13 + k * 29) % 40);
+      }
+    }
+    images.push_back(image);
+  }
+
+  // The reference updates on every sample at the same decimation.
+  image_util::RollingNormalization reference(10, 4, 1, false);
+  image_util::RollingNormalization background(10, 4, 3, true);
+
+  std::vector<cv::Mat> expected;
+  for (size_t k = 0; k < images.size(); k++)
+  {
+    expected.push_back(reference.AddSample(images[k]).clone());
+    ASSERT_EQ(images[k].size(), expected.back().size());
+  }
+
+  // The first sample is computed immediately and then reused until the
+  // next update.
+  cv::Mat norm_image = background.AddSample(images[0]);
+  ASSERT_EQ(images[0].size(), norm_image.size());
+  EXPECT_EQ(0, cv::countNonZero(norm_image != expected[0]));
+  norm_image = background.AddSample(images[1]);
+  EXPECT_EQ(0, cv::countNonZero(norm_image != expected[0]));
+
+  // Samples 4 and 7 start background updates.
+  for (size_t k = 2; k < images.size(); k++)
+  {
+    background.AddSample(images[k]);
+  }
+
+  norm_image = background.WaitForUpdate();
+  ASSERT_EQ(images[0].size(), norm_image.size());
+  EXPECT_EQ(0, cv::countNonZero(norm_image != expected.back()));
+}
+
+TEST(ImageNormalizationTests, RollingNormalizationSingleSample)
+{
+  cv::Mat dark(120, 160, CV_8U, cv::Scalar(50));
+  cv::Mat textured(120, 160, CV_8U);
+  for (int32_t i = 0; i < textured.rows; i++)
+  {
+    for (int32_t j = 0; j < textured.cols; j++)
+    {
+      textured.at<uint8_t>(i, j) = static_cast<uint8_t>(100 + (i + j) % 100);
+    }
+  }
+
+  image_util::RollingNormalization reference(1, 4, 1, false);
+  cv::Mat expected = reference.AddSample(dark).clone();
+
+  // With room for a single sample, only the first sample is computed
+  // immediately.  Later samples are left to the background updates instead
+  // of each being treated as the first.
+  image_util::RollingNormalization background(1, 4, 100, true);
+  cv::Mat norm_image = background.AddSample(dark);
+  EXPECT_EQ(0, cv::countNonZero(norm_image != expected));
+  norm_image = background.AddSample(textured);
+  EXPECT_EQ(0, cv::countNonZero(norm_image != expected));
+
+  // A new image size restarts the average, which is computed immediately
+  // again.
+  cv::Mat small(60, 80, CV_8U, cv::Scalar(50));
+  norm_image = background.AddSample(small);
+  EXPECT_EQ(small.size(), norm_image.size());
+}
+
+
+TEST(ImageNormalizationTests, NormalizationImageAccumulator)
+{
+  std::vector<cv::Mat> images;
+  for (int32_t i = 0; i < 5; i++)
+  {
+    images.push_back(cv::Mat(120, 160, CV_8U, cv::Scalar(100 + i * 10)));
+  }
+
+  // The mean of a uniform image is uniform, so it's stretched to full scale.
+  image_util::NormalizationImageAccumulator mean;
+  for (size_t i = 0; i < images.size(); i++)
+  {
+    EXPECT_TRUE(mean.Add(images[i]));
+  }
+  EXPECT_EQ(5, mean.Count());
+  EXPECT_FALSE(mean.Add(cv::Mat(60, 80, CV_8U, cv::Scalar(0))));
+  EXPECT_EQ(5, mean.Count());
+
+  cv::Mat norm_image = mean.Finalize();
+  ASSERT_EQ(images[0].size(), norm_image.size());
+  ASSERT_EQ(CV_8U, norm_image.type());
+  EXPECT_EQ(0, cv::countNonZero(norm_image != 255));
+
+  // The left half of these images averages to 85 and the right half is 255,
+  // so the halves keep their values away from the edge between them.
+  mean.Reset();
+  EXPECT_EQ(0, mean.Count());
+  EXPECT_TRUE(mean.Finalize().empty());
+  for (int32_t i = 0; i < 5; i++)
+  {
+    cv::Mat image(200, 400, CV_8U, cv::Scalar(255));
+    image(cv::Rect(0, 0, 200, 200)).setTo(cv::Scalar(65 + i * 10));
+    EXPECT_TRUE(mean.Add(image));
+  }
+  norm_image = mean.Finalize();
+  ASSERT_EQ(cv::Size(400, 200), norm_image.size());
+  EXPECT_EQ(85, norm_image.at<uint8_t>(100, 50));
+  EXPECT_EQ(255, norm_image.at<uint8_t>(100, 350));
+
+  // The median of the left half is 100 and of the right half is 250, despite
+  // a saturated outlier frame which pulls the means to 131 and 251.  The
+  // halves are scaled by 255 / 250.
+  int32_t left[] = {100, 101, 99, 255, 100};
+  int32_t right[] = {250, 250, 250, 255, 250};
+  image_util::NormalizationImageAccumulator median(
+      image_util::NormalizationImageAccumulator::MEDIAN);
+  for (int32_t i = 0; i < 5; i++)
+  {
+    cv::Mat image(200, 400, CV_8U, cv::Scalar(right[i]));
+    image(cv::Rect(0, 0, 200, 200)).setTo(cv::Scalar(left[i]));
+    EXPECT_TRUE(median.Add(image));
+  }
+  norm_image = median.Finalize();
+  ASSERT_EQ(cv::Size(400, 200), norm_image.size());
+  EXPECT_EQ(102, norm_image.at<uint8_t>(100, 50));
+  EXPECT_EQ(255, norm_image.at<uint8_t>(100, 350));
+}
+
+
+TEST(ImageNormalizationTests, NormalizationApplier)
+{
+  cv::Mat norm_image(240, 320, CV_32FC1);
+  cv::Mat image(240, 320, CV_8U);
+  for (int32_t i = 0; i < image.rows; i++)
+  {
+    for (int32_t j = 0; j < image.cols; j++)
+    {
+      norm_image.at<float>(i, j) = 0.2f + 0.8f * (i + j) / (image.rows + image.cols);
+      image.at<uint8_t>(i, j) = static_cast<uint8_t>((i * 7 + j * 3) % 256);
+    }
+  }
+
+  // The result is within one gray level of dividing in floating point,
+  // whether single or multi-threaded, and whether in place or not.
+  for (int32_t threads = 1; threads <= 4; threads += 3)
+  {
+    image_util::NormalizationApplier applier(norm_image, threads);
+    ASSERT_TRUE(applier.Initialized());
+
+    cv::Mat normalized;
+    ASSERT_TRUE(applier.Apply(image, normalized));
+    cv::Mat in_place = image.clone();
+
+    // Copies share the worker threads of the original.
+    image_util::NormalizationApplier copy;
+    copy = applier;
+    ASSERT_TRUE(copy.Apply(in_place, in_place));
+
+    for (int32_t i = 0; i < image.rows; i++)
+    {
+      for (int32_t j = 0; j < image.cols; j++)
+      {
+        float expected = std::min(255.0f,
+            image.at<uint8_t>(i, j) / norm_image.at<float>(i, j));
+        EXPECT_NEAR(expected, normalized.at<uint8_t>(i, j), 1.0);
+        ASSERT_EQ(normalized.at<uint8_t>(i, j), in_place.at<uint8_t>(i, j));
+      }
+    }
+
+    EXPECT_FALSE(applier.Apply(cv::Mat(10, 10, CV_8U), normalized));
+  }
+}
+
+
 // Run the tests
 int main(int argc, char **argv)
 {
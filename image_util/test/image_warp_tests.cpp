@@ -27,6 +27,9 @@
 //
 // *****************************************************************************
 
+// C++ Standard Library
+#include <cmath>
+
 // GTEST Library
 #include <gtest/gtest.h>
 
@@ -451,6 +454,291 @@ TEST(ImageWarpTests, Test3)
   EXPECT_FLOAT_EQ(roll, 0.0);
 
 }
+TEST(ImageWarpTests, RotateImage)
+{
+  cv::Mat image(37, 70, CV_8UC3);
+  for (int32_t i = 0; i < image.rows; i++)
+  {
+    for (int32_t j = 0; j < image.cols; j++)
+    {
+      image.at<cv::Vec3b>(i, j) = cv::Vec3b(i, j, i + j);
+    }
+  }
+
+  cv::Mat rotated;
+  image_util::RotateImage(image, 1, rotated);
+  ASSERT_EQ(image.cols, rotated.rows);
+  ASSERT_EQ(image.rows, rotated.cols);
+  for (int32_t i = 0; i < rotated.rows; i++)
+  {
+    for (int32_t j = 0; j < rotated.cols; j++)
+    {
+      EXPECT_EQ(image.at<cv::Vec3b>(image.rows - 1 - j, i), rotated.at<cv::Vec3b>(i, j));
+    }
+  }
+
+  image_util::RotateImage(image, 2, rotated);
+  ASSERT_EQ(image.size(), rotated.size());
+  for (int32_t i = 0; i < rotated.rows; i++)
+  {
+    for (int32_t j = 0; j < rotated.cols; j++)
+    {
+      EXPECT_EQ(image.at<cv::Vec3b>(image.rows - 1 - i, image.cols - 1 - j), rotated.at<cv::Vec3b>(i, j));
+    }
+  }
+
+  // A counter-clockwise turn matches the transpose and flip it replaces.
+  image_util::RotateImage(image, -1, rotated);
+  cv::Mat expected;
+  cv::transpose(image, expected);
+  cv::flip(expected, expected, 0);
+  ASSERT_EQ(expected.size(), rotated.size());
+  EXPECT_EQ(0, cv::countNonZero(expected.reshape(1) != rotated.reshape(1)));
+
+  // Rotating in place gives the same result.
+  cv::Mat in_place = image.clone();
+  image_util::RotateImage(in_place, 3, in_place);
+  EXPECT_EQ(0, cv::countNonZero(in_place.reshape(1) != rotated.reshape(1)));
+}
+
+TEST(ImageWarpTests, ImageWarper)
+{
+  cv::Mat image(240, 320, CV_8U);
+  for (int32_t i = 0; i < image.rows; i++)
+  {
+    for (int32_t j = 0; j < image.cols; j++)
+    {
+      image.at<uint8_t>(i, j) = static_cast<uint8_t>((i / 2 + j / 2) % 200 + 20);
+    }
+  }
+
+  // The cached fixed-point warp matches the full warp to within rounding,
+  // whether or not the remap is split across threads.
+  double roll = 0.05;
+  double pitch = -0.08;
+  cv::Mat expected = image_util::WarpImage(image, roll, pitch);
+  for (int32_t threads = 1; threads <= 4; threads += 3)
+  {
+    image_util::ImageWarper warper(0.1, threads);
+    cv::Mat warped;
+    for (int32_t k = 0; k < 2; k++)
+    {
+      warper.Warp(image, roll, pitch, warped);
+      ASSERT_EQ(expected.size(), warped.size());
+
+      cv::Mat difference;
+      cv::absdiff(expected, warped, difference);
+      double max_difference = 0;
+      cv::minMaxLoc(difference, 0, &max_difference);
+      EXPECT_LE(max_difference, 2);
+    }
+  }
+}
+
+TEST(ImageWarpTests, ImageWarperTolerance)
+{
+  cv::Mat image(240, 320, CV_8U);
+  for (int32_t i = 0; i < image.rows; i++)
+  {
+    for (int32_t j = 0; j < image.cols; j++)
+    {
+      image.at<uint8_t>(i, j) = static_cast<uint8_t>((i / 2 + j / 2) % 200 + 20);
+    }
+  }
+
+  // With unit focal length, the corners of a 320x240 image are displaced by
+  // about 4e4 pixels per radian, so a 0.1 pixel tolerance allows a change of
+  // about 2.5e-6 radians.
+  image_util::ImageWarper warper(0.1);
+  double roll = 0.05;
+  double pitch = -0.08;
+  cv::Mat warped;
+  warper.Warp(image, roll, pitch, warped);
+  EXPECT_EQ(1, warper.BuildCount());
+
+  warper.Warp(image, roll, pitch, warped);
+  EXPECT_EQ(1, warper.BuildCount());
+
+  // Changes inside the tolerance reuse the maps.
+  warper.Warp(image, roll + 1e-6, pitch, warped);
+  EXPECT_EQ(1, warper.BuildCount());
+  warper.Warp(image, roll - 1e-6, pitch + 1e-6, warped);
+  EXPECT_EQ(1, warper.BuildCount());
+
+  // Changes outside of it rebuild them.
+  pitch += 1e-5;
+  warper.Warp(image, roll, pitch, warped);
+  EXPECT_EQ(2, warper.BuildCount());
+
+  cv::Mat expected = image_util::WarpImage(image, roll, pitch);
+  ASSERT_EQ(expected.size(), warped.size());
+  cv::Mat difference;
+  cv::absdiff(expected, warped, difference);
+  double max_difference = 0;
+  cv::minMaxLoc(difference, 0, &max_difference);
+  EXPECT_LE(max_difference, 2);
+
+  roll += 0.001;
+  warper.Warp(image, roll, pitch, warped);
+  EXPECT_EQ(3, warper.BuildCount());
+
+  // So does a change in image size.
+  warper.Warp(image(cv::Rect(0, 0, 160, 120)), roll, pitch, warped);
+  EXPECT_EQ(4, warper.BuildCount());
+}
+
+TEST(ImageWarpTests, WarpPoints)
+{
+  cv::Size image_size(640, 480);
+  cv::Mat K = cv::Mat::eye(cv::Size(3, 3), CV_32F);
+  K.at<float>(0, 2) = static_cast<double>(image_size.width - 1) / 2.0;
+  K.at<float>(1, 2) = static_cast<double>(image_size.height - 1) / 2.0;
+  cv::Mat T = cv::Mat::zeros(cv::Size(3, 1), CV_32F);
+  cv::detail::PlaneWarper warper;
+
+  cv::Mat points(100, 1, CV_32FC2);
+  std::vector<cv::KeyPoint> key_points(points.rows);
+  for (int32_t i = 0; i < points.rows; i++)
+  {
+    cv::Point2f pt((i * 37) % image_size.width, (i * 53) % image_size.height);
+    points.at<cv::Vec2f>(i, 0) = cv::Vec2f(pt.x, pt.y);
+    key_points[i] = cv::KeyPoint(pt, 7.0f, i, 1.0f, 0, i);
+  }
+
+  // The closed-form homography matches the plane warper's forward mapping to
+  // within the single precision error of the plane warper itself, which
+  // grows with the magnitude of the warped coordinates.
+  double angles[] = {-0.1, -0.02, 0.0, 0.03, 0.12};
+  for (int32_t a = 0; a < 5; a++)
+  {
+    double pitch = angles[a];
+    double roll = angles[4 - a] / 2.0;
+
+    cv::Mat warped;
+    image_util::WarpPoints(pitch, roll, image_size, points, warped);
+    ASSERT_EQ(points.size(), warped.size());
+    ASSERT_EQ(points.type(), warped.type());
+
+    std::vector<cv::KeyPoint> warped_key_points;
+    image_util::WarpPoints(pitch, roll, image_size, key_points, warped_key_points);
+    ASSERT_EQ(key_points.size(), warped_key_points.size());
+
+    cv::Mat R = image_util::GetR(pitch, roll);
+    for (int32_t i = 0; i < points.rows; i++)
+    {
+      cv::Point2f pt(points.at<cv::Vec2f>(i, 0)[0], points.at<cv::Vec2f>(i, 0)[1]);
+      cv::Point2f expected = warper.warpPoint(pt, K, R, T);
+      expected.x += K.at<float>(0, 2);
+      expected.y += K.at<float>(1, 2);
+      double tolerance_x = 5e-3 + 1e-4 * std::fabs(expected.x);
+      double tolerance_y = 5e-3 + 1e-4 * std::fabs(expected.y);
+
+      EXPECT_NEAR(expected.x, warped.at<cv::Vec2f>(i, 0)[0], tolerance_x);
+      EXPECT_NEAR(expected.y, warped.at<cv::Vec2f>(i, 0)[1], tolerance_y);
+      EXPECT_NEAR(expected.x, warped_key_points[i].pt.x, tolerance_x);
+      EXPECT_NEAR(expected.y, warped_key_points[i].pt.y, tolerance_y);
+      EXPECT_EQ(key_points[i].class_id, warped_key_points[i].class_id);
+      EXPECT_EQ(key_points[i].size, warped_key_points[i].size);
+    }
+  }
+}
+
+TEST(ImageWarpTests, EstimateNominalAngle)
+{
+  // Build two point sets related by a translation in the warped image, then
+  // unwarp them with a known pitch and roll.
+  cv::Size image_size(640, 480);
+  double pitch = 0.00006;
+  double roll = -0.00004;
+  cv::Mat H_inv = image_util::GetPointWarp(pitch, roll, image_size).inv();
+
+  cv::Mat points1(200, 1, CV_32FC2);
+  cv::Mat points2(200, 1, CV_32FC2);
+  for (int32_t i = 0; i < points1.rows; i++)
+  {
+    double x = (i * 37) % 600 + 20;
+    double y = (i * 53) % 440 + 20;
+    for (int32_t k = 0; k < 2; k++)
+    {
+      cv::Mat pt = (cv::Mat_<double>(3, 1) << x + 15 * k, y - 7 * k, 1.0);
+      cv::Mat unwarped = H_inv * pt;
+      cv::Vec2f& point = (k == 0 ? points1 : points2).at<cv::Vec2f>(i, 0);
+      point[0] = unwarped.at<double>(0) / unwarped.at<double>(2);
+      point[1] = unwarped.at<double>(1) / unwarped.at<double>(2);
+    }
+  }
+
+  // The search is deterministic regardless of the number of threads, with
+  // or without the Nelder-Mead refinement, and a pool can be reused across
+  // searches.
+  image_util::WorkerPool pool(4);
+  for (int32_t refine = 0; refine < 2; refine++)
+  {
+    double serial_pitch;
+    double serial_roll;
+    cv::Mat serial_T = image_util::PitchAndRollEstimator::EstimateNominalAngle(
+        points1, points2, image_size, serial_pitch, serial_roll, 1, refine);
+    ASSERT_FALSE(serial_T.empty());
+
+    double parallel_pitch;
+    double parallel_roll;
+    cv::Mat parallel_T = image_util::PitchAndRollEstimator::EstimateNominalAngle(
+        points1, points2, image_size, parallel_pitch, parallel_roll, 4, refine);
+    ASSERT_FALSE(parallel_T.empty());
+
+    EXPECT_EQ(serial_pitch, parallel_pitch);
+    EXPECT_EQ(serial_roll, parallel_roll);
+
+    double pooled_pitch;
+    double pooled_roll;
+    cv::Mat pooled_T = image_util::PitchAndRollEstimator::EstimateNominalAngle(
+        points1, points2, image_size, pooled_pitch, pooled_roll, pool, refine);
+    ASSERT_FALSE(pooled_T.empty());
+
+    EXPECT_EQ(serial_pitch, pooled_pitch);
+    EXPECT_EQ(serial_roll, pooled_roll);
+    EXPECT_NEAR(pitch, serial_pitch, 1e-5);
+    EXPECT_NEAR(roll, serial_roll, 1e-5);
+    EXPECT_NEAR(15.0, serial_T.at<float>(0, 2), 0.5);
+    EXPECT_NEAR(-7.0, serial_T.at<float>(1, 2), 0.5);
+  }
+}
+
+TEST(ImageWarpTests, PitchAndRollEstimatorQueue)
+{
+  image_util::PitchAndRollEstimatorQueue queue;
+  queue.SetBufferSize(4);
+
+  double pitch;
+  double roll;
+  EXPECT_FALSE(queue.GetMeanPitchAndRoll(pitch, roll));
+  EXPECT_EQ(0.0, pitch);
+  EXPECT_EQ(0.0, roll);
+
+  // The statistics follow the most recent samples as old ones are pushed
+  // out of the buffer.
+  double pitches[] = {3.0, 1.0, 4.0, 1.0, 5.0, 9.0, 2.0, 6.0};
+  double mean_pitches[] = {3.0, 2.0, 8.0 / 3.0, 2.25, 2.75, 4.75, 4.25, 5.5};
+  double median_pitches[] = {3.0, 2.0, 3.0, 2.0, 2.5, 4.5, 3.5, 5.5};
+  for (int32_t i = 0; i < 8; i++)
+  {
+    queue.LoadNewData(pitches[i], -pitches[i]);
+
+    ASSERT_TRUE(queue.GetMeanPitchAndRoll(pitch, roll));
+    EXPECT_DOUBLE_EQ(mean_pitches[i], pitch);
+    EXPECT_DOUBLE_EQ(-mean_pitches[i], roll);
+
+    ASSERT_TRUE(queue.GetMedianPitchAndRoll(pitch, roll));
+    EXPECT_DOUBLE_EQ(median_pitches[i], pitch);
+    EXPECT_DOUBLE_EQ(-median_pitches[i], roll);
+  }
+
+  queue.Clear();
+  EXPECT_FALSE(queue.GetMedianPitchAndRoll(pitch, roll));
+  EXPECT_EQ(0.0, pitch);
+  EXPECT_EQ(0.0, roll);
+}
+
 
 // Run the tests
 int main(int argc, char **argv)
@@ -0,0 +1,217 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+
+#include <image_util/latest_frame_worker.h>
+
+/**
+ * Records the frames it processes, optionally holding the worker thread in
+ * the callback until it's released.
+ */
+class FrameRecorder
+{
+public:
+  FrameRecorder() : blocked_(false), entered_(0) {}
+
+  void Process(const sensor_msgs::ImageConstPtr& image)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    entered_++;
+    condition_.notify_all();
+    while (blocked_)
+    {
+      condition_.wait(lock);
+    }
+    frames_.push_back(image->header.seq);
+    condition_.notify_all();
+  }
+
+  void Block()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    blocked_ = true;
+  }
+
+  void Release()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    blocked_ = false;
+    condition_.notify_all();
+  }
+
+  bool WaitForEntered(int32_t count)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (entered_ < count)
+    {
+      if (!condition_.timed_wait(lock, boost::posix_time::seconds(5)))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool WaitForFrames(size_t count)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (frames_.size() < count)
+    {
+      if (!condition_.timed_wait(lock, boost::posix_time::seconds(5)))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<uint32_t> Frames()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return frames_;
+  }
+
+private:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  bool blocked_;
+  int32_t entered_;
+  std::vector<uint32_t> frames_;
+};
+
+static sensor_msgs::ImageConstPtr MakeFrame(uint32_t seq)
+{
+  sensor_msgs::ImagePtr image = boost::make_shared<sensor_msgs::Image>();
+  image->header.seq = seq;
+  image->header.stamp = ros::Time::now();
+  return image;
+}
+
+static void StopWorker(image_util::LatestFrameWorker* worker)
+{
+  worker->Stop();
+}
+
+TEST(LatestFrameWorkerTests, LatestFrameWins)
+{
+  ros::NodeHandle node;
+  FrameRecorder recorder;
+  image_util::LatestFrameWorker worker;
+  worker.Start(
+      "test", boost::bind(&FrameRecorder::Process, &recorder, _1), node);
+
+  // Hold the worker on the first frame while more frames arrive.  Only the
+  // newest of them is processed once the worker is free.
+  recorder.Block();
+  worker.AddFrame(MakeFrame(1));
+  ASSERT_TRUE(recorder.WaitForEntered(1));
+
+  worker.AddFrame(MakeFrame(2));
+  worker.AddFrame(MakeFrame(3));
+  worker.AddFrame(MakeFrame(4));
+  EXPECT_EQ(2, worker.DroppedCount());
+
+  recorder.Release();
+  ASSERT_TRUE(recorder.WaitForFrames(2));
+
+  std::vector<uint32_t> frames = recorder.Frames();
+  ASSERT_EQ(2u, frames.size());
+  EXPECT_EQ(1u, frames[0]);
+  EXPECT_EQ(4u, frames[1]);
+
+  // The counters are updated after the callback returns.
+  for (int32_t i = 0; i < 500 && worker.ProcessedCount() < 2; i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  EXPECT_EQ(2, worker.ProcessedCount());
+  EXPECT_EQ(2, worker.DroppedCount());
+
+  // A frame that arrives after the previous one was processed isn't dropped.
+  worker.AddFrame(MakeFrame(5));
+  ASSERT_TRUE(recorder.WaitForFrames(3));
+  EXPECT_EQ(5u, recorder.Frames()[2]);
+  EXPECT_EQ(2, worker.DroppedCount());
+}
+
+TEST(LatestFrameWorkerTests, Stop)
+{
+  ros::NodeHandle node;
+  FrameRecorder recorder;
+  image_util::LatestFrameWorker worker;
+
+  // Stopping a worker that was never started does nothing.
+  worker.Stop();
+
+  worker.Start(
+      "test", boost::bind(&FrameRecorder::Process, &recorder, _1), node);
+  worker.AddFrame(MakeFrame(1));
+  ASSERT_TRUE(recorder.WaitForFrames(1));
+
+  // Stop joins the worker thread, whether it's idle or waiting on a frame.
+  boost::thread stop_thread(boost::bind(&StopWorker, &worker));
+  ASSERT_TRUE(stop_thread.timed_join(boost::posix_time::seconds(5)));
+
+  // Frames aren't processed after stopping.
+  worker.AddFrame(MakeFrame(2));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  EXPECT_EQ(1u, recorder.Frames().size());
+
+  // Stopping again is harmless, and the worker can be restarted.
+  worker.Stop();
+  worker.Start(
+      "test", boost::bind(&FrameRecorder::Process, &recorder, _1), node);
+  EXPECT_EQ(0, worker.ProcessedCount());
+  worker.AddFrame(MakeFrame(3));
+  ASSERT_TRUE(recorder.WaitForFrames(2));
+  EXPECT_EQ(3u, recorder.Frames()[1]);
+
+  stop_thread = boost::thread(boost::bind(&StopWorker, &worker));
+  ASSERT_TRUE(stop_thread.timed_join(boost::posix_time::seconds(5)));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  ros::init(argc, argv, "test_latest_frame_worker");
+
+  return RUN_ALL_TESTS();
+}
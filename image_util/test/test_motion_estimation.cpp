@@ -283,6 +283,144 @@ TEST(ImageUtilTests, TestComputeRigid2D_4)
   EXPECT_NEAR(transform.at<float>(1,2), estimated.at<float>(1,2), .01);
 }
 
+TEST(ImageUtilTests, TestComputeRigid2D_Parallel)
+{
+  std::srand(0);
+
+  cv::Mat transform(2, 3, CV_32F);
+  transform.at<float>(0,0) = std::cos(math_util::_half_pi * 0.5);
+  transform.at<float>(0,1) = std::sin(math_util::_half_pi * 0.5);
+  transform.at<float>(0,2) = -10;
+  transform.at<float>(1,0) = -std::sin(math_util::_half_pi * 0.5);
+  transform.at<float>(1,1) = std::cos(math_util::_half_pi * 0.5);
+  transform.at<float>(1,2) = 15;
+
+  cv::Mat p1(1000, 1, CV_32FC2);
+
+  for (int32_t i = 0; i < p1.rows; i++)
+  {
+    p1.at<cv::Vec2f>(i, 0)[0] = ((double)std::rand() / RAND_MAX) * 100 - 50;
+    p1.at<cv::Vec2f>(i, 0)[1] = ((double)std::rand() / RAND_MAX) * 100 - 50;
+  }
+
+  cv::Mat p2;
+  cv::transform(p1, p2, transform);
+
+  for (int32_t i = 0; i < p2.rows; i++)
+  {
+    p2.at<cv::Vec2f>(i, 0)[0] += ((double)std::rand() / RAND_MAX) * 2 - 1;
+    p2.at<cv::Vec2f>(i, 0)[1] += ((double)std::rand() / RAND_MAX) * 2 - 1;
+  }
+
+  for (int32_t i = 0; i < p2.rows; i+=5)
+  {
+    p2.at<cv::Vec2f>(i, 0)[0] += ((double)std::rand() / RAND_MAX) * 2000 - 1000;
+    p2.at<cv::Vec2f>(i, 0)[1] += ((double)std::rand() / RAND_MAX) * 2000 - 1000;
+  }
+
+  cv::Mat inliers1;
+  cv::Mat inliers2;
+  std::vector<uint32_t> good_points;
+  cv::Mat estimated = image_util::ComputeRigid2DTransform(
+      p1, p2, inliers1, inliers2, good_points, 4000, 20.0, 5, 1);
+
+  ASSERT_FALSE(estimated.empty());
+
+  // The result only depends on the seed, not the number of threads.
+  for (int32_t threads = 2; threads <= 8; threads *= 2)
+  {
+    std::vector<uint32_t> parallel_points;
+    cv::Mat parallel = image_util::ComputeRigid2DTransform(
+        p1, p2, inliers1, inliers2, parallel_points, 4000, 20.0, 5, threads);
+    ASSERT_FALSE(parallel.empty());
+    EXPECT_EQ(0, cv::countNonZero(estimated != parallel));
+    EXPECT_TRUE(good_points == parallel_points);
+  }
+
+  // A pool can be reused between searches.
+  image_util::WorkerPool pool(4);
+  for (int32_t k = 0; k < 2; k++)
+  {
+    std::vector<uint32_t> pooled_points;
+    cv::Mat pooled = image_util::ComputeRigid2DTransform(
+        p1, p2, inliers1, inliers2, pooled_points, 4000, 20.0, 5, pool);
+    ASSERT_FALSE(pooled.empty());
+    EXPECT_EQ(0, cv::countNonZero(estimated != pooled));
+    EXPECT_TRUE(good_points == pooled_points);
+  }
+
+  EXPECT_NEAR(transform.at<float>(0,0), estimated.at<float>(0,0), .0005);
+  EXPECT_NEAR(transform.at<float>(0,1), estimated.at<float>(0,1), .0005);
+  EXPECT_NEAR(transform.at<float>(0,2), estimated.at<float>(0,2), .01);
+  EXPECT_NEAR(transform.at<float>(1,0), estimated.at<float>(1,0), .0005);
+  EXPECT_NEAR(transform.at<float>(1,1), estimated.at<float>(1,1), .0005);
+  EXPECT_NEAR(transform.at<float>(1,2), estimated.at<float>(1,2), .01);
+}
+
+TEST(ImageUtilTests, TestComputeLooseAffine2D_1)
+{
+  std::srand(0);
+
+  cv::Mat transform(2, 3, CV_32F);
+  transform.at<float>(0,0) = std::cos(math_util::_half_pi * 0.1);
+  transform.at<float>(0,1) = std::sin(math_util::_half_pi * 0.1);
+  transform.at<float>(0,2) = -10;
+  transform.at<float>(1,0) = -std::sin(math_util::_half_pi * 0.1);
+  transform.at<float>(1,1) = std::cos(math_util::_half_pi * 0.1);
+  transform.at<float>(1,2) = 15;
+
+  cv::Mat p1(1, 1000, CV_32FC2);
+
+  for (int32_t i = 0; i < p1.cols; i++)
+  {
+    p1.at<cv::Vec2f>(0, i)[0] = ((double)std::rand() / RAND_MAX) * 100 - 50;
+    p1.at<cv::Vec2f>(0, i)[1] = ((double)std::rand() / RAND_MAX) * 100 - 50;
+  }
+
+  cv::Mat p2;
+  cv::transform(p1, p2, transform);
+
+  for (int32_t i = 0; i < p2.cols; i++)
+  {
+    p2.at<cv::Vec2f>(0, i)[0] += ((double)std::rand() / RAND_MAX) * 2 - 1;
+    p2.at<cv::Vec2f>(0, i)[1] += ((double)std::rand() / RAND_MAX) * 2 - 1;
+  }
+
+  for (int32_t i = 0; i < p2.cols; i+=5)
+  {
+    p2.at<cv::Vec2f>(0, i)[0] += ((double)std::rand() / RAND_MAX) * 2000 - 1000;
+    p2.at<cv::Vec2f>(0, i)[1] += ((double)std::rand() / RAND_MAX) * 2000 - 1000;
+  }
+
+  cv::Mat inliers1;
+  cv::Mat inliers2;
+  cv::Mat T_rigid;
+  double rms_error;
+  cv::Mat estimated = image_util::ComputeLooseAffine2DTransform(
+      p1, p2, inliers1, inliers2, T_rigid, rms_error, 1);
+
+  ASSERT_FALSE(estimated.empty());
+  EXPECT_NEAR(transform.at<float>(0,0), T_rigid.at<float>(0,0), .005);
+  EXPECT_NEAR(transform.at<float>(0,1), T_rigid.at<float>(0,1), .005);
+  EXPECT_NEAR(transform.at<float>(1,0), T_rigid.at<float>(1,0), .005);
+  EXPECT_NEAR(transform.at<float>(1,1), T_rigid.at<float>(1,1), .005);
+
+  // The inliers keep the layout of the input points.
+  EXPECT_EQ(1, inliers1.rows);
+  EXPECT_GE(inliers1.cols, 790);
+  EXPECT_EQ(inliers1.size(), inliers2.size());
+
+  // The same seed gives the same result.
+  cv::Mat inliers1_2;
+  cv::Mat inliers2_2;
+  cv::Mat T_rigid_2;
+  double rms_error_2;
+  image_util::ComputeLooseAffine2DTransform(
+      p1, p2, inliers1_2, inliers2_2, T_rigid_2, rms_error_2, 1);
+  EXPECT_EQ(inliers1.cols, inliers1_2.cols);
+  EXPECT_EQ(rms_error, rms_error_2);
+}
+
 TEST(ImageUtilTests, TestComputeRigid3D_1)
 {
   std::srand(0);
@@ -524,6 +662,85 @@ TEST(ImageUtilTests, TestComputeRigid3D_4)
   EXPECT_NEAR(transform.at<float>(2,3), estimated.at<float>(2,3), .25);
 }
 
+TEST(ImageUtilTests, TestComputeRigid3D_Parallel)
+{
+  std::srand(0);
+
+  cv::Mat transform(3, 4, CV_32F);
+  transform.at<float>(0,0) = 0.492403876506104;
+  transform.at<float>(0,1) = 0.586824088833465;
+  transform.at<float>(0,2) = -0.642787609686539;
+  transform.at<float>(0,3) = 20;
+  transform.at<float>(1,0) = 0.413175911166535;
+  transform.at<float>(1,1) = 0.492403876506104;
+  transform.at<float>(1,2) = 0.766044443118978;
+  transform.at<float>(1,3) = 25;
+  transform.at<float>(2,0) = 0.766044443118978;
+  transform.at<float>(2,1) = -0.642787609686539;
+  transform.at<float>(2,2) = 0;
+  transform.at<float>(2,3) = -15;
+
+  cv::Mat p1(1, 1000, CV_32FC3);
+
+  for (int32_t i = 0; i < p1.cols; i++)
+  {
+    p1.at<cv::Vec3f>(0, i)[0] = ((double)std::rand() / RAND_MAX) * 100 - 50;
+    p1.at<cv::Vec3f>(0, i)[1] = ((double)std::rand() / RAND_MAX) * 100 - 50;
+    p1.at<cv::Vec3f>(0, i)[2] = ((double)std::rand() / RAND_MAX) * 100 - 50;
+  }
+
+  cv::Mat p2;
+  cv::transform(p1, p2, transform);
+
+  for (int32_t i = 0; i < p2.cols; i++)
+  {
+    p2.at<cv::Vec3f>(0, i)[0] += ((double)std::rand() / RAND_MAX) * 2 - 1;
+    p2.at<cv::Vec3f>(0, i)[1] += ((double)std::rand() / RAND_MAX) * 2 - 1;
+    p2.at<cv::Vec3f>(0, i)[2] += ((double)std::rand() / RAND_MAX) * 2 - 1;
+  }
+
+  for (int32_t i = 0; i < p2.cols; i+=5)
+  {
+    p2.at<cv::Vec3f>(0, i)[0] += ((double)std::rand() / RAND_MAX) * 2000 - 1000;
+    p2.at<cv::Vec3f>(0, i)[1] += ((double)std::rand() / RAND_MAX) * 2000 - 1000;
+    p2.at<cv::Vec3f>(0, i)[2] += ((double)std::rand() / RAND_MAX) * 2000 - 1000;
+  }
+
+  cv::Mat estimated = image_util::ComputeRigid3DTransform(p1, p2, 1, 1);
+
+  ASSERT_FALSE(estimated.empty());
+
+  // The result only depends on the seed, not the number of threads.
+  for (int32_t threads = 2; threads <= 8; threads *= 2)
+  {
+    cv::Mat parallel = image_util::ComputeRigid3DTransform(p1, p2, 1, threads);
+    ASSERT_FALSE(parallel.empty());
+    EXPECT_EQ(0, cv::countNonZero(estimated != parallel));
+  }
+
+  // A pool can be reused between searches.
+  image_util::WorkerPool pool(4);
+  for (int32_t k = 0; k < 2; k++)
+  {
+    cv::Mat pooled = image_util::ComputeRigid3DTransform(p1, p2, 1, pool);
+    ASSERT_FALSE(pooled.empty());
+    EXPECT_EQ(0, cv::countNonZero(estimated != pooled));
+  }
+
+  EXPECT_NEAR(transform.at<float>(0,0), estimated.at<float>(0,0), .008);
+  EXPECT_NEAR(transform.at<float>(0,1), estimated.at<float>(0,1), .008);
+  EXPECT_NEAR(transform.at<float>(0,2), estimated.at<float>(0,2), .008);
+  EXPECT_NEAR(transform.at<float>(0,3), estimated.at<float>(0,3), .25);
+  EXPECT_NEAR(transform.at<float>(1,0), estimated.at<float>(1,0), .008);
+  EXPECT_NEAR(transform.at<float>(1,1), estimated.at<float>(1,1), .008);
+  EXPECT_NEAR(transform.at<float>(1,2), estimated.at<float>(1,2), .008);
+  EXPECT_NEAR(transform.at<float>(1,3), estimated.at<float>(1,3), .25);
+  EXPECT_NEAR(transform.at<float>(2,0), estimated.at<float>(2,0), .008);
+  EXPECT_NEAR(transform.at<float>(2,1), estimated.at<float>(2,1), .008);
+  EXPECT_NEAR(transform.at<float>(2,2), estimated.at<float>(2,2), .008);
+  EXPECT_NEAR(transform.at<float>(2,3), estimated.at<float>(2,3), .25);
+}
+
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv)
 {
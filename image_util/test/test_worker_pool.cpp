@@ -0,0 +1,115 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <set>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <image_util/worker_pool.h>
+
+/**
+ * Records which thread ran each index of a job.
+ */
+class JobRecorder
+{
+public:
+  explicit JobRecorder(int32_t size) : indices_(size, 0), ids_(size) {}
+
+  void Run(int32_t index, int32_t count)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    counts_.insert(count);
+    indices_[index]++;
+    ids_[index] = boost::this_thread::get_id();
+  }
+
+  boost::mutex mutex_;
+  std::set<int32_t> counts_;
+  std::vector<int32_t> indices_;
+  std::vector<boost::thread::id> ids_;
+};
+
+TEST(WorkerPoolTests, Run)
+{
+  image_util::WorkerPool pool(4);
+  ASSERT_EQ(4, pool.Size());
+
+  JobRecorder first(4);
+  pool.Run(boost::bind(&JobRecorder::Run, &first, _1, _2));
+
+  // Every index runs exactly once, on a distinct thread, with the caller
+  // taking index 0.
+  ASSERT_EQ(1u, first.counts_.size());
+  EXPECT_EQ(4, *first.counts_.begin());
+  std::set<boost::thread::id> ids(first.ids_.begin(), first.ids_.end());
+  EXPECT_EQ(4u, ids.size());
+  EXPECT_EQ(boost::this_thread::get_id(), first.ids_[0]);
+  for (int32_t i = 0; i < 4; i++)
+  {
+    EXPECT_EQ(1, first.indices_[i]);
+  }
+
+  // Later jobs reuse the same threads.
+  JobRecorder later(4);
+  for (int32_t k = 0; k < 100; k++)
+  {
+    pool.Run(boost::bind(&JobRecorder::Run, &later, _1, _2));
+  }
+  for (int32_t i = 0; i < 4; i++)
+  {
+    EXPECT_EQ(100, later.indices_[i]);
+    EXPECT_EQ(first.ids_[i], later.ids_[i]);
+  }
+}
+
+TEST(WorkerPoolTests, SingleThread)
+{
+  image_util::WorkerPool pool(1);
+  ASSERT_EQ(1, pool.Size());
+
+  JobRecorder recorder(1);
+  pool.Run(boost::bind(&JobRecorder::Run, &recorder, _1, _2));
+  EXPECT_EQ(1, recorder.indices_[0]);
+  EXPECT_EQ(boost::this_thread::get_id(), recorder.ids_[0]);
+
+  image_util::WorkerPool default_pool;
+  EXPECT_GE(default_pool.Size(), 1);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -37,6 +37,11 @@ namespace transform_util
    */
   static const double _earth_equator_radius = 6378137.0;
 
+  /**
+   * Earth mean radius in meters (IUGG), used for spherical approximations.
+   */
+  static const double _earth_mean_radius = 6371008.8;
+
   /**
    * Earth 'first' eccentricity according to WGS84.
    */
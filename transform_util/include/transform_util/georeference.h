@@ -31,6 +31,7 @@
 #define TRANSFORM_UTIL_GEOREFERENCE_H_
 
 #include <string>
+#include <vector>
 
 #include <yaml-cpp/yaml.h>
 #include <opencv/cv.h>
@@ -61,6 +62,60 @@ namespace transform_util
     void GetCoordinate(int x_pixel, int y_pixel, double& x_coordinate, double& y_coordinate) const;
     void GetPixel(double x_coordinate, double y_coordinate, int& x_pixel, int& y_pixel) const;
 
+    /**
+     * Convert an array of pixels to coordinates.
+     *
+     * Pixels may be sub-pixel positions.  No memory is allocated.
+     *
+     * @param[in]  pixels       The input pixels.
+     * @param[in]  count        The number of pixels.
+     * @param[out] coordinates  The output coordinates.  Must hold count points.
+     */
+    void GetCoordinates(
+      const cv::Point2d* pixels,
+      size_t count,
+      cv::Point2d* coordinates) const;
+
+    /**
+     * Convert a list of pixels to coordinates.
+     *
+     * The output is resized to match the input, so no memory is allocated if
+     * it already has enough capacity.
+     *
+     * @param[in]  pixels       The input pixels.
+     * @param[out] coordinates  The output coordinates.
+     */
+    void GetCoordinates(
+      const std::vector<cv::Point2d>& pixels,
+      std::vector<cv::Point2d>& coordinates) const;
+
+    /**
+     * Convert an array of coordinates to pixels.
+     *
+     * Pixel values are truncated like GetPixel().  No memory is allocated.
+     *
+     * @param[in]  coordinates  The input coordinates.
+     * @param[in]  count        The number of coordinates.
+     * @param[out] pixels       The output pixels.  Must hold count points.
+     */
+    void GetPixels(
+      const cv::Point2d* coordinates,
+      size_t count,
+      cv::Point* pixels) const;
+
+    /**
+     * Convert a list of coordinates to pixels.
+     *
+     * The output is resized to match the input, so no memory is allocated if
+     * it already has enough capacity.
+     *
+     * @param[in]  coordinates  The input coordinates.
+     * @param[out] pixels       The output pixels.
+     */
+    void GetPixels(
+      const std::vector<cv::Point2d>& coordinates,
+      std::vector<cv::Point>& pixels) const;
+
   private:
     bool loaded_;
 
@@ -86,8 +141,32 @@ namespace transform_util
     double x_offset_;
     double y_offset_;
 
+    // Double precision copies of the affine transforms for fast evaluation,
+    // with the coordinate offset folded into the translation.
+    cv::Matx23d pixel_to_coordinate_;
+    cv::Matx23d coordinate_to_pixel_;
+
     void GetTransform();
+    void UpdateCoefficients();
   };
+
+  inline void GeoReference::GetCoordinate(
+    int x_pixel, int y_pixel,
+    double& x_coordinate, double& y_coordinate) const
+  {
+    const cv::Matx23d& t = pixel_to_coordinate_;
+    x_coordinate = t(0, 0) * x_pixel + t(0, 1) * y_pixel + t(0, 2);
+    y_coordinate = t(1, 0) * x_pixel + t(1, 1) * y_pixel + t(1, 2);
+  }
+
+  inline void GeoReference::GetPixel(
+    double x_coordinate, double y_coordinate,
+    int& x_pixel, int& y_pixel) const
+  {
+    const cv::Matx23d& t = coordinate_to_pixel_;
+    x_pixel = static_cast<int>(t(0, 0) * x_coordinate + t(0, 1) * y_coordinate + t(0, 2));
+    y_pixel = static_cast<int>(t(1, 0) * x_coordinate + t(1, 1) * y_coordinate + t(1, 2));
+  }
 }
 
 #endif  // TRANSFORM_UTIL_GEOREFERENCE_H_
@@ -0,0 +1,248 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef TRANSFORM_UTIL_TILE_CACHE_H_
+#define TRANSFORM_UTIL_TILE_CACHE_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <transform_util/georeference.h>
+
+namespace transform_util
+{
+  /**
+   * Identifies a tile of an image pyramid.
+   *
+   * Level 0 is the full resolution image and each following level is half the
+   * resolution of the previous one.  x and y are the tile column and row.
+   */
+  struct TileKey
+  {
+    TileKey() : level(0), x(0), y(0) {}
+    TileKey(int32_t level, int32_t x, int32_t y) : level(level), x(x), y(y) {}
+
+    bool operator<(const TileKey& other) const
+    {
+      if (level != other.level) return level < other.level;
+      if (y != other.y) return y < other.y;
+      return x < other.x;
+    }
+
+    bool operator==(const TileKey& other) const
+    {
+      return level == other.level && x == other.x && y == other.y;
+    }
+
+    int32_t level;
+    int32_t x;
+    int32_t y;
+  };
+
+  /**
+   * A cache of tiles from the image pyramid of georeferenced imagery.
+   *
+   * The pyramid is built offline (see WritePyramid) into one file per level
+   * named level_<N>.tiles within the pyramid directory.  Each file starts
+   * with a TileFileHeader and is followed by the raw 8-bit tiles in row-major
+   * tile order, each tile being tile_size x tile_size pixels with the edge
+   * tiles zero padded.
+   *
+   * The level files are memory mapped, so only the tiles that are actually
+   * requested are read from disk.  Requested tiles are copied into a least
+   * recently used cache bounded by a memory budget, and tiles along an
+   * expected query path can be prefetched on a background thread.
+   */
+  class TileCache
+  {
+  public:
+    struct TileFileHeader
+    {
+      char magic[4];
+      uint32_t version;
+      uint32_t tile_size;
+      uint32_t channels;
+      uint32_t width;
+      uint32_t height;
+      uint32_t tiles_x;
+      uint32_t tiles_y;
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param[in]  georeference   The loaded georeference of the imagery.
+     * @param[in]  pyramid_path   The directory containing the pyramid.
+     * @param[in]  memory_budget  The maximum size of the cached tiles in
+     *                            bytes.
+     */
+    TileCache(
+      const GeoReference& georeference,
+      const std::string& pyramid_path,
+      size_t memory_budget = 256 * 1024 * 1024);
+    ~TileCache();
+
+    /**
+     * Memory map the levels of the pyramid.
+     *
+     * @returns True if at least the full resolution level was opened.
+     */
+    bool Open();
+
+    int32_t Levels() const { return levels_.size(); }
+
+    /**
+     * Get a tile, loading it from the pyramid if it isn't cached.
+     *
+     * @param[in]  key  The tile.
+     *
+     * @returns The tile, or an empty image if it doesn't exist.
+     */
+    cv::Mat GetTile(const TileKey& key);
+
+    /**
+     * Get the keys of the tiles covering a coordinate box.
+     *
+     * @param[in]  min_x   The minimum x coordinate of the box.
+     * @param[in]  min_y   The minimum y coordinate of the box.
+     * @param[in]  max_x   The maximum x coordinate of the box.
+     * @param[in]  max_y   The maximum y coordinate of the box.
+     * @param[in]  level   The pyramid level.
+     * @param[out] keys    The tiles covering the box.
+     */
+    void GetTileKeys(
+      double min_x, double min_y,
+      double max_x, double max_y,
+      int32_t level,
+      std::vector<TileKey>& keys) const;
+
+    /**
+     * Get the tiles covering a coordinate box.
+     *
+     * @param[in]  min_x   The minimum x coordinate of the box.
+     * @param[in]  min_y   The minimum y coordinate of the box.
+     * @param[in]  max_x   The maximum x coordinate of the box.
+     * @param[in]  max_y   The maximum y coordinate of the box.
+     * @param[in]  level   The pyramid level.
+     * @param[out] keys    The tiles covering the box.
+     * @param[out] tiles   The tile images, in the same order as the keys.
+     */
+    void GetTiles(
+      double min_x, double min_y,
+      double max_x, double max_y,
+      int32_t level,
+      std::vector<TileKey>& keys,
+      std::vector<cv::Mat>& tiles);
+
+    /**
+     * Load the tiles around a path of coordinates in the background.
+     *
+     * @param[in]  path    The coordinates along the path, in the order they
+     *                     are expected to be queried.
+     * @param[in]  radius  The distance around each coordinate to load, in
+     *                     the units of the coordinates.
+     * @param[in]  level   The pyramid level.
+     */
+    void Prefetch(
+      const std::vector<cv::Point2d>& path,
+      double radius,
+      int32_t level);
+
+    /**
+     * @returns The size of the cached tiles in bytes.
+     */
+    size_t MemoryUsage() const;
+
+    /**
+     * Write an image pyramid to disk in the format read by the cache.
+     *
+     * @param[in]  image          The full resolution 8-bit image.
+     * @param[in]  tile_size      The tile size in pixels.
+     * @param[in]  levels         The number of levels to write.
+     * @param[in]  pyramid_path   The output directory.
+     *
+     * @returns True if the pyramid was written.
+     */
+    static bool WritePyramid(
+      const cv::Mat& image,
+      int32_t tile_size,
+      int32_t levels,
+      const std::string& pyramid_path);
+
+  private:
+    struct Level
+    {
+      Level() : data(NULL), size(0) {}
+
+      TileFileHeader header;
+      const uint8_t* data;
+      size_t size;
+    };
+
+    struct CacheEntry
+    {
+      cv::Mat tile;
+      std::list<TileKey>::iterator lru;
+    };
+
+    GeoReference georeference_;
+    std::string pyramid_path_;
+    size_t memory_budget_;
+
+    std::vector<Level> levels_;
+
+    mutable boost::mutex mutex_;
+    std::map<TileKey, CacheEntry> cache_;
+    std::list<TileKey> lru_;
+    size_t memory_usage_;
+
+    std::deque<TileKey> prefetch_queue_;
+    boost::condition_variable prefetch_condition_;
+    boost::thread prefetch_thread_;
+    bool stop_;
+
+    cv::Mat LoadTile(const TileKey& key) const;
+    void AddTile(const TileKey& key, const cv::Mat& tile);
+    void PrefetchThread();
+    void Close();
+  };
+}
+
+#endif  // TRANSFORM_UTIL_TILE_CACHE_H_
@@ -30,6 +30,8 @@
 #ifndef TRANSFORM_UTIL_TRANSFORM_H_
 #define TRANSFORM_UTIL_TRANSFORM_H_
 
+#include <vector>
+
 #include <boost/shared_ptr.hpp>
 
 #include <ros/ros.h>
@@ -45,7 +47,45 @@ namespace transform_util
     virtual ~TransformImpl() {}
     virtual void Transform(
       const tf::Vector3& v_in, tf::Vector3& v_out) const = 0;
-    
+
+    /**
+     * Transform an array of vectors.
+     *
+     * The default implementation calls Transform() for each vector.  The input
+     * and output arrays may be the same object.
+     *
+     * @param[in]  v_in   The input vectors.
+     * @param[out] v_out  The transformed vectors.
+     */
+    virtual void TransformPoints(
+      const std::vector<tf::Vector3>& v_in,
+      std::vector<tf::Vector3>& v_out) const;
+
+    /**
+     * Get the affine matrix and offset of the transform, if it has one.
+     *
+     * @param[out] basis   The 3x3 linear part of the transform.
+     * @param[out] origin  The translation part of the transform.
+     *
+     * @returns True if the transform is affine.
+     */
+    virtual bool GetAffine(tf::Matrix3x3& basis, tf::Vector3& origin) const;
+
+    /**
+     * Get the primitive stages making up the transform, in the order they are
+     * applied.
+     *
+     * Transforms that are a chain of simpler transforms (for example a rigid
+     * transform followed by a geodesic conversion) should expose their stages
+     * so that adjacent rigid stages of composed transforms can be fused.
+     *
+     * @param[out] stages  The stages of the transform.
+     *
+     * @returns True if the transform was decomposed into stages.
+     */
+    virtual bool GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const;
+
     ros::Time stamp_;
   };
 
@@ -130,6 +170,56 @@ namespace transform_util
      */
     tf::Vector3 operator*(const tf::Vector3& v) const;
 
+    /**
+     * Return the composition of this transform with another transform.
+     *
+     * Like tf::Transform, the right-hand transform is applied first.  Adjacent
+     * rigid and affine stages of the two transforms are fused into a single
+     * matrix so that each point only pays for one multiplication between
+     * non-linear stages.
+     *
+     * @param[in]  transform  The transform to apply before this one.
+     *
+     * @returns The composed transform.
+     */
+    Transform operator*(const Transform& transform) const;
+
+    /**
+     * Transform an array of vectors.
+     *
+     * Multi-stage transforms apply each stage to the whole array before moving
+     * on to the next one.
+     *
+     * @param[in]  v_in   The input vectors.
+     * @param[out] v_out  The transformed vectors.
+     */
+    void TransformPoints(
+      const std::vector<tf::Vector3>& v_in,
+      std::vector<tf::Vector3>& v_out) const;
+
+    /**
+     * Approximate the transform with an affine transform over a bounded
+     * region.
+     *
+     * The linearization is computed from central differences about the center
+     * of the region and then checked against the exact transform on a grid of
+     * samples covering the region.  This is intended for geodesic transforms
+     * applied over small local areas.
+     *
+     * @param[in]  min          The minimum corner of the input region.
+     * @param[in]  max          The maximum corner of the input region.
+     * @param[in]  max_error    The maximum allowed error of the approximation,
+     *                          in the units of the output frame.
+     * @param[out] linearized   The affine approximation.
+     *
+     * @returns True if the approximation is within the allowed error.
+     */
+    bool Linearize(
+      const tf::Vector3& min,
+      const tf::Vector3& max,
+      double max_error,
+      Transform& linearized) const;
+
     /**
      * Return the inverse transform.
      *
@@ -152,6 +242,7 @@ namespace transform_util
   public:
     IdentityTransform() { stamp_ = ros::Time::now(); }
     virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
+    virtual bool GetAffine(tf::Matrix3x3& basis, tf::Vector3& origin) const;
   };
 
   class TfTransform : public TransformImpl
@@ -160,10 +251,54 @@ namespace transform_util
     explicit TfTransform(const tf::Transform& transform);
     explicit TfTransform(const tf::StampedTransform& transform);
     virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
+    virtual bool GetAffine(tf::Matrix3x3& basis, tf::Vector3& origin) const;
 
   protected:
     tf::Transform transform_;
   };
+
+  /**
+   * A general (not necessarily rigid) affine transform.
+   */
+  class AffineTransform : public TransformImpl
+  {
+  public:
+    AffineTransform(const tf::Matrix3x3& basis, const tf::Vector3& origin);
+    virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
+    virtual bool GetAffine(tf::Matrix3x3& basis, tf::Vector3& origin) const;
+
+  protected:
+    tf::Matrix3x3 basis_;
+    tf::Vector3 origin_;
+  };
+
+  /**
+   * A chain of transform stages applied in order.
+   *
+   * Adjacent affine stages are fused into a single stage on construction.
+   */
+  class CompositeTransform : public TransformImpl
+  {
+  public:
+    explicit CompositeTransform(
+      const std::vector<boost::shared_ptr<TransformImpl> >& stages);
+
+    virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
+
+    virtual void TransformPoints(
+      const std::vector<tf::Vector3>& v_in,
+      std::vector<tf::Vector3>& v_out) const;
+
+    virtual bool GetAffine(tf::Matrix3x3& basis, tf::Vector3& origin) const;
+
+    virtual bool GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const;
+
+    size_t NumStages() const { return stages_.size(); }
+
+  protected:
+    std::vector<boost::shared_ptr<TransformImpl> > stages_;
+  };
 }
 
 #endif  // TRANSFORM_UTIL_TRANSFORM_H_
@@ -0,0 +1,285 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef TRANSFORM_UTIL_TRANSFORM_BUFFER_H_
+#define TRANSFORM_UTIL_TRANSFORM_BUFFER_H_
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/ros.h>
+#include <tf/transform_datatypes.h>
+#include <tf/transform_listener.h>
+
+namespace transform_util
+{
+  /**
+   * A time history of the transform between a single pair of frames.
+   *
+   * The samples are kept sorted by time in a ring buffer that is allocated
+   * once, so inserting a sample newer than the rest doesn't copy or
+   * allocate.  Writers are serialized by a mutex and bump a sequence number
+   * around each change.  Readers never lock; they retry if the sequence
+   * number shows a write overlapped the read.  Lookups bracket the requested
+   * time with a binary search and interpolate the translation linearly and
+   * the rotation with slerp.
+   */
+  class TransformHistory
+  {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param[in]  target_frame  The target frame of the transforms.
+     * @param[in]  source_frame  The source frame of the transforms.
+     * @param[in]  cache_time    How long samples are kept relative to the
+     *                           newest sample.
+     * @param[in]  max_samples   The maximum number of samples to keep.
+     */
+    TransformHistory(
+        const std::string& target_frame,
+        const std::string& source_frame,
+        const ros::Duration& cache_time = ros::Duration(10.0),
+        size_t max_samples = 1000);
+
+    /**
+     * Add a sample to the history.
+     *
+     * Samples may arrive out of order, at the cost of shifting the newer
+     * samples.  A sample with the same stamp as an existing one replaces it.
+     *
+     * @param[in]  transform  The transform from the source frame to the
+     *                        target frame.
+     * @param[in]  stamp      The time of the transform.
+     */
+    void Insert(const tf::Transform& transform, const ros::Time& stamp);
+
+    /**
+     * Get the transform at the specified time.
+     *
+     * A time of 0 returns the newest sample.  Times outside of the range of
+     * the history are not extrapolated.
+     *
+     * @param[in]  time       The time of the transform.
+     * @param[out] transform  The interpolated transform.
+     *
+     * @returns True if the time is covered by the history.
+     */
+    bool Lookup(const ros::Time& time, tf::StampedTransform& transform) const;
+
+    /**
+     * @returns The time of the newest sample, or 0 if the history is empty.
+     */
+    ros::Time Newest() const;
+
+    /**
+     * @returns The time of the oldest sample, or 0 if the history is empty.
+     */
+    ros::Time Oldest() const;
+
+    size_t Size() const;
+
+    const std::string& TargetFrame() const { return target_frame_; }
+    const std::string& SourceFrame() const { return source_frame_; }
+
+  private:
+    struct Sample
+    {
+      ros::Time stamp;
+      tf::Vector3 origin;
+      tf::Quaternion rotation;
+
+      bool operator<(const Sample& other) const { return stamp < other.stamp; }
+    };
+
+    /**
+     * @returns The sample at the given position, counting from the oldest.
+     */
+    const Sample& At(size_t index) const
+    {
+      return samples_[(start_ + index) % max_samples_];
+    }
+    Sample& At(size_t index)
+    {
+      return samples_[(start_ + index) % max_samples_];
+    }
+
+    /**
+     * @returns The position of the first sample not older than the stamp.
+     */
+    size_t LowerBound(const ros::Time& stamp, size_t count) const;
+
+    uint32_t BeginRead() const;
+    bool EndRead(uint32_t sequence) const;
+    void BeginWrite();
+    void EndWrite();
+
+    std::string target_frame_;
+    std::string source_frame_;
+    ros::Duration cache_time_;
+    size_t max_samples_;
+
+    // Ring buffer of max_samples_ samples; the oldest is at start_.
+    std::vector<Sample> samples_;
+    size_t start_;
+    size_t count_;
+
+    // Odd while a write is in progress.
+    volatile uint32_t sequence_;
+    boost::mutex write_mutex_;
+  };
+  typedef boost::shared_ptr<TransformHistory> TransformHistoryPtr;
+
+  /**
+   * A collection of transform histories for a set of frame pairs.
+   *
+   * The buffer can be filled directly with Insert() or fed from a
+   * tf::TransformListener (or any tf::Transformer) for a set of tracked frame
+   * pairs with Update().  It is intended for consumers that repeatedly query
+   * the same handful of frame pairs at many different times, which would
+   * otherwise walk the tf tree under the listener's locks for every query.
+   */
+  class TransformBuffer
+  {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param[in]  cache_time   How long samples are kept for each frame pair.
+     * @param[in]  max_samples  The maximum number of samples per frame pair.
+     */
+    explicit TransformBuffer(
+        const ros::Duration& cache_time = ros::Duration(10.0),
+        size_t max_samples = 1000);
+
+    /**
+     * Add a transform to the buffer.
+     *
+     * The frame pair is taken from the frame_id_ (target) and child_frame_id_
+     * (source) of the transform.
+     *
+     * @param[in]  transform  The transform.
+     */
+    void Insert(const tf::StampedTransform& transform);
+
+    /**
+     * Track a frame pair so that it is filled by Update().
+     *
+     * @param[in]  target_frame  The target frame.
+     * @param[in]  source_frame  The source frame.
+     */
+    void Track(const std::string& target_frame, const std::string& source_frame);
+
+    /**
+     * Pull the latest available transform of each tracked frame pair from a
+     * tf listener into the buffer.
+     *
+     * Only the latest sample is taken on each call; tf doesn't expose the
+     * times of the samples it holds.  The history is therefore sampled at
+     * the update rate, and samples tf received between updates are only
+     * represented by interpolation.  For the full rate of a frame pair,
+     * Insert() its transforms from a /tf subscription instead.
+     *
+     * @param[in]  tf_listener  The tf listener.
+     */
+    void Update(const tf::Transformer& tf_listener);
+
+    /**
+     * Periodically call Update() with the given listener from a ROS timer.
+     * The rate should be at least the publishing rate of the tracked frame
+     * pairs; see Update().
+     *
+     * @param[in]  tf_listener  The tf listener.
+     * @param[in]  rate         The update rate in Hz.
+     */
+    void Listen(
+        boost::shared_ptr<tf::Transformer> tf_listener,
+        double rate);
+
+    /**
+     * Get the transform between two frames at the specified time.
+     *
+     * @param[in]  target_frame  The target frame.
+     * @param[in]  source_frame  The source frame.
+     * @param[in]  time          The time of the transform, or 0 for the
+     *                           latest available.
+     * @param[out] transform     The transform.
+     *
+     * @returns True if the frame pair is buffered and covers the time.
+     */
+    bool Lookup(
+        const std::string& target_frame,
+        const std::string& source_frame,
+        const ros::Time& time,
+        tf::StampedTransform& transform) const;
+
+    /**
+     * Get the history of a frame pair.
+     *
+     * @returns The history, or a null pointer if the pair isn't buffered.
+     */
+    TransformHistoryPtr GetHistory(
+        const std::string& target_frame,
+        const std::string& source_frame) const;
+
+  private:
+    typedef std::pair<std::string, std::string> FramePair;
+    typedef std::map<FramePair, TransformHistoryPtr> HistoryMap;
+
+    ros::Duration cache_time_;
+    size_t max_samples_;
+
+    boost::shared_ptr<const HistoryMap> histories_;
+    boost::mutex write_mutex_;
+
+    boost::shared_ptr<tf::Transformer> tf_listener_;
+    ros::Timer timer_;
+
+    static FramePair GetKey(
+        const std::string& target_frame,
+        const std::string& source_frame);
+
+    TransformHistoryPtr AddHistory(
+        const std::string& target_frame,
+        const std::string& source_frame);
+
+    void HandleTimer(const ros::TimerEvent& event);
+  };
+  typedef boost::shared_ptr<TransformBuffer> TransformBufferPtr;
+}
+
+#endif  // TRANSFORM_UTIL_TRANSFORM_BUFFER_H_
@@ -31,29 +31,77 @@
 #define TRANSFORM_UTIL_TRANSFORM_MANAGER_H_
 
 #include <map>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include <boost/function.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <pluginlib/class_loader.h>
+#include <ros/callback_queue.h>
+#include <ros/spinner.h>
 #include <tf/transform_datatypes.h>
 #include <tf/transform_listener.h>
 
 #include <transform_util/transform.h>
+#include <transform_util/transform_buffer.h>
 #include <transform_util/transformer.h>
 
 namespace transform_util
 {
+  /**
+   * Callback for asynchronous transform requests.
+   *
+   * The first argument is true if the transform was resolved before the
+   * request timed out, in which case the second argument holds the transform.
+   */
+  typedef boost::function<void (bool, const Transform&)> TransformCallback;
+
+  /**
+   * Looks up transforms between tf frames and the special frames provided by
+   * the transformer plugins (see frames.h).
+   *
+   * Plugins are registered from the frame pairs declared in their plugin
+   * description with <supports source="..." target="..."/> elements, and are
+   * only loaded by the first transform that needs them.  Plugins that don't
+   * declare any supported frame pairs are loaded at construction, and plugins
+   * for the local_xy, wgs84 and utm frames are loaded by Initialize() since
+   * they need to receive the local xy origin before their first transform.
+   * Loaded plugins are kept until the manager is destroyed.
+   */
   class TransformManager
   {
   public:
     TransformManager();
     ~TransformManager();
 
-    void Initialize(boost::shared_ptr<tf::TransformListener> tf
+    /**
+     * Initialize the manager and its transformer plugins with a tf source.
+     * This loads the plugins for the local_xy, wgs84 and utm frames.
+     *
+     * @param[in]  tf  The tf source.  Normally a tf::TransformListener, but a
+     *                 tf::Transformer filled in-process with setTransform()
+     *                 works as well and doesn't require a ROS master.
+     */
+    void Initialize(boost::shared_ptr<tf::Transformer> tf
         = boost::make_shared<tf::TransformListener>());
 
+    /**
+     * Set a transform buffer to consult before the tf listener.
+     *
+     * Rigid transforms between frame pairs covered by the buffer are
+     * interpolated from it instead of being looked up through tf, both here
+     * and in the transformer plugins.
+     *
+     * @param[in]  buffer  The transform buffer.
+     */
+    void SetTransformBuffer(TransformBufferPtr buffer);
+
     bool GetTransform(
         const std::string& target_frame,
         const std::string& source_frame,
@@ -69,6 +117,60 @@ namespace transform_util
         const std::string& target_frame,
         const std::string& source_frame) const;
 
+    /**
+     * Request a transform that may not be available yet.
+     *
+     * The callback is called once the transform can be resolved, or with a
+     * failure once the timeout expires.  Pending requests are batched per
+     * frame pair and checked together, so callers don't need to block in
+     * waitForTransform or poll.
+     *
+     * Requests are served by a thread with its own callback queue, started
+     * by the first request, and the callbacks are called from that thread.
+     * Callers may therefore wait on a request from a ROS callback even with
+     * a single-threaded spinner, but a request callback must not wait on
+     * another request.
+     *
+     * @param[in]  target_frame  The target frame.
+     * @param[in]  source_frame  The source frame.
+     * @param[in]  time          The time of the transform.
+     * @param[in]  callback      The callback to call with the result.
+     * @param[in]  timeout       How long to wait for the transform.
+     */
+    void RequestTransform(
+        const std::string& target_frame,
+        const std::string& source_frame,
+        const ros::Time& time,
+        const TransformCallback& callback,
+        const ros::Duration& timeout = ros::Duration(1.0));
+
+    /**
+     * Request a transform that may not be available yet.
+     *
+     * The returned future is fulfilled once the transform can be resolved.  If
+     * the timeout expires first, it holds a tf::LookupException instead.  See
+     * the callback version for the thread the requests are served from.
+     *
+     * @param[in]  target_frame  The target frame.
+     * @param[in]  source_frame  The source frame.
+     * @param[in]  time          The time of the transform.
+     * @param[in]  timeout       How long to wait for the transform.
+     *
+     * @returns A future for the transform.
+     */
+    boost::shared_future<Transform> RequestTransform(
+        const std::string& target_frame,
+        const std::string& source_frame,
+        const ros::Time& time,
+        const ros::Duration& timeout = ros::Duration(1.0));
+
+    /**
+     * @returns The number of lookups made to resolve transform requests.
+     *          Requests for the same frame pair and time that are resolved
+     *          together share one lookup.
+     */
+    uint64_t RequestLookupCount() const;
+
     bool GetTransform(
         const std::string& target_frame,
         const std::string& source_frame,
@@ -81,13 +183,82 @@ namespace transform_util
         tf::StampedTransform& transform) const;
 
   private:
-    pluginlib::ClassLoader<transform_util::Transformer> loader_;
-    boost::shared_ptr<tf::TransformListener> tf_listener_;
+    struct TransformRequest
+    {
+      ros::Time time;
+      ros::Time deadline;
+      TransformCallback callback;
+    };
+    typedef std::pair<std::string, std::string> FramePair;
+    typedef std::map<FramePair, std::vector<TransformRequest> > RequestMap;
+
+    typedef std::map<std::string, std::map<std::string, boost::shared_ptr<Transformer> > > TransformerMap;
+    typedef std::map<std::string, std::map<std::string, std::string> > PluginMap;
+
+    // NOTE: The plugin loader and maps are marked as mutable since plugins are
+    // loaded on demand from the const transform lookups.  Access to them is
+    // serialized by plugins_mutex_.
+    mutable pluginlib::ClassLoader<transform_util::Transformer> loader_;
+    boost::shared_ptr<tf::Transformer> tf_listener_;
+    TransformBufferPtr transform_buffer_;
+
+    // Plugin names by source and target frame.
+    mutable PluginMap plugin_names_;
+
+    // Loaded plugins by name, shared by all of the frame pairs they support.
+    mutable std::map<std::string, boost::shared_ptr<Transformer> > plugins_;
+    mutable std::set<std::string> failed_plugins_;
+
+    // Loaded plugins by source and target frame.
+    mutable TransformerMap transformers_;
+    mutable boost::mutex plugins_mutex_;
+
+    RequestMap requests_;
+    uint64_t request_lookups_;
+    mutable boost::mutex requests_mutex_;
+    ros::CallbackQueue requests_queue_;
+    boost::shared_ptr<ros::AsyncSpinner> requests_spinner_;
+    ros::Timer requests_timer_;
+
+    /**
+     * Check whether the tf data needed to resolve a transform is available,
+     * without blocking.
+     */
+    bool CanTransform(
+        const std::string& target_frame,
+        const std::string& source_frame,
+        const ros::Time& time) const;
+
+    /**
+     * Get a transform that CanTransform() has found to be available.  Unlike
+     * GetTransform(), tf frames are looked up without waiting.
+     */
+    bool ResolveTransform(
+        const std::string& target_frame,
+        const std::string& source_frame,
+        const ros::Time& time,
+        Transform& transform) const;
+
+    void ProcessRequests(const ros::TimerEvent& event);
+
+    /**
+     * Get the transformer for a source and target frame, loading its plugin
+     * if it hasn't been loaded yet.
+     */
+    boost::shared_ptr<Transformer> GetTransformer(
+        const std::string& source_frame,
+        const std::string& target_frame) const;
+
+    /**
+     * Load a plugin and route all of the frame pairs registered to it to the
+     * new instance.  Must be called with plugins_mutex_ locked.
+     */
+    boost::shared_ptr<Transformer> LoadPlugin(const std::string& class_name) const;
 
-    // NOTE: Transformers map is marked as mutable since it doesn't change after
-    // initialization, but its access functions are not technically const.  In
-    // this use case it can be considered const safely.
-    mutable std::map<std::string, std::map<std::string, boost::shared_ptr<Transformer> > > transformers_;
+    static void RegisterPlugin(
+        const std::string& class_name,
+        const std::map<std::string, std::vector<std::string> >& supports,
+        PluginMap& plugin_names);
   };
 }
 
@@ -30,6 +30,8 @@
 #ifndef TRANSFORM_UTIL_TRANSFORM_UTIL_H_
 #define TRANSFORM_UTIL_TRANSFORM_UTIL_H_
 
+#include <vector>
+
 #include <boost/array.hpp>
 
 #include <tf/transform_datatypes.h>
@@ -52,6 +54,74 @@ namespace transform_util
       double destination_latitude,
       double destination_longitude);
 
+  /**
+   * Calculates the great circle distance between two WGS84 points on a
+   * spherical earth.
+   *
+   * @param[in] source_latitude        The source latitude in degrees.
+   * @param[in] source_longitude       The source longitude in degrees.
+   * @param[in] destination_latitude   The destination latitude in degrees.
+   * @param[in] destination_longitude  The destination longitude in degrees.
+   *
+   * @returns The distance in meters.
+   */
+  double GetDistance(
+      double source_latitude,
+      double source_longitude,
+      double destination_latitude,
+      double destination_longitude);
+
+  /**
+   * Calculates the bearing and distance from one WGS84 point to many
+   * destinations.
+   *
+   * The trigonometry of the source point is evaluated once for the whole
+   * list.  The results match GetBearing() and GetDistance() unless a maximum
+   * error is specified, in which case destinations close enough to the source
+   * are evaluated with a flat-earth approximation whose position error (in
+   * range, and across track due to the bearing) is bounded by max_error.
+   *
+   * @param[in]  source_latitude         The source latitude in degrees.
+   * @param[in]  source_longitude        The source longitude in degrees.
+   * @param[in]  destination_latitudes   The destination latitudes in degrees.
+   * @param[in]  destination_longitudes  The destination longitudes in degrees.
+   * @param[out] bearings                The bearings in degrees.
+   * @param[out] distances               The distances in meters.
+   * @param[in]  max_error               The allowed error in meters of the
+   *                                     flat-earth approximation, or 0 to
+   *                                     always use the exact solution.
+   */
+  void GetBearingsAndDistances(
+      double source_latitude,
+      double source_longitude,
+      const std::vector<double>& destination_latitudes,
+      const std::vector<double>& destination_longitudes,
+      std::vector<double>& bearings,
+      std::vector<double>& distances,
+      double max_error = 0.0);
+
+  /**
+   * Calculates the bearing and distance between many pairs of WGS84 points.
+   *
+   * @param[in]  source_latitudes        The source latitudes in degrees.
+   * @param[in]  source_longitudes       The source longitudes in degrees.
+   * @param[in]  destination_latitudes   The destination latitudes in degrees.
+   * @param[in]  destination_longitudes  The destination longitudes in degrees.
+   * @param[out] bearings                The bearings in degrees.
+   * @param[out] distances               The distances in meters.
+   * @param[in]  max_error               The allowed error in meters of the
+   *                                     flat-earth approximation, or 0 to
+   *                                     always use the exact solution.
+   */
+  void GetBearingsAndDistances(
+      const std::vector<double>& source_latitudes,
+      const std::vector<double>& source_longitudes,
+      const std::vector<double>& destination_latitudes,
+      const std::vector<double>& destination_longitudes,
+      std::vector<double>& bearings,
+      std::vector<double>& distances,
+      double max_error = 0.0);
+
   /**
    * Calculates the heading in degrees from a source and destination point in
    * a north-oriented (+y = north, +x = east), ortho-rectified coordinate
@@ -174,6 +244,88 @@ namespace transform_util
   void SetLowerRight(
       const tf::Matrix3x3& sub_matrix,
       boost::array<double, 36>& matrix);
+
+  /**
+   * Rotates a 6x6 pose covariance matrix into another frame.
+   *
+   * Both the position and orientation blocks, as well as the cross terms, are
+   * rotated in a single pass with fixed-size arithmetic, equivalent to
+   * R6 * C * R6^T with R6 = diag(R, R).  The translation of the transform has
+   * no effect on the covariance.
+   *
+   * @param[in]  transform  The transform into the new frame.
+   * @param[in]  matrix_in  The input covariance.
+   * @param[out] matrix_out The rotated covariance.  May be the same as the
+   *                        input.
+   */
+  void RotateCovariance(
+      const tf::Transform& transform,
+      const boost::array<double, 36>& matrix_in,
+      boost::array<double, 36>& matrix_out);
+
+  /**
+   * Rotates a 3x3 covariance matrix, such as those of Imu messages, into
+   * another frame.
+   *
+   * @param[in]  transform  The transform into the new frame.
+   * @param[in]  matrix_in  The input covariance.
+   * @param[out] matrix_out The rotated covariance.  May be the same as the
+   *                        input.
+   */
+  void RotateCovariance(
+      const tf::Transform& transform,
+      const boost::array<double, 9>& matrix_in,
+      boost::array<double, 9>& matrix_out);
+
+  /**
+   * Rotates a list of 6x6 pose covariance matrices into another frame.
+   *
+   * The rotation is extracted from the transform once for the whole list.
+   *
+   * @param[in]  transform  The transform into the new frame.
+   * @param[in]  matrices_in  The input covariances.
+   * @param[in]  count        The number of covariances.
+   * @param[out] matrices_out The rotated covariances.  Must hold count
+   *                          matrices, and may be the same as the input.
+   */
+  void RotateCovariances(
+      const tf::Transform& transform,
+      const boost::array<double, 36>* matrices_in,
+      size_t count,
+      boost::array<double, 36>* matrices_out);
+
+  /**
+   * Rotates a list of 6x6 pose covariance matrices into another frame.
+   *
+   * @param[in]  transform     The transform into the new frame.
+   * @param[in]  matrices_in   The input covariances.
+   * @param[out] matrices_out  The rotated covariances.  May be the same as
+   *                           the input.
+   */
+  void RotateCovariances(
+      const tf::Transform& transform,
+      const std::vector<boost::array<double, 36> >& matrices_in,
+      std::vector<boost::array<double, 36> >& matrices_out);
+
+  /**
+   * Rotates the covariances of a list of messages in place.
+   *
+   * Works with any message type that has a 6x6 covariance field, such as
+   * geometry_msgs::PoseWithCovariance or geometry_msgs::TwistWithCovariance.
+   *
+   * @param[in]     transform  The transform into the new frame.
+   * @param[in,out] messages   The messages to update.
+   */
+  template <class T>
+  void RotateMessageCovariances(
+      const tf::Transform& transform,
+      std::vector<T>& messages)
+  {
+    for (size_t i = 0; i < messages.size(); i++)
+    {
+      RotateCovariance(transform, messages[i].covariance, messages[i].covariance);
+    }
+  }
 }
 
 #endif  // TRANSFORM_UTIL_TRANSFORM_UTIL_H_
@@ -40,6 +40,7 @@
 #include <tf/transform_listener.h>
 
 #include <transform_util/transform.h>
+#include <transform_util/transform_buffer.h>
 
 namespace transform_util
 {
@@ -49,7 +50,15 @@ namespace transform_util
       Transformer();
       virtual ~Transformer();
 
-      void Initialize(const boost::shared_ptr<tf::TransformListener> tf);
+      void Initialize(const boost::shared_ptr<tf::Transformer> tf);
+
+      /**
+       * Set a transform buffer to consult before falling back to the tf
+       * listener for rigid transforms.
+       *
+       * @param[in]  buffer  The transform buffer.
+       */
+      void SetTransformBuffer(TransformBufferPtr buffer);
 
       virtual std::map<std::string, std::vector<std::string> > Supports() const = 0;
 
@@ -61,7 +70,8 @@ namespace transform_util
 
     protected:
       bool initialized_;
-      boost::shared_ptr<tf::TransformListener> tf_listener_;
+      boost::shared_ptr<tf::Transformer> tf_listener_;
+      TransformBufferPtr transform_buffer_;
 
       virtual bool Initialize();
 
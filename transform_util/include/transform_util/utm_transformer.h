@@ -81,6 +81,9 @@ namespace transform_util
 
     virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
 
+    virtual bool GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const;
+
   protected:
     tf::StampedTransform transform_;
     boost::shared_ptr<UtmUtil> utm_util_;
@@ -99,6 +102,9 @@ namespace transform_util
 
     virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
 
+    virtual bool GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const;
+
   protected:
     tf::StampedTransform transform_;
     boost::shared_ptr<UtmUtil> utm_util_;
@@ -128,6 +134,10 @@ namespace transform_util
 
     virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
 
+    virtual void TransformPoints(
+      const std::vector<tf::Vector3>& v_in,
+      std::vector<tf::Vector3>& v_out) const;
+
   protected:
     boost::shared_ptr<UtmUtil> utm_util_;
   };
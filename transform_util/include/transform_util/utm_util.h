@@ -32,6 +32,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <boost/serialization/singleton.hpp>
 #include <boost/thread/mutex.hpp>
 
@@ -39,8 +41,34 @@
 
 namespace transform_util
 {
+  /**
+   * Get the standard UTM zone of a longitude.
+   *
+   * @param[in]  longitude  Longitude value in degrees.
+   *
+   * @returns The UTM zone, from 1 to 60.
+   */
   uint32_t GetZone(double longitude);
 
+  /**
+   * Get the UTM zone of a WGS84 coordinate, including the exceptions for
+   * southwest Norway (zone 32V) and Svalbard (zones 31X, 33X, 35X, and 37X).
+   *
+   * @param[in]  latitude   Latitude value in degrees.
+   * @param[in]  longitude  Longitude value in degrees.
+   *
+   * @returns The UTM zone, from 1 to 60.
+   */
+  uint32_t GetZone(double latitude, double longitude);
+
+  /**
+   * Get the UTM latitude band of a latitude.
+   *
+   * @param[in]  latitude   Latitude value in degrees.
+   *
+   * @returns The UTM band letter, or 'Z' if the latitude is outside the UTM
+   *          limits of 84N to 80S.
+   */
   char GetBand(double latitude);
 
   class UtmUtil
@@ -74,6 +102,28 @@ namespace transform_util
       double latitude, double longitude,
       double& easting, double& northing) const;
 
+    /**
+     * Convert a list of WGS84 latitudes and longitudes to UTM.
+     *
+     * Consecutive points that stay within the same zone and band are
+     * classified once and projected together, so long tracks are converted
+     * with few zone lookups and calls into PROJ.4.
+     *
+     * @param[in]  latitudes   Latitude values in degrees.
+     * @param[in]  longitudes  Longitude values in degrees.
+     * @param[out] zones       UTM zones.
+     * @param[out] bands       UTM bands.
+     * @param[out] eastings    UTM eastings in meters.
+     * @param[out] northings   UTM northings in meters.
+     */
+    void ToUtm(
+      const std::vector<double>& latitudes,
+      const std::vector<double>& longitudes,
+      std::vector<int>& zones,
+      std::vector<char>& bands,
+      std::vector<double>& eastings,
+      std::vector<double>& northings) const;
+
     /**
      * Convert UTM easting and northing to WGS84 latitude and longitude.
      *
@@ -110,6 +160,14 @@ namespace transform_util
           double latitude, double longitude,
           double& easting, double& northing) const;
 
+        void ToUtm(
+          const std::vector<double>& latitudes,
+          const std::vector<double>& longitudes,
+          std::vector<int>& zones,
+          std::vector<char>& bands,
+          std::vector<double>& eastings,
+          std::vector<double>& northings) const;
+
         void ToLatLon(
           int zone, char band, double easting, double northing,
           double& latitude, double& longitude) const;
@@ -64,6 +64,36 @@ namespace transform_util
       std::string local_xy_frame_;
   };
 
+  /**
+   * Converts from the LocalXY frame to WGS84 (lon, lat, altitude).
+   */
+  class LocalXyToWgs84Transform : public TransformImpl
+  {
+  public:
+    explicit LocalXyToWgs84Transform(
+      boost::shared_ptr<LocalXyWgs84Util> local_xy_util);
+
+    virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
+
+  protected:
+    boost::shared_ptr<LocalXyWgs84Util> local_xy_util_;
+  };
+
+  /**
+   * Converts from WGS84 (lon, lat, altitude) to the LocalXY frame.
+   */
+  class Wgs84ToLocalXyTransform : public TransformImpl
+  {
+  public:
+    explicit Wgs84ToLocalXyTransform(
+      boost::shared_ptr<LocalXyWgs84Util> local_xy_util);
+
+    virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
+
+  protected:
+    boost::shared_ptr<LocalXyWgs84Util> local_xy_util_;
+  };
+
   class TfToWgs84Transform : public TransformImpl
   {
   public:    
@@ -73,6 +103,9 @@ namespace transform_util
 
     virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
 
+    virtual bool GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const;
+
   protected:
     tf::StampedTransform transform_;
     boost::shared_ptr<LocalXyWgs84Util> local_xy_util_;
@@ -87,6 +120,9 @@ namespace transform_util
 
     virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const;
 
+    virtual bool GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const;
+
   protected:
     tf::StampedTransform transform_;
     boost::shared_ptr<LocalXyWgs84Util> local_xy_util_;
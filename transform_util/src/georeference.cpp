@@ -53,7 +53,9 @@ namespace transform_util
     pixels_(1, 1, CV_32SC2),
     coordinates_(1, 1, CV_64FC2),
     x_offset_(0),
-    y_offset_(0)
+    y_offset_(0),
+    pixel_to_coordinate_(1, 0, 0, 0, 1, 0),
+    coordinate_to_pixel_(1, 0, 0, 0, 1, 0)
   {
     // Initialize transform to identity
     transform_.at<double>(0, 0) = 1;
@@ -73,7 +75,14 @@ namespace transform_util
     tile_size_(geo.tile_size_),
     datum_(geo.datum_),
     projection_(geo.projection_),
-    transform_(geo.transform_)
+    transform_(geo.transform_),
+    inverse_transform_(geo.inverse_transform_),
+    pixels_(geo.pixels_),
+    coordinates_(geo.coordinates_),
+    x_offset_(geo.x_offset_),
+    y_offset_(geo.y_offset_),
+    pixel_to_coordinate_(geo.pixel_to_coordinate_),
+    coordinate_to_pixel_(geo.coordinate_to_pixel_)
   {
   }
 
@@ -140,16 +149,19 @@ namespace transform_util
       else if (doc["tiepoints"].size() == 1)
       {
         // Parse in the X scale
-        doc["pixel_scale"][0] >> transform_.at<float>(0, 0);
+        doc["pixel_scale"][0] >> transform_.at<double>(0, 0);
 
         // Parse in the Y scale
-        doc["pixel_scale"][1] >> transform_.at<float>(1, 1);
+        doc["pixel_scale"][1] >> transform_.at<double>(1, 1);
 
-        transform_.at<float>(0, 2) = coordinates_.at<cv::Vec2d>(0, 1)[0] -
-            pixels_.at<cv::Vec2s>(0, 1)[0] * transform_.at<double>(0, 0);
+        transform_.at<double>(0, 2) = coordinates_.at<cv::Vec2d>(0, 0)[0] -
+            pixels_.at<cv::Vec2s>(0, 0)[0] * transform_.at<double>(0, 0);
 
-        transform_.at<float>(1, 2) = coordinates_.at<cv::Vec2d>(0, 1)[1] -
-            pixels_.at<cv::Vec2s>(0, 1)[1] * transform_.at<double>(1, 1);
+        transform_.at<double>(1, 2) = coordinates_.at<cv::Vec2d>(0, 0)[1] -
+            pixels_.at<cv::Vec2s>(0, 0)[1] * transform_.at<double>(1, 1);
+
+        cv::invertAffineTransform(transform_, inverse_transform_);
+        UpdateCoefficients();
       }
       else
       {
@@ -198,38 +210,86 @@ namespace transform_util
 
     transform_ = cv::estimateRigidTransform(src, dst, true);
     inverse_transform_ = cv::estimateRigidTransform(dst, src, true);
+
+    UpdateCoefficients();
   }
 
-  void GeoReference::GetCoordinate(
-    int x_pixel, int y_pixel,
-    double& x_coordinate, double& y_coordinate) const
+  void GeoReference::UpdateCoefficients()
   {
-    cv::Mat src(1, 1, CV_32FC2);
-    cv::Mat dst(1, 1, CV_32FC2);
-
-    src.at<cv::Vec2f>(0, 0)[0] = x_pixel;
-    src.at<cv::Vec2f>(0, 0)[1] = y_pixel;
+    if (transform_.rows == 2 && transform_.cols == 3)
+    {
+      cv::Mat t;
+      transform_.convertTo(t, CV_64F);
 
-    cv::transform(src, dst, transform_);
+      pixel_to_coordinate_ = cv::Matx23d(
+          t.at<double>(0, 0), t.at<double>(0, 1), t.at<double>(0, 2) + x_offset_,
+          t.at<double>(1, 0), t.at<double>(1, 1), t.at<double>(1, 2) + y_offset_);
+    }
 
-    x_coordinate = dst.at<cv::Vec2f>(0, 0)[0] + x_offset_;
-    y_coordinate = dst.at<cv::Vec2f>(0, 0)[1] + y_offset_;
+    if (inverse_transform_.rows == 2 && inverse_transform_.cols == 3)
+    {
+      cv::Mat t;
+      inverse_transform_.convertTo(t, CV_64F);
+
+      // The inverse transform operates on offset coordinates.
+      coordinate_to_pixel_ = cv::Matx23d(
+          t.at<double>(0, 0), t.at<double>(0, 1),
+          t.at<double>(0, 2) - t.at<double>(0, 0) * x_offset_ - t.at<double>(0, 1) * y_offset_,
+          t.at<double>(1, 0), t.at<double>(1, 1),
+          t.at<double>(1, 2) - t.at<double>(1, 0) * x_offset_ - t.at<double>(1, 1) * y_offset_);
+    }
   }
 
-  void GeoReference::GetPixel(
-    double x_coordinate, double y_coordinate,
-    int& x_pixel, int& y_pixel) const
+  void GeoReference::GetCoordinates(
+    const cv::Point2d* pixels,
+    size_t count,
+    cv::Point2d* coordinates) const
   {
-    cv::Mat src(1, 1, CV_32FC2);
-    cv::Mat dst(1, 1, CV_32FC2);
+    const cv::Matx23d& t = pixel_to_coordinate_;
+    for (size_t i = 0; i < count; i++)
+    {
+      const double x = pixels[i].x;
+      const double y = pixels[i].y;
+      coordinates[i].x = t(0, 0) * x + t(0, 1) * y + t(0, 2);
+      coordinates[i].y = t(1, 0) * x + t(1, 1) * y + t(1, 2);
+    }
+  }
 
-    src.at<cv::Vec2f>(0, 0)[0] = x_coordinate - x_offset_;
-    src.at<cv::Vec2f>(0, 0)[1] = y_coordinate - y_offset_;
+  void GeoReference::GetCoordinates(
+    const std::vector<cv::Point2d>& pixels,
+    std::vector<cv::Point2d>& coordinates) const
+  {
+    coordinates.resize(pixels.size());
+    if (!pixels.empty())
+    {
+      GetCoordinates(&pixels[0], pixels.size(), &coordinates[0]);
+    }
+  }
 
-    cv::transform(src, dst, inverse_transform_);
+  void GeoReference::GetPixels(
+    const cv::Point2d* coordinates,
+    size_t count,
+    cv::Point* pixels) const
+  {
+    const cv::Matx23d& t = coordinate_to_pixel_;
+    for (size_t i = 0; i < count; i++)
+    {
+      const double x = coordinates[i].x;
+      const double y = coordinates[i].y;
+      pixels[i].x = static_cast<int>(t(0, 0) * x + t(0, 1) * y + t(0, 2));
+      pixels[i].y = static_cast<int>(t(1, 0) * x + t(1, 1) * y + t(1, 2));
+    }
+  }
 
-    x_pixel = static_cast<int>(dst.at<cv::Vec2f>(0, 0)[0]);
-    y_pixel = static_cast<int>(dst.at<cv::Vec2f>(0, 0)[1]);
+  void GeoReference::GetPixels(
+    const std::vector<cv::Point2d>& coordinates,
+    std::vector<cv::Point>& pixels) const
+  {
+    pixels.resize(coordinates.size());
+    if (!coordinates.empty())
+    {
+      GetPixels(&coordinates[0], coordinates.size(), &pixels[0]);
+    }
   }
 
   void GeoReference::Print()
@@ -27,13 +27,23 @@
 //
 // *****************************************************************************
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
 #include <boost/smart_ptr.hpp>
 
 #include <ros/ros.h>
+#include <tf/tfMessage.h>
 #include <tf/transform_listener.h>
 
 #include <math_util/constants.h>
 #include <transform_util/local_xy_util.h>
+#include <transform_util/transform_util.h>
 
 /**
  * @file
@@ -52,14 +62,49 @@
  * All outputs are in degrees, and heading follows the compass heading
  * convention (0° is North, clockwise angles are positive)
  *
+ * <b>Parameters</b>
+ * - \e ~rate [double] - Maximum output rate in Hz.  In polling mode this is
+ *        the polling rate.  In streaming mode a value of 0 outputs every tf
+ *        update.  Default: 1.0
+ * - \e ~stream [bool] - Output on each /tf update instead of polling with a
+ *        timer.  Default: false
+ * - \e ~format [string] - Output format: "text", "csv", or "binary".  The
+ *        binary format is a sequence of records of five little-endian
+ *        doubles: stamp (s), latitude, longitude, altitude (m), and heading.
+ *        Default: "text"
+ * - \e ~output [string] - Output file, or "-" for stdout.  Default: "-"
+ * - \e ~buffer_size [int] - Number of samples to collect before they are
+ *        converted and written.  Buffered samples are also written at least
+ *        once per second.  Default: 1
+ *
  * <b>Subscribed Topics</b>
- * - \e /tf [geometry_msgs::Transform] - The transform from fixed_frame_id to
+ * - \e /tf [tf::tfMessage] - The transform from fixed_frame_id to
  *        target_frame_id must be published
  * - \e /local_xy_origin [gsp_common::GPSFix] - This topic is used to initialize
  *        the WGS84 transformer. Once it is initialized, the subscriber
  *        disconnects.
  */
 
+/**
+ * Convert doubles in place from host byte order to little-endian.
+ */
+static void ToLittleEndian(double* values, size_t count)
+{
+  const uint16_t test = 1;
+  if (*reinterpret_cast<const uint8_t*>(&test) == 1)
+  {
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    uint8_t bytes[sizeof(double)];
+    std::memcpy(bytes, &values[i], sizeof(double));
+    std::reverse(bytes, bytes + sizeof(double));
+    std::memcpy(&values[i], bytes, sizeof(double));
+  }
+}
+
 class LatLonTFEchoNode
 {
   public:
@@ -68,26 +113,105 @@ class LatLonTFEchoNode
         std::string fixed_frame) :
         nh_(nh),
         frame_id_(frame_id),
-        fixed_frame_(fixed_frame)
+        fixed_frame_(fixed_frame),
+        output_(stdout)
     {
+      ros::NodeHandle priv("~");
+
+      double rate = 1.0;
+      bool stream = false;
+      std::string output = "-";
+      int buffer_size = 1;
+      priv.param("rate", rate, rate);
+      priv.param("stream", stream, stream);
+      priv.param("format", format_, std::string("text"));
+      priv.param("output", output, output);
+      priv.param("buffer_size", buffer_size, buffer_size);
+
+      if (format_ != "text" && format_ != "csv" && format_ != "binary")
+      {
+        ROS_WARN("Unknown output format '%s', using text.", format_.c_str());
+        format_ = "text";
+      }
+
+      if (output != "-")
+      {
+        output_ = fopen(output.c_str(), format_ == "binary" ? "wb" : "w");
+        if (!output_)
+        {
+          ROS_ERROR("Failed to open %s, writing to stdout.", output.c_str());
+          output_ = stdout;
+        }
+      }
+
+      buffer_size_ = std::max(1, buffer_size);
+      samples_.reserve(buffer_size_);
+      min_interval_ = ros::Duration(rate > 0 ? 1.0 / rate : 0.0);
+
+      if (format_ == "csv")
+      {
+        fprintf(output_, "stamp,latitude,longitude,altitude,heading\n");
+      }
+
       origin_sub_ = nh_.subscribe(
           "/local_xy_origin",
           1,
           &LatLonTFEchoNode::XYOriginCallback,
           this);
-      timer_ = nh_.createTimer(ros::Duration(1),
-          boost::bind(&LatLonTFEchoNode::TimerCallback, this));
+
+      if (stream)
+      {
+        tf_sub_ = nh_.subscribe(
+            "/tf",
+            100,
+            &LatLonTFEchoNode::TfCallback,
+            this);
+        flush_timer_ = nh_.createTimer(ros::Duration(1),
+            boost::bind(&LatLonTFEchoNode::Flush, this));
+      }
+      else
+      {
+        timer_ = nh_.createTimer(ros::Duration(rate > 0 ? 1.0 / rate : 1.0),
+            boost::bind(&LatLonTFEchoNode::TimerCallback, this));
+      }
+    }
+
+    ~LatLonTFEchoNode()
+    {
+      Flush();
+      if (output_ != stdout)
+      {
+        fclose(output_);
+      }
     }
 
   private:
+    struct Sample
+    {
+      ros::Time stamp;
+      double x;
+      double y;
+      double z;
+      double yaw;
+    };
+
     ros::NodeHandle nh_;
     tf::TransformListener tf_listener;
     ros::Timer timer_;
+    ros::Timer flush_timer_;
     boost::shared_ptr<transform_util::LocalXyWgs84Util> xy_wgs84_util_;
     ros::Subscriber origin_sub_;
+    ros::Subscriber tf_sub_;
     std::string frame_id_;
     std::string fixed_frame_;
 
+    std::string format_;
+    FILE* output_;
+    size_t buffer_size_;
+    ros::Duration min_interval_;
+    ros::Time last_stamp_;
+    std::vector<Sample> samples_;
+
     void XYOriginCallback(const gps_common::GPSFixConstPtr origin)
     {
       xy_wgs84_util_.reset(
@@ -103,16 +227,58 @@ class LatLonTFEchoNode
     {
       if (!xy_wgs84_util_ || !xy_wgs84_util_->Initialized())
       {
-        printf("Still waiting for /local_xy_origin\n");
+        if (format_ == "text")
+        {
+          printf("Still waiting for /local_xy_origin\n");
+        }
         return;
       }
-      if (!tf_listener.waitForTransform(fixed_frame_, frame_id_, ros::Time(0), ros::Duration(1.0)))
+
+      // Don't block the timer waiting for the transform; it will be checked
+      // again on the next cycle.
+      if (!tf_listener.canTransform(fixed_frame_, frame_id_, ros::Time(0)))
       {
-        printf("Still waiting for transform from %s to %s\n",
-            frame_id_.c_str(),
-            fixed_frame_.c_str());
+        if (format_ == "text")
+        {
+          printf("Still waiting for transform from %s to %s\n",
+              frame_id_.c_str(),
+              fixed_frame_.c_str());
+        }
         return;
       }
+
+      AddSample(false);
+    }
+
+    void TfCallback(const tf::tfMessageConstPtr& message)
+    {
+      if (!xy_wgs84_util_ || !xy_wgs84_util_->Initialized())
+      {
+        return;
+      }
+
+      // Skip updates that arrive faster than the requested rate.
+      ros::Time stamp;
+      for (size_t i = 0; i < message->transforms.size(); i++)
+      {
+        stamp = std::max(stamp, message->transforms[i].header.stamp);
+      }
+
+      if (!last_stamp_.isZero() && stamp < last_stamp_ + min_interval_)
+      {
+        return;
+      }
+
+      if (!tf_listener.canTransform(fixed_frame_, frame_id_, ros::Time(0)))
+      {
+        return;
+      }
+
+      AddSample(true);
+    }
+
+    void AddSample(bool skip_repeated)
+    {
       tf::StampedTransform transform;
       try
       {
@@ -123,18 +289,72 @@ class LatLonTFEchoNode
         ROS_ERROR("%s", ex.what());
         return;
       }
-      double lat, lon;
-      xy_wgs84_util_->ToWgs84(
-          transform.getOrigin().x(), transform.getOrigin().y(),
-          lat, lon);
-      tf::Quaternion q = transform.getRotation();
-      q.setY(0);
-      q.setX(0);
-      q.normalize();
-      double heading = -q.getAngle() * math_util::_rad_2_deg + 90;
-      while (heading < 0)
-        heading += 360;
-      printf("Latitude: %f°, Longitude: %f°, Heading: %f°\n", lat, lon, heading);
+
+      if (skip_repeated && !last_stamp_.isZero() && transform.stamp_ <= last_stamp_)
+      {
+        return;
+      }
+      last_stamp_ = transform.stamp_;
+
+      Sample sample;
+      sample.stamp = transform.stamp_;
+      sample.x = transform.getOrigin().x();
+      sample.y = transform.getOrigin().y();
+      sample.z = transform.getOrigin().z();
+      sample.yaw = tf::getYaw(transform.getRotation());
+      samples_.push_back(sample);
+
+      if (samples_.size() >= buffer_size_)
+      {
+        Flush();
+      }
+    }
+
+    /**
+     * Convert the buffered samples to WGS84 and write them out.
+     */
+    void Flush()
+    {
+      if (samples_.empty() || !xy_wgs84_util_)
+      {
+        return;
+      }
+
+      double reference_altitude = xy_wgs84_util_->ReferenceAltitude();
+
+      for (size_t i = 0; i < samples_.size(); i++)
+      {
+        const Sample& sample = samples_[i];
+
+        double record[5];
+        record[0] = sample.stamp.toSec();
+        xy_wgs84_util_->ToWgs84(sample.x, sample.y, record[1], record[2]);
+        record[3] = reference_altitude + sample.z;
+        record[4] = transform_util::ToHeading(sample.yaw);
+        while (record[4] < 0)
+          record[4] += 360;
+        while (record[4] >= 360)
+          record[4] -= 360;
+
+        if (format_ == "binary")
+        {
+          ToLittleEndian(record, 5);
+          fwrite(record, sizeof(double), 5, output_);
+        }
+        else if (format_ == "csv")
+        {
+          fprintf(output_, "%.6f,%.9f,%.9f,%.3f,%.3f\n",
+              record[0], record[1], record[2], record[3], record[4]);
+        }
+        else
+        {
+          fprintf(output_, "Latitude: %f°, Longitude: %f°, Heading: %f°\n",
+              record[1], record[2], record[4]);
+        }
+      }
+
+      samples_.clear();
+      fflush(output_);
     }
 };
 
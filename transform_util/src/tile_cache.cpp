@@ -0,0 +1,489 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <transform_util/tile_cache.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <ros/ros.h>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace transform_util
+{
+  static const uint32_t _tile_file_version = 1;
+
+  static std::string LevelPath(const std::string& pyramid_path, int32_t level)
+  {
+    boost::filesystem::path path(pyramid_path);
+    path /= "level_" + boost::lexical_cast<std::string>(level) + ".tiles";
+    return path.string();
+  }
+
+  TileCache::TileCache(
+      const GeoReference& georeference,
+      const std::string& pyramid_path,
+      size_t memory_budget) :
+    georeference_(georeference),
+    pyramid_path_(pyramid_path),
+    memory_budget_(memory_budget),
+    memory_usage_(0),
+    stop_(false)
+  {
+  }
+
+  TileCache::~TileCache()
+  {
+    Close();
+  }
+
+  bool TileCache::Open()
+  {
+    Close();
+
+    for (int32_t level = 0; ; level++)
+    {
+      std::string path = LevelPath(pyramid_path_, level);
+
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+      {
+        break;
+      }
+
+      struct stat info;
+      if (fstat(fd, &info) != 0 ||
+          static_cast<size_t>(info.st_size) < sizeof(TileFileHeader))
+      {
+        ROS_ERROR("[tile_cache]: Invalid tile file: %s", path.c_str());
+        close(fd);
+        break;
+      }
+
+      void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+
+      if (data == MAP_FAILED)
+      {
+        ROS_ERROR("[tile_cache]: Failed to map tile file: %s", path.c_str());
+        break;
+      }
+
+      Level mapped;
+      mapped.data = static_cast<const uint8_t*>(data);
+      mapped.size = info.st_size;
+      std::memcpy(&mapped.header, mapped.data, sizeof(TileFileHeader));
+
+      const TileFileHeader& header = mapped.header;
+      size_t tile_bytes = header.tile_size * header.tile_size * header.channels;
+      size_t expected_size = sizeof(TileFileHeader) +
+          static_cast<size_t>(header.tiles_x) * header.tiles_y * tile_bytes;
+
+      if (std::strncmp(header.magic, "TILE", 4) != 0 ||
+          header.version != _tile_file_version ||
+          header.channels < 1 || header.channels > 4 ||
+          mapped.size < expected_size)
+      {
+        ROS_ERROR("[tile_cache]: Invalid tile file: %s", path.c_str());
+        munmap(data, mapped.size);
+        break;
+      }
+
+      levels_.push_back(mapped);
+    }
+
+    if (levels_.empty())
+    {
+      ROS_ERROR("[tile_cache]: No pyramid levels found in %s", pyramid_path_.c_str());
+      return false;
+    }
+
+    stop_ = false;
+    prefetch_thread_ = boost::thread(boost::bind(&TileCache::PrefetchThread, this));
+
+    return true;
+  }
+
+  void TileCache::Close()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      stop_ = true;
+      prefetch_queue_.clear();
+    }
+    prefetch_condition_.notify_all();
+    if (prefetch_thread_.joinable())
+    {
+      prefetch_thread_.join();
+    }
+
+    for (size_t i = 0; i < levels_.size(); i++)
+    {
+      munmap(const_cast<uint8_t*>(levels_[i].data), levels_[i].size);
+    }
+    levels_.clear();
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    cache_.clear();
+    lru_.clear();
+    memory_usage_ = 0;
+  }
+
+  cv::Mat TileCache::GetTile(const TileKey& key)
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      std::map<TileKey, CacheEntry>::iterator iter = cache_.find(key);
+      if (iter != cache_.end())
+      {
+        // Mark the tile as most recently used.
+        lru_.splice(lru_.begin(), lru_, iter->second.lru);
+        return iter->second.tile;
+      }
+    }
+
+    // Read from the mapped file without holding the lock, since this may
+    // have to wait on the disk.
+    cv::Mat tile = LoadTile(key);
+    if (!tile.empty())
+    {
+      AddTile(key, tile);
+    }
+
+    return tile;
+  }
+
+  void TileCache::GetTileKeys(
+      double min_x, double min_y,
+      double max_x, double max_y,
+      int32_t level,
+      std::vector<TileKey>& keys) const
+  {
+    keys.clear();
+
+    if (level < 0 || level >= static_cast<int32_t>(levels_.size()))
+    {
+      return;
+    }
+
+    const TileFileHeader& header = levels_[level].header;
+
+    // The georeference may be rotated, so map all of the corners.
+    cv::Point2d corners[4] = {
+      cv::Point2d(min_x, min_y),
+      cv::Point2d(max_x, min_y),
+      cv::Point2d(max_x, max_y),
+      cv::Point2d(min_x, max_y)};
+    cv::Point pixels[4];
+    georeference_.GetPixels(corners, 4, pixels);
+
+    int32_t min_px = pixels[0].x;
+    int32_t max_px = pixels[0].x;
+    int32_t min_py = pixels[0].y;
+    int32_t max_py = pixels[0].y;
+    for (int32_t i = 1; i < 4; i++)
+    {
+      min_px = std::min(min_px, pixels[i].x);
+      max_px = std::max(max_px, pixels[i].x);
+      min_py = std::min(min_py, pixels[i].y);
+      max_py = std::max(max_py, pixels[i].y);
+    }
+
+    // Size of a tile in full resolution pixels.
+    double span = static_cast<double>(header.tile_size) * (1 << level);
+
+    int32_t min_tx = std::max(0, static_cast<int32_t>(std::floor(min_px / span)));
+    int32_t max_tx = std::min(
+        static_cast<int32_t>(header.tiles_x) - 1,
+        static_cast<int32_t>(std::floor(max_px / span)));
+    int32_t min_ty = std::max(0, static_cast<int32_t>(std::floor(min_py / span)));
+    int32_t max_ty = std::min(
+        static_cast<int32_t>(header.tiles_y) - 1,
+        static_cast<int32_t>(std::floor(max_py / span)));
+
+    for (int32_t y = min_ty; y <= max_ty; y++)
+    {
+      for (int32_t x = min_tx; x <= max_tx; x++)
+      {
+        keys.push_back(TileKey(level, x, y));
+      }
+    }
+  }
+
+  void TileCache::GetTiles(
+      double min_x, double min_y,
+      double max_x, double max_y,
+      int32_t level,
+      std::vector<TileKey>& keys,
+      std::vector<cv::Mat>& tiles)
+  {
+    GetTileKeys(min_x, min_y, max_x, max_y, level, keys);
+
+    tiles.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+      tiles[i] = GetTile(keys[i]);
+    }
+  }
+
+  void TileCache::Prefetch(
+      const std::vector<cv::Point2d>& path,
+      double radius,
+      int32_t level)
+  {
+    std::deque<TileKey> queue;
+    std::set<TileKey> queued;
+
+    std::vector<TileKey> keys;
+    for (size_t i = 0; i < path.size(); i++)
+    {
+      GetTileKeys(
+          path[i].x - radius, path[i].y - radius,
+          path[i].x + radius, path[i].y + radius,
+          level,
+          keys);
+
+      for (size_t j = 0; j < keys.size(); j++)
+      {
+        if (queued.insert(keys[j]).second)
+        {
+          queue.push_back(keys[j]);
+        }
+      }
+    }
+
+    // A new path replaces whatever was left of the previous one.
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      prefetch_queue_.swap(queue);
+    }
+    prefetch_condition_.notify_one();
+  }
+
+  size_t TileCache::MemoryUsage() const
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return memory_usage_;
+  }
+
+  cv::Mat TileCache::LoadTile(const TileKey& key) const
+  {
+    if (key.level < 0 || key.level >= static_cast<int32_t>(levels_.size()))
+    {
+      return cv::Mat();
+    }
+
+    const Level& level = levels_[key.level];
+    const TileFileHeader& header = level.header;
+
+    if (key.x < 0 || key.x >= static_cast<int32_t>(header.tiles_x) ||
+        key.y < 0 || key.y >= static_cast<int32_t>(header.tiles_y))
+    {
+      return cv::Mat();
+    }
+
+    size_t tile_bytes = header.tile_size * header.tile_size * header.channels;
+    size_t offset = sizeof(TileFileHeader) +
+        (static_cast<size_t>(key.y) * header.tiles_x + key.x) * tile_bytes;
+
+    cv::Mat mapped(
+        header.tile_size,
+        header.tile_size,
+        CV_8UC(header.channels),
+        const_cast<uint8_t*>(level.data + offset));
+
+    // Copy the tile so that it stays valid after the file is unmapped and so
+    // that the cache budget reflects memory actually in use.
+    return mapped.clone();
+  }
+
+  void TileCache::AddTile(const TileKey& key, const cv::Mat& tile)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+
+    if (cache_.count(key) > 0)
+    {
+      return;
+    }
+
+    lru_.push_front(key);
+
+    CacheEntry& entry = cache_[key];
+    entry.tile = tile;
+    entry.lru = lru_.begin();
+
+    memory_usage_ += tile.total() * tile.elemSize();
+
+    // Evict the least recently used tiles, but always keep the new one.
+    while (memory_usage_ > memory_budget_ && lru_.size() > 1)
+    {
+      std::map<TileKey, CacheEntry>::iterator iter = cache_.find(lru_.back());
+      memory_usage_ -= iter->second.tile.total() * iter->second.tile.elemSize();
+      cache_.erase(iter);
+      lru_.pop_back();
+    }
+  }
+
+  void TileCache::PrefetchThread()
+  {
+    while (true)
+    {
+      TileKey key;
+      {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (!stop_ && prefetch_queue_.empty())
+        {
+          prefetch_condition_.wait(lock);
+        }
+
+        if (stop_)
+        {
+          return;
+        }
+
+        key = prefetch_queue_.front();
+        prefetch_queue_.pop_front();
+
+        if (cache_.count(key) > 0)
+        {
+          continue;
+        }
+      }
+
+      cv::Mat tile = LoadTile(key);
+      if (!tile.empty())
+      {
+        AddTile(key, tile);
+      }
+    }
+  }
+
+  bool TileCache::WritePyramid(
+      const cv::Mat& image,
+      int32_t tile_size,
+      int32_t levels,
+      const std::string& pyramid_path)
+  {
+    if (image.empty() || image.depth() != CV_8U || tile_size <= 0)
+    {
+      ROS_ERROR("[tile_cache]: Pyramid requires a non-empty 8-bit image.");
+      return false;
+    }
+
+    try
+    {
+      boost::filesystem::create_directories(pyramid_path);
+    }
+    catch (const std::exception& e)
+    {
+      ROS_ERROR("[tile_cache]: %s", e.what());
+      return false;
+    }
+
+    cv::Mat level_image = image;
+    for (int32_t level = 0; level < levels; level++)
+    {
+      if (level > 0)
+      {
+        cv::Mat reduced;
+        cv::resize(
+            level_image,
+            reduced,
+            cv::Size((level_image.cols + 1) / 2, (level_image.rows + 1) / 2),
+            0,
+            0,
+            cv::INTER_AREA);
+        level_image = reduced;
+      }
+
+      TileFileHeader header;
+      std::memcpy(header.magic, "TILE", 4);
+      header.version = _tile_file_version;
+      header.tile_size = tile_size;
+      header.channels = level_image.channels();
+      header.width = level_image.cols;
+      header.height = level_image.rows;
+      header.tiles_x = (level_image.cols + tile_size - 1) / tile_size;
+      header.tiles_y = (level_image.rows + tile_size - 1) / tile_size;
+
+      std::string path = LevelPath(pyramid_path, level);
+      std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+      if (!file)
+      {
+        ROS_ERROR("[tile_cache]: Failed to open %s", path.c_str());
+        return false;
+      }
+
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+      cv::Mat tile(tile_size, tile_size, level_image.type());
+      for (uint32_t y = 0; y < header.tiles_y; y++)
+      {
+        for (uint32_t x = 0; x < header.tiles_x; x++)
+        {
+          cv::Rect roi(x * tile_size, y * tile_size, tile_size, tile_size);
+          roi &= cv::Rect(0, 0, level_image.cols, level_image.rows);
+
+          tile.setTo(cv::Scalar::all(0));
+          level_image(roi).copyTo(tile(cv::Rect(0, 0, roi.width, roi.height)));
+
+          file.write(
+              reinterpret_cast<const char*>(tile.data),
+              tile.total() * tile.elemSize());
+        }
+      }
+
+      if (!file)
+      {
+        ROS_ERROR("[tile_cache]: Failed to write %s", path.c_str());
+        return false;
+      }
+
+      if (level_image.cols <= tile_size && level_image.rows <= tile_size)
+      {
+        break;
+      }
+    }
+
+    return true;
+  }
+}
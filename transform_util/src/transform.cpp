@@ -29,10 +29,54 @@
 
 #include <transform_util/transform.h>
 
+#include <cmath>
+
 #include <boost/make_shared.hpp>
 
+#include <transform_util/transform_util.h>
+
 namespace transform_util
 {
+  /**
+   * Append the primitive stages of a transform to a list of stages.
+   */
+  static void AppendStages(
+      const boost::shared_ptr<TransformImpl>& transform,
+      std::vector<boost::shared_ptr<TransformImpl> >& stages)
+  {
+    if (!transform->GetStages(stages))
+    {
+      stages.push_back(transform);
+    }
+  }
+
+  void TransformImpl::TransformPoints(
+      const std::vector<tf::Vector3>& v_in,
+      std::vector<tf::Vector3>& v_out) const
+  {
+    v_out.resize(v_in.size());
+
+    tf::Vector3 transformed;
+    for (size_t i = 0; i < v_in.size(); i++)
+    {
+      Transform(v_in[i], transformed);
+      v_out[i] = transformed;
+    }
+  }
+
+  bool TransformImpl::GetAffine(
+      tf::Matrix3x3& basis,
+      tf::Vector3& origin) const
+  {
+    return false;
+  }
+
+  bool TransformImpl::GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const
+  {
+    return false;
+  }
+
   Transform::Transform() :
     transform_(boost::make_shared<IdentityTransform>())
   {
@@ -85,6 +129,110 @@ namespace transform_util
     return transformed;
   }
 
+  Transform Transform::operator*(const Transform& transform) const
+  {
+    std::vector<boost::shared_ptr<TransformImpl> > stages;
+    AppendStages(transform.transform_, stages);
+    AppendStages(transform_, stages);
+
+    boost::shared_ptr<CompositeTransform> composite =
+        boost::make_shared<CompositeTransform>(stages);
+    composite->stamp_ = transform_->stamp_;
+
+    if (composite->NumStages() == 1)
+    {
+      // Everything was fused into a single stage, so skip the indirection.
+      std::vector<boost::shared_ptr<TransformImpl> > fused;
+      composite->GetStages(fused);
+      return Transform(fused.front());
+    }
+
+    return Transform(composite);
+  }
+
+  void Transform::TransformPoints(
+      const std::vector<tf::Vector3>& v_in,
+      std::vector<tf::Vector3>& v_out) const
+  {
+    transform_->TransformPoints(v_in, v_out);
+  }
+
+  bool Transform::Linearize(
+      const tf::Vector3& min,
+      const tf::Vector3& max,
+      double max_error,
+      Transform& linearized) const
+  {
+    tf::Vector3 center = (min + max) * 0.5;
+    tf::Vector3 extent = max - min;
+
+    // Estimate the Jacobian of the transform at the center of the region using
+    // central differences over the half-extent of the region.  Dimensions with
+    // no extent use a unit step.
+    tf::Matrix3x3 basis;
+    for (int32_t i = 0; i < 3; i++)
+    {
+      double step = std::fabs(extent[i]) * 0.5;
+      if (step <= 0)
+      {
+        step = 1.0;
+      }
+
+      tf::Vector3 offset(0, 0, 0);
+      offset[i] = step;
+
+      tf::Vector3 derivative =
+        ((*this)(center + offset) - (*this)(center - offset)) / (2.0 * step);
+
+      basis[0][i] = derivative.x();
+      basis[1][i] = derivative.y();
+      basis[2][i] = derivative.z();
+    }
+
+    tf::Vector3 origin = (*this)(center) - basis * center;
+
+    // Verify the approximation on a grid of samples covering the region.
+    const int32_t samples = 5;
+    int32_t samples_x = extent.x() != 0 ? samples : 1;
+    int32_t samples_y = extent.y() != 0 ? samples : 1;
+    int32_t samples_z = extent.z() != 0 ? samples : 1;
+    double max_error2 = max_error * max_error;
+    for (int32_t i = 0; i < samples_x; i++)
+    {
+      for (int32_t j = 0; j < samples_y; j++)
+      {
+        for (int32_t k = 0; k < samples_z; k++)
+        {
+          tf::Vector3 point(
+            samples_x > 1 ? min.x() + extent.x() * i / (samples_x - 1) : min.x(),
+            samples_y > 1 ? min.y() + extent.y() * j / (samples_y - 1) : min.y(),
+            samples_z > 1 ? min.z() + extent.z() * k / (samples_z - 1) : min.z());
+
+          tf::Vector3 exact = (*this)(point);
+          tf::Vector3 approximate = basis * point + origin;
+          if (exact.distance2(approximate) > max_error2)
+          {
+            return false;
+          }
+        }
+      }
+    }
+
+    boost::shared_ptr<TransformImpl> affine;
+    if (IsRotation(basis))
+    {
+      affine = boost::make_shared<TfTransform>(tf::Transform(basis, origin));
+    }
+    else
+    {
+      affine = boost::make_shared<AffineTransform>(basis, origin);
+    }
+    affine->stamp_ = transform_->stamp_;
+    linearized = affine;
+
+    return true;
+  }
+
   tf::Vector3 Transform::GetOrigin() const
   {
     tf::Vector3 origin;
@@ -117,6 +265,15 @@ namespace transform_util
   {
     v_out = v_in;
   }
+
+  bool IdentityTransform::GetAffine(
+      tf::Matrix3x3& basis,
+      tf::Vector3& origin) const
+  {
+    basis.setIdentity();
+    origin.setValue(0, 0, 0);
+    return true;
+  }
   
   TfTransform::TfTransform(const tf::Transform& transform) :
     transform_(transform)
@@ -134,4 +291,140 @@ namespace transform_util
   {
     v_out = transform_ * v_in;
   }
+
+  bool TfTransform::GetAffine(
+      tf::Matrix3x3& basis,
+      tf::Vector3& origin) const
+  {
+    basis = transform_.getBasis();
+    origin = transform_.getOrigin();
+    return true;
+  }
+
+  AffineTransform::AffineTransform(
+      const tf::Matrix3x3& basis,
+      const tf::Vector3& origin) :
+    basis_(basis),
+    origin_(origin)
+  {
+    stamp_ = ros::Time::now();
+  }
+
+  void AffineTransform::Transform(
+      const tf::Vector3& v_in,
+      tf::Vector3& v_out) const
+  {
+    v_out = basis_ * v_in + origin_;
+  }
+
+  bool AffineTransform::GetAffine(
+      tf::Matrix3x3& basis,
+      tf::Vector3& origin) const
+  {
+    basis = basis_;
+    origin = origin_;
+    return true;
+  }
+
+  CompositeTransform::CompositeTransform(
+      const std::vector<boost::shared_ptr<TransformImpl> >& stages)
+  {
+    stamp_ = ros::Time::now();
+
+    // Fuse runs of adjacent affine stages into a single matrix and offset.
+    bool has_affine = false;
+    tf::Matrix3x3 basis;
+    tf::Vector3 origin;
+    for (size_t i = 0; i <= stages.size(); i++)
+    {
+      tf::Matrix3x3 stage_basis;
+      tf::Vector3 stage_origin;
+      if (i < stages.size() && stages[i]->GetAffine(stage_basis, stage_origin))
+      {
+        if (has_affine)
+        {
+          // The stage is applied after the accumulated transform.
+          origin = stage_basis * origin + stage_origin;
+          basis = stage_basis * basis;
+        }
+        else
+        {
+          basis = stage_basis;
+          origin = stage_origin;
+          has_affine = true;
+        }
+
+        continue;
+      }
+
+      if (has_affine)
+      {
+        // Identity stages are dropped entirely.
+        bool is_identity = basis == tf::Matrix3x3::getIdentity() &&
+            origin == tf::Vector3(0, 0, 0);
+
+        if (!is_identity && IsRotation(basis))
+        {
+          stages_.push_back(
+            boost::make_shared<TfTransform>(tf::Transform(basis, origin)));
+        }
+        else if (!is_identity)
+        {
+          stages_.push_back(boost::make_shared<AffineTransform>(basis, origin));
+        }
+        has_affine = false;
+      }
+
+      if (i < stages.size())
+      {
+        stages_.push_back(stages[i]);
+      }
+    }
+
+    if (stages_.empty())
+    {
+      stages_.push_back(boost::make_shared<IdentityTransform>());
+    }
+  }
+
+  void CompositeTransform::Transform(
+      const tf::Vector3& v_in,
+      tf::Vector3& v_out) const
+  {
+    tf::Vector3 transformed = v_in;
+    for (size_t i = 0; i < stages_.size(); i++)
+    {
+      stages_[i]->Transform(transformed, v_out);
+      transformed = v_out;
+    }
+  }
+
+  void CompositeTransform::TransformPoints(
+      const std::vector<tf::Vector3>& v_in,
+      std::vector<tf::Vector3>& v_out) const
+  {
+    if (&v_in != &v_out)
+    {
+      v_out = v_in;
+    }
+
+    for (size_t i = 0; i < stages_.size(); i++)
+    {
+      stages_[i]->TransformPoints(v_out, v_out);
+    }
+  }
+
+  bool CompositeTransform::GetAffine(
+      tf::Matrix3x3& basis,
+      tf::Vector3& origin) const
+  {
+    return stages_.size() == 1 && stages_.front()->GetAffine(basis, origin);
+  }
+
+  bool CompositeTransform::GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const
+  {
+    stages.insert(stages.end(), stages_.begin(), stages_.end());
+    return true;
+  }
 }
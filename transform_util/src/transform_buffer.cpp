@@ -0,0 +1,459 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <transform_util/transform_buffer.h>
+
+#include <algorithm>
+
+#include <boost/make_shared.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace transform_util
+{
+  TransformHistory::TransformHistory(
+      const std::string& target_frame,
+      const std::string& source_frame,
+      const ros::Duration& cache_time,
+      size_t max_samples) :
+    target_frame_(target_frame),
+    source_frame_(source_frame),
+    cache_time_(cache_time),
+    max_samples_(std::max(max_samples, static_cast<size_t>(1))),
+    samples_(max_samples_),
+    start_(0),
+    count_(0),
+    sequence_(0)
+  {
+  }
+
+  uint32_t TransformHistory::BeginRead() const
+  {
+    uint32_t sequence = sequence_;
+    while (sequence & 1)
+    {
+      boost::this_thread::yield();
+      sequence = sequence_;
+    }
+
+    __sync_synchronize();
+    return sequence;
+  }
+
+  bool TransformHistory::EndRead(uint32_t sequence) const
+  {
+    __sync_synchronize();
+    return sequence_ == sequence;
+  }
+
+  void TransformHistory::BeginWrite()
+  {
+    sequence_ = sequence_ + 1;
+    __sync_synchronize();
+  }
+
+  void TransformHistory::EndWrite()
+  {
+    __sync_synchronize();
+    sequence_ = sequence_ + 1;
+  }
+
+  size_t TransformHistory::LowerBound(const ros::Time& stamp, size_t count) const
+  {
+    size_t first = 0;
+    while (count > 0)
+    {
+      size_t step = count / 2;
+      if (At(first + step).stamp < stamp)
+      {
+        first += step + 1;
+        count -= step + 1;
+      }
+      else
+      {
+        count = step;
+      }
+    }
+
+    return first;
+  }
+
+  void TransformHistory::Insert(
+      const tf::Transform& transform,
+      const ros::Time& stamp)
+  {
+    Sample sample;
+    sample.stamp = stamp;
+    sample.origin = transform.getOrigin();
+    sample.rotation = transform.getRotation();
+
+    boost::unique_lock<boost::mutex> lock(write_mutex_);
+
+    size_t index = LowerBound(stamp, count_);
+    if (index < count_ && At(index).stamp == stamp)
+    {
+      BeginWrite();
+      At(index) = sample;
+      EndWrite();
+      return;
+    }
+
+    if (count_ == max_samples_ && index == 0)
+    {
+      // Older than everything in a full history.
+      return;
+    }
+
+    BeginWrite();
+
+    if (count_ == max_samples_)
+    {
+      // Drop the oldest sample to make room.
+      start_ = (start_ + 1) % max_samples_;
+      count_--;
+      index--;
+    }
+
+    // Shift the newer samples up, which is nothing for in-order samples.
+    for (size_t i = count_; i > index; i--)
+    {
+      At(i) = At(i - 1);
+    }
+    At(index) = sample;
+    count_++;
+
+    // Drop samples that are too old.
+    const ros::Time& newest = At(count_ - 1).stamp;
+    if (newest.toSec() > cache_time_.toSec())
+    {
+      size_t expired = LowerBound(newest - cache_time_, count_);
+      start_ = (start_ + expired) % max_samples_;
+      count_ -= expired;
+    }
+
+    EndWrite();
+  }
+
+  bool TransformHistory::Lookup(
+      const ros::Time& time,
+      tf::StampedTransform& transform) const
+  {
+    Sample lower;
+    Sample upper;
+    bool covered;
+    uint32_t sequence;
+    do
+    {
+      sequence = BeginRead();
+
+      // The indices are only used modulo the buffer size, so a torn read
+      // can't go out of bounds; it's discarded by EndRead().
+      covered = false;
+      size_t count = std::min(count_, max_samples_);
+      if (count > 0)
+      {
+        upper = At(count - 1);
+        lower = upper;
+        if (time.isZero())
+        {
+          covered = true;
+        }
+        else
+        {
+          lower = At(0);
+          if (time >= lower.stamp && time <= upper.stamp)
+          {
+            covered = true;
+            size_t index = std::min(LowerBound(time, count), count - 1);
+            upper = At(index);
+            lower = At(index > 0 ? index - 1 : 0);
+          }
+        }
+      }
+    }
+    while (!EndRead(sequence));
+
+    if (!covered)
+    {
+      return false;
+    }
+
+    ros::Time stamp;
+    tf::Vector3 origin;
+    tf::Quaternion rotation;
+    if (time.isZero())
+    {
+      stamp = upper.stamp;
+      origin = upper.origin;
+      rotation = upper.rotation;
+    }
+    else if (upper.stamp == time || upper.stamp == lower.stamp)
+    {
+      stamp = time;
+      origin = upper.origin;
+      rotation = upper.rotation;
+    }
+    else
+    {
+      stamp = time;
+      double ratio = (time - lower.stamp).toSec() /
+          (upper.stamp - lower.stamp).toSec();
+
+      origin = lower.origin.lerp(upper.origin, ratio);
+      rotation = lower.rotation.slerp(upper.rotation, ratio);
+    }
+
+    transform = tf::StampedTransform(
+        tf::Transform(rotation, origin),
+        stamp,
+        target_frame_,
+        source_frame_);
+
+    return true;
+  }
+
+  ros::Time TransformHistory::Newest() const
+  {
+    ros::Time newest;
+    uint32_t sequence;
+    do
+    {
+      sequence = BeginRead();
+      size_t count = std::min(count_, max_samples_);
+      newest = count > 0 ? At(count - 1).stamp : ros::Time(0);
+    }
+    while (!EndRead(sequence));
+
+    return newest;
+  }
+
+  ros::Time TransformHistory::Oldest() const
+  {
+    ros::Time oldest;
+    uint32_t sequence;
+    do
+    {
+      sequence = BeginRead();
+      oldest = count_ > 0 ? At(0).stamp : ros::Time(0);
+    }
+    while (!EndRead(sequence));
+
+    return oldest;
+  }
+
+  size_t TransformHistory::Size() const
+  {
+    size_t count;
+    uint32_t sequence;
+    do
+    {
+      sequence = BeginRead();
+      count = count_;
+    }
+    while (!EndRead(sequence));
+
+    return count;
+  }
+
+  TransformBuffer::TransformBuffer(
+      const ros::Duration& cache_time,
+      size_t max_samples) :
+    cache_time_(cache_time),
+    max_samples_(max_samples),
+    histories_(boost::make_shared<HistoryMap>())
+  {
+  }
+
+  void TransformBuffer::Insert(const tf::StampedTransform& transform)
+  {
+    TransformHistoryPtr history =
+        GetHistory(transform.frame_id_, transform.child_frame_id_);
+
+    if (!history)
+    {
+      history = AddHistory(transform.frame_id_, transform.child_frame_id_);
+    }
+
+    history->Insert(transform, transform.stamp_);
+  }
+
+  void TransformBuffer::Track(
+      const std::string& target_frame,
+      const std::string& source_frame)
+  {
+    if (!GetHistory(target_frame, source_frame))
+    {
+      AddHistory(target_frame, source_frame);
+    }
+  }
+
+  void TransformBuffer::Update(const tf::Transformer& tf_listener)
+  {
+    boost::shared_ptr<const HistoryMap> histories =
+        boost::atomic_load(&histories_);
+
+    HistoryMap::const_iterator iter;
+    for (iter = histories->begin(); iter != histories->end(); ++iter)
+    {
+      const TransformHistoryPtr& history = iter->second;
+
+      // Static transforms have no latest time and are left to tf.
+      ros::Time latest;
+      std::string error;
+      if (tf_listener.getLatestCommonTime(
+            history->SourceFrame(),
+            history->TargetFrame(),
+            latest,
+            &error) != tf::NO_ERROR || latest.isZero())
+      {
+        continue;
+      }
+
+      if (latest <= history->Newest())
+      {
+        continue;
+      }
+
+      try
+      {
+        tf::StampedTransform transform;
+        tf_listener.lookupTransform(
+            history->TargetFrame(),
+            history->SourceFrame(),
+            latest,
+            transform);
+
+        history->Insert(transform, latest);
+      }
+      catch (const tf::TransformException& e)
+      {
+        ROS_DEBUG("[transform_buffer]: %s", e.what());
+      }
+    }
+  }
+
+  void TransformBuffer::Listen(
+      boost::shared_ptr<tf::Transformer> tf_listener,
+      double rate)
+  {
+    tf_listener_ = tf_listener;
+
+    ros::NodeHandle node;
+    timer_ = node.createTimer(
+        ros::Duration(1.0 / rate),
+        &TransformBuffer::HandleTimer,
+        this);
+  }
+
+  void TransformBuffer::HandleTimer(const ros::TimerEvent& event)
+  {
+    if (tf_listener_)
+    {
+      Update(*tf_listener_);
+    }
+  }
+
+  bool TransformBuffer::Lookup(
+      const std::string& target_frame,
+      const std::string& source_frame,
+      const ros::Time& time,
+      tf::StampedTransform& transform) const
+  {
+    TransformHistoryPtr history = GetHistory(target_frame, source_frame);
+    if (!history)
+    {
+      return false;
+    }
+
+    return history->Lookup(time, transform);
+  }
+
+  TransformHistoryPtr TransformBuffer::GetHistory(
+      const std::string& target_frame,
+      const std::string& source_frame) const
+  {
+    boost::shared_ptr<const HistoryMap> histories =
+        boost::atomic_load(&histories_);
+
+    HistoryMap::const_iterator iter =
+        histories->find(GetKey(target_frame, source_frame));
+    if (iter == histories->end())
+    {
+      return TransformHistoryPtr();
+    }
+
+    return iter->second;
+  }
+
+  TransformBuffer::FramePair TransformBuffer::GetKey(
+      const std::string& target_frame,
+      const std::string& source_frame)
+  {
+    // Ignore the leading slash like tf does.
+    std::string target = target_frame;
+    if (!target.empty() && target[0] == '/')
+    {
+      target = target.substr(1);
+    }
+
+    std::string source = source_frame;
+    if (!source.empty() && source[0] == '/')
+    {
+      source = source.substr(1);
+    }
+
+    return FramePair(target, source);
+  }
+
+  TransformHistoryPtr TransformBuffer::AddHistory(
+      const std::string& target_frame,
+      const std::string& source_frame)
+  {
+    FramePair key = GetKey(target_frame, source_frame);
+
+    boost::unique_lock<boost::mutex> lock(write_mutex_);
+
+    boost::shared_ptr<HistoryMap> histories =
+        boost::make_shared<HistoryMap>(*boost::atomic_load(&histories_));
+
+    // Another writer may have added the pair while waiting for the lock.
+    HistoryMap::iterator iter = histories->find(key);
+    if (iter != histories->end())
+    {
+      return iter->second;
+    }
+
+    TransformHistoryPtr history = boost::make_shared<TransformHistory>(
+        target_frame, source_frame, cache_time_, max_samples_);
+    (*histories)[key] = history;
+
+    boost::atomic_store(&histories_, boost::shared_ptr<const HistoryMap>(histories));
+
+    return history;
+  }
+}
@@ -31,65 +31,326 @@
 
 #include <vector>
 
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+
+#include <ros/package.h>
+#include <tinyxml.h>
+
 #include <transform_util/frames.h>
 
 namespace transform_util
 {
-  TransformManager::TransformManager() :
-      loader_("transform_util", "transform_util::Transformer")
+  /**
+   * Rate at which pending transform requests are checked, in Hz.
+   */
+  static const double _request_rate = 100.0;
+
+  static bool IsSpecialFrame(const std::string& frame)
   {
-    std::vector<std::string> class_names = loader_.getDeclaredClasses();
+    return frame == _wgs84_frame || frame == _utm_frame || frame == _local_xy_frame;
+  }
 
-    for (uint32_t i = 0; i < class_names.size(); i++)
+  static void FulfillPromise(
+      boost::shared_ptr<boost::promise<Transform> > promise,
+      bool success,
+      const Transform& transform)
+  {
+    if (success)
+    {
+      promise->set_value(transform);
+    }
+    else
     {
-      try
+      promise->set_exception(boost::copy_exception(
+          tf::LookupException("Timed out waiting for transform")));
+    }
+  }
+
+  /**
+   * Read the frame pairs that each transformer plugin declares in its plugin
+   * description, e.g.:
+   *
+   *   <class name="transformers/utm" ...>
+   *     <supports source="/wgs84" target="/utm"/>
+   *   </class>
+   *
+   * @param[out] supports  The declared supports by plugin name, in the same
+   *                       form as Transformer::Supports().
+   */
+  static void ReadDeclaredSupports(
+      std::map<std::string, std::map<std::string, std::vector<std::string> > >& supports)
+  {
+    std::vector<std::string> paths;
+    ros::package::getPlugins("transform_util", "plugin", paths);
+
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+      TiXmlDocument document;
+      if (!document.LoadFile(paths[i]))
       {
-        boost::shared_ptr<Transformer> transformer = loader_.createInstance(class_names[i]);
+        ROS_WARN("[transform_manager]: Failed to read plugin description %s",
+            paths[i].c_str());
+        continue;
+      }
 
-        std::map<std::string, std::vector<std::string> > supports = transformer->Supports();
+      TiXmlElement* library = document.RootElement();
+      if (!library)
+      {
+        continue;
+      }
 
-        std::map<std::string, std::vector<std::string> >::iterator iter;
-        for (iter = supports.begin(); iter != supports.end(); ++iter)
+      for (TiXmlElement* plugin = library->FirstChildElement("class");
+           plugin != NULL;
+           plugin = plugin->NextSiblingElement("class"))
+      {
+        const char* name = plugin->Attribute("name");
+        if (!name)
         {
-          for (uint32_t j = 0; j < iter->second.size(); j++)
-          {
-            if (transformers_[iter->first].count(iter->second[j]) > 0)
-            {
-              ROS_WARN("[transform_manager]: Transformer conflict for %s to %s",
-                  iter->first.c_str(), iter->second[j].c_str());
-            }
+          name = plugin->Attribute("type");
+        }
 
-            transformers_[iter->first][iter->second[j]] = transformer;
+        if (!name)
+        {
+          continue;
+        }
+
+        for (TiXmlElement* pair = plugin->FirstChildElement("supports");
+             pair != NULL;
+             pair = pair->NextSiblingElement("supports"))
+        {
+          const char* source = pair->Attribute("source");
+          const char* target = pair->Attribute("target");
+          if (source && target)
+          {
+            supports[name][source].push_back(target);
           }
         }
       }
-      catch (const pluginlib::CreateClassException& e)
+    }
+  }
+
+  TransformManager::TransformManager() :
+      loader_("transform_util", "transform_util::Transformer"),
+      request_lookups_(0)
+  {
+    std::map<std::string, std::map<std::string, std::vector<std::string> > > declared;
+    ReadDeclaredSupports(declared);
+
+    std::vector<std::string> class_names = loader_.getDeclaredClasses();
+
+    for (uint32_t i = 0; i < class_names.size(); i++)
+    {
+      if (declared.count(class_names[i]) > 0)
       {
-        ROS_ERROR("[transform_manager]: Failed to load transformer plugin '%s': %s",
-            class_names[i].c_str(), e.what());
+        // Register the plugin now, but only load it once it's needed.
+        RegisterPlugin(class_names[i], declared[class_names[i]], plugin_names_);
+      }
+      else
+      {
+        // Without declared supports the plugin has to be loaded to find out
+        // what it supports.
+        boost::unique_lock<boost::mutex> lock(plugins_mutex_);
+        LoadPlugin(class_names[i]);
       }
     }
   }
 
   TransformManager::~TransformManager()
   {
+    // Stop serving requests before the queue they're served from goes away.
+    if (requests_spinner_)
+    {
+      requests_spinner_->stop();
+    }
+    requests_timer_.stop();
   }
 
-  void TransformManager::Initialize(boost::shared_ptr<tf::TransformListener> tf)
+  void TransformManager::Initialize(boost::shared_ptr<tf::Transformer> tf)
   {
+    boost::unique_lock<boost::mutex> lock(plugins_mutex_);
+
     tf_listener_ = tf;
 
-    std::map<std::string, std::map<std::string, boost::shared_ptr<Transformer> > >::iterator iter1;
-    for (iter1 = transformers_.begin(); iter1 != transformers_.end(); ++iter1)
+    std::map<std::string, boost::shared_ptr<Transformer> >::iterator iter;
+    for (iter = plugins_.begin(); iter != plugins_.end(); ++iter)
     {
-      std::map<std::string, boost::shared_ptr<Transformer> >::iterator iter2;
+      iter->second->Initialize(tf);
+    }
+
+    // Plugins for the local_xy, wgs84 and utm frames are loaded now instead
+    // of on the first transform, so that they are already subscribed to the
+    // local xy origin by the time they are needed.
+    std::set<std::string> special_plugins;
+    PluginMap::const_iterator iter1;
+    for (iter1 = plugin_names_.begin(); iter1 != plugin_names_.end(); ++iter1)
+    {
+      std::map<std::string, std::string>::const_iterator iter2;
       for (iter2 = iter1->second.begin(); iter2 != iter1->second.end(); ++iter2)
       {
-        iter2->second->Initialize(tf);
+        if (IsSpecialFrame(iter1->first) || IsSpecialFrame(iter2->first))
+        {
+          special_plugins.insert(iter2->second);
+        }
+      }
+    }
+
+    std::set<std::string>::const_iterator name;
+    for (name = special_plugins.begin(); name != special_plugins.end(); ++name)
+    {
+      if (failed_plugins_.count(*name) == 0)
+      {
+        LoadPlugin(*name);
+      }
+    }
+  }
+
+  void TransformManager::SetTransformBuffer(TransformBufferPtr buffer)
+  {
+    boost::unique_lock<boost::mutex> lock(plugins_mutex_);
+
+    transform_buffer_ = buffer;
+
+    std::map<std::string, boost::shared_ptr<Transformer> >::iterator iter;
+    for (iter = plugins_.begin(); iter != plugins_.end(); ++iter)
+    {
+      iter->second->SetTransformBuffer(buffer);
+    }
+  }
+
+  void TransformManager::RegisterPlugin(
+      const std::string& class_name,
+      const std::map<std::string, std::vector<std::string> >& supports,
+      PluginMap& plugin_names)
+  {
+    std::map<std::string, std::vector<std::string> >::const_iterator iter;
+    for (iter = supports.begin(); iter != supports.end(); ++iter)
+    {
+      for (uint32_t j = 0; j < iter->second.size(); j++)
+      {
+        std::map<std::string, std::string>& targets = plugin_names[iter->first];
+        if (targets.count(iter->second[j]) > 0 &&
+            targets[iter->second[j]] != class_name)
+        {
+          ROS_WARN("[transform_manager]: Transformer conflict for %s to %s",
+              iter->first.c_str(), iter->second[j].c_str());
+        }
+
+        targets[iter->second[j]] = class_name;
       }
     }
   }
 
+  boost::shared_ptr<Transformer> TransformManager::LoadPlugin(
+      const std::string& class_name) const
+  {
+    std::map<std::string, boost::shared_ptr<Transformer> >::iterator loaded =
+        plugins_.find(class_name);
+    if (loaded != plugins_.end())
+    {
+      return loaded->second;
+    }
+
+    boost::shared_ptr<Transformer> transformer;
+    try
+    {
+      transformer = loader_.createInstance(class_name);
+    }
+    catch (const pluginlib::PluginlibException& e)
+    {
+      ROS_ERROR("[transform_manager]: Failed to load transformer plugin '%s': %s",
+          class_name.c_str(), e.what());
+    }
+
+    if (!transformer)
+    {
+      // Remember the failure so that loading isn't retried on every call.
+      failed_plugins_.insert(class_name);
+      return transformer;
+    }
+
+    plugins_[class_name] = transformer;
+
+    if (tf_listener_)
+    {
+      transformer->Initialize(tf_listener_);
+    }
+
+    if (transform_buffer_)
+    {
+      transformer->SetTransformBuffer(transform_buffer_);
+    }
+
+    std::map<std::string, std::vector<std::string> > supports = transformer->Supports();
+
+    // Plugins loaded eagerly haven't been registered yet.
+    std::map<std::string, std::vector<std::string> > unregistered;
+    std::map<std::string, std::vector<std::string> >::iterator iter;
+    for (iter = supports.begin(); iter != supports.end(); ++iter)
+    {
+      for (uint32_t j = 0; j < iter->second.size(); j++)
+      {
+        PluginMap::const_iterator targets = plugin_names_.find(iter->first);
+        if (targets == plugin_names_.end() ||
+            targets->second.count(iter->second[j]) == 0)
+        {
+          unregistered[iter->first].push_back(iter->second[j]);
+        }
+      }
+    }
+    RegisterPlugin(class_name, unregistered, plugin_names_);
+
+    // Route every pair assigned to this plugin to the new instance.
+    PluginMap::const_iterator iter1;
+    for (iter1 = plugin_names_.begin(); iter1 != plugin_names_.end(); ++iter1)
+    {
+      std::map<std::string, std::string>::const_iterator iter2;
+      for (iter2 = iter1->second.begin(); iter2 != iter1->second.end(); ++iter2)
+      {
+        if (iter2->second == class_name)
+        {
+          transformers_[iter1->first][iter2->first] = transformer;
+        }
+      }
+    }
+
+    return transformer;
+  }
+
+  boost::shared_ptr<Transformer> TransformManager::GetTransformer(
+      const std::string& source_frame,
+      const std::string& target_frame) const
+  {
+    boost::unique_lock<boost::mutex> lock(plugins_mutex_);
+
+    TransformerMap::const_iterator loaded = transformers_.find(source_frame);
+    if (loaded != transformers_.end())
+    {
+      std::map<std::string, boost::shared_ptr<Transformer> >::const_iterator transformer =
+          loaded->second.find(target_frame);
+      if (transformer != loaded->second.end())
+      {
+        return transformer->second;
+      }
+    }
+
+    PluginMap::const_iterator targets = plugin_names_.find(source_frame);
+    if (targets == plugin_names_.end())
+    {
+      return boost::shared_ptr<Transformer>();
+    }
+
+    std::map<std::string, std::string>::const_iterator class_name =
+        targets->second.find(target_frame);
+    if (class_name == targets->second.end() ||
+        failed_plugins_.count(class_name->second) > 0)
+    {
+      return boost::shared_ptr<Transformer>();
+    }
+
+    return LoadPlugin(class_name->second);
+  }
+
   bool TransformManager::GetTransform(
       const std::string& target_frame,
       const std::string& source_frame,
@@ -168,15 +429,7 @@ namespace transform_util
       return false;
     }
 
-    if (transformers_[source].count(target) == 0)
-    {
-      ROS_ERROR("[transform_manager]: No transformer for transforming %s to %s",
-          source.c_str(), target.c_str());
-
-      return false;
-    }
-
-    boost::shared_ptr<Transformer> transformer = transformers_[source][target];
+    boost::shared_ptr<Transformer> transformer = GetTransformer(source, target);
 
     if (!transformer)
     {
@@ -259,22 +512,20 @@ namespace transform_util
       return true;
     }
 
-    if (transformers_[source].count(target) == 0)
-    {
-      return false;
-    }
-
-    boost::shared_ptr<Transformer> transformer = transformers_[source][target];
+    // Check the registered plugins without loading them.
+    boost::unique_lock<boost::mutex> lock(plugins_mutex_);
 
-    if (!transformer)
+    PluginMap::const_iterator targets = plugin_names_.find(source);
+    if (targets == plugin_names_.end())
     {
-      ROS_ERROR("[transform_manager]: No transformer for transforming %s to %s",
-          source.c_str(), target.c_str());
-
       return false;
     }
 
-    return true;
+    std::map<std::string, std::string>::const_iterator class_name =
+        targets->second.find(target);
+
+    return class_name != targets->second.end() &&
+        failed_plugins_.count(class_name->second) == 0;
   }
 
   bool TransformManager::GetTransform(
@@ -283,6 +534,12 @@ namespace transform_util
       const ros::Time& time,
       tf::StampedTransform& transform) const
   {
+    if (transform_buffer_ &&
+        transform_buffer_->Lookup(target_frame, source_frame, time, transform))
+    {
+      return true;
+    }
+
     if (!tf_listener_)
       return false;
 
@@ -323,6 +580,256 @@ namespace transform_util
     return has_transform;
   }
 
+  void TransformManager::RequestTransform(
+      const std::string& target_frame,
+      const std::string& source_frame,
+      const ros::Time& time,
+      const TransformCallback& callback,
+      const ros::Duration& timeout)
+  {
+    TransformRequest request;
+    request.time = time;
+    request.deadline = ros::Time::now() + timeout;
+    request.callback = callback;
+
+    boost::unique_lock<boost::mutex> lock(requests_mutex_);
+    requests_[FramePair(target_frame, source_frame)].push_back(request);
+
+    if (!requests_timer_)
+    {
+      // Serve the requests from a dedicated thread so that they're resolved
+      // even while the caller's callback queue is blocked waiting on them.
+      ros::NodeHandle node;
+      node.setCallbackQueue(&requests_queue_);
+      requests_timer_ = node.createTimer(
+          ros::Duration(1.0 / _request_rate),
+          &TransformManager::ProcessRequests,
+          this);
+
+      requests_spinner_ = boost::make_shared<ros::AsyncSpinner>(1, &requests_queue_);
+      requests_spinner_->start();
+    }
+    else
+    {
+      // The timer is stopped whenever the queue runs empty.
+      requests_timer_.start();
+    }
+  }
+
+  boost::shared_future<Transform> TransformManager::RequestTransform(
+      const std::string& target_frame,
+      const std::string& source_frame,
+      const ros::Time& time,
+      const ros::Duration& timeout)
+  {
+    boost::shared_ptr<boost::promise<Transform> > promise =
+        boost::make_shared<boost::promise<Transform> >();
+
+    boost::shared_future<Transform> future(promise->get_future());
+
+    RequestTransform(
+        target_frame,
+        source_frame,
+        time,
+        boost::bind(&FulfillPromise, promise, _1, _2),
+        timeout);
+
+    return future;
+  }
+
+  uint64_t TransformManager::RequestLookupCount() const
+  {
+    boost::unique_lock<boost::mutex> lock(requests_mutex_);
+    return request_lookups_;
+  }
+
+  bool TransformManager::CanTransform(
+      const std::string& target_frame,
+      const std::string& source_frame,
+      const ros::Time& time) const
+  {
+    if (target_frame == source_frame)
+    {
+      return true;
+    }
+
+    if (!tf_listener_)
+    {
+      return false;
+    }
+
+    // Special frames are resolved through the LocalXY frame of the tf tree.
+    std::string target = target_frame;
+    std::string source = source_frame;
+    if (IsSpecialFrame(target) || IsSpecialFrame(source))
+    {
+      std::string local_xy_frame;
+      if (!ros::param::get("/local_xy_frame", local_xy_frame))
+      {
+        return false;
+      }
+
+      if (IsSpecialFrame(target))
+      {
+        target = local_xy_frame;
+      }
+
+      if (IsSpecialFrame(source))
+      {
+        source = local_xy_frame;
+      }
+
+      if (target == source)
+      {
+        return true;
+      }
+    }
+
+    tf::StampedTransform transform;
+    if (transform_buffer_ &&
+        transform_buffer_->Lookup(target, source, time, transform))
+    {
+      return true;
+    }
+
+    return tf_listener_->canTransform(target, source, time);
+  }
+
+  bool TransformManager::ResolveTransform(
+      const std::string& target_frame,
+      const std::string& source_frame,
+      const ros::Time& time,
+      Transform& transform) const
+  {
+    if (IsSpecialFrame(target_frame) || IsSpecialFrame(source_frame))
+    {
+      // CanTransform() has already found the tf data the plugin needs, so
+      // its wait returns immediately.
+      return GetTransform(target_frame, source_frame, time, transform);
+    }
+
+    if (target_frame == source_frame)
+    {
+      transform = Transform();
+      return true;
+    }
+
+    tf::StampedTransform tf_transform;
+    if (transform_buffer_ &&
+        transform_buffer_->Lookup(target_frame, source_frame, time, tf_transform))
+    {
+      transform = tf_transform;
+      return true;
+    }
+
+    try
+    {
+      tf_listener_->lookupTransform(target_frame, source_frame, time, tf_transform);
+    }
+    catch (const tf::TransformException& e)
+    {
+      ROS_ERROR("[transform_manager]: %s", e.what());
+      return false;
+    }
+
+    transform = tf_transform;
+    return true;
+  }
+
+  void TransformManager::ProcessRequests(const ros::TimerEvent& event)
+  {
+    // Take the pending requests so that new requests can be queued while the
+    // current ones are being checked.
+    RequestMap requests;
+    {
+      boost::unique_lock<boost::mutex> lock(requests_mutex_);
+      if (requests_.empty())
+      {
+        requests_timer_.stop();
+        return;
+      }
+      requests.swap(requests_);
+    }
+
+    ros::Time now = ros::Time::now();
+
+    std::vector<std::pair<TransformCallback, Transform> > resolved;
+    std::vector<TransformCallback> expired;
+    RequestMap pending;
+    uint64_t lookups = 0;
+
+    RequestMap::iterator iter;
+    for (iter = requests.begin(); iter != requests.end(); ++iter)
+    {
+      const std::string& target_frame = iter->first.first;
+      const std::string& source_frame = iter->first.second;
+
+      // Requests for the same frame pair and time share a single lookup.
+      std::map<ros::Time, std::pair<bool, Transform> > results;
+
+      std::vector<TransformRequest>& pair_requests = iter->second;
+      for (size_t i = 0; i < pair_requests.size(); i++)
+      {
+        const TransformRequest& request = pair_requests[i];
+
+        std::map<ros::Time, std::pair<bool, Transform> >::iterator result =
+            results.find(request.time);
+        if (result == results.end())
+        {
+          std::pair<bool, Transform> lookup(false, Transform());
+          if (CanTransform(target_frame, source_frame, request.time))
+          {
+            lookups++;
+            lookup.first = ResolveTransform(
+                target_frame, source_frame, request.time, lookup.second);
+          }
+          result = results.insert(std::make_pair(request.time, lookup)).first;
+        }
+
+        if (result->second.first)
+        {
+          resolved.push_back(std::make_pair(request.callback, result->second.second));
+        }
+        else if (now > request.deadline)
+        {
+          expired.push_back(request.callback);
+        }
+        else
+        {
+          pending[iter->first].push_back(request);
+        }
+      }
+    }
+
+    {
+      boost::unique_lock<boost::mutex> lock(requests_mutex_);
+      request_lookups_ += lookups;
+      for (iter = pending.begin(); iter != pending.end(); ++iter)
+      {
+        std::vector<TransformRequest>& queued = requests_[iter->first];
+        queued.insert(queued.end(), iter->second.begin(), iter->second.end());
+      }
+
+      // Don't keep polling once there's nothing left to resolve.
+      if (requests_.empty())
+      {
+        requests_timer_.stop();
+      }
+    }
+
+    // Call the callbacks without holding the lock so they can queue new
+    // requests.
+    for (size_t i = 0; i < resolved.size(); i++)
+    {
+      resolved[i].first(true, resolved[i].second);
+    }
+
+    for (size_t i = 0; i < expired.size(); i++)
+    {
+      expired[i](false, Transform());
+    }
+  }
+
   bool TransformManager::GetTransform(
       const std::string& target_frame,
       const std::string& source_frame,
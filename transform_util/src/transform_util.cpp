@@ -40,6 +40,7 @@
 #include <math_util/constants.h>
 #include <math_util/math_util.h>
 #include <math_util/trig_util.h>
+#include <transform_util/earth_constants.h>
 
 namespace transform_util
 {
@@ -102,6 +103,155 @@ namespace transform_util
     return std::atan2(y, x) * math_util::_rad_2_deg;
   }
 
+  double GetDistance(
+      double source_latitude,
+      double source_longitude,
+      double destination_latitude,
+      double destination_longitude)
+  {
+    double lat1 = source_latitude * math_util::_deg_2_rad;
+    double lon1 = source_longitude * math_util::_deg_2_rad;
+
+    double lat2 = destination_latitude * math_util::_deg_2_rad;
+    double lon2 = destination_longitude * math_util::_deg_2_rad;
+
+    double sin_d_lat = std::sin((lat2 - lat1) * 0.5);
+    double sin_d_lon = std::sin((lon2 - lon1) * 0.5);
+
+    // Haversine formula, which is well conditioned for small distances.
+    double a = sin_d_lat * sin_d_lat +
+        std::cos(lat1) * std::cos(lat2) * sin_d_lon * sin_d_lon;
+
+    return 2.0 * _earth_mean_radius * std::asin(std::min(1.0, std::sqrt(a)));
+  }
+
+  /**
+   * Source point terms shared by all destinations in the batch geodesic
+   * functions.
+   */
+  struct GeodesicSource
+  {
+    GeodesicSource(double latitude, double longitude) :
+      lat(latitude * math_util::_deg_2_rad),
+      lon(longitude * math_util::_deg_2_rad),
+      sin_lat(std::sin(lat)),
+      cos_lat(std::cos(lat)),
+      flat_error(std::abs(sin_lat / cos_lat) / _earth_mean_radius)
+    {
+    }
+
+    double lat;
+    double lon;
+    double sin_lat;
+    double cos_lat;
+
+    // The flat-earth error at distance d is bounded by
+    // d^2 * flat_error + d^3 / R^2, where the first term accounts for the
+    // convergence of the meridians and the second for the curvature.
+    double flat_error;
+  };
+
+  static inline void GetBearingAndDistance(
+      const GeodesicSource& source,
+      double destination_latitude,
+      double destination_longitude,
+      double max_error,
+      double& bearing,
+      double& distance)
+  {
+    double lat2 = destination_latitude * math_util::_deg_2_rad;
+    double lon2 = destination_longitude * math_util::_deg_2_rad;
+    double d_lon = lon2 - source.lon;
+
+    if (max_error > 0)
+    {
+      double d_lon_wrapped = math_util::WrapRadians(d_lon, 0);
+      double east = d_lon_wrapped * source.cos_lat * _earth_mean_radius;
+      double north = (lat2 - source.lat) * _earth_mean_radius;
+      double d2 = east * east + north * north;
+      double d = std::sqrt(d2);
+
+      double error = d2 * source.flat_error +
+          d2 * d / (_earth_mean_radius * _earth_mean_radius);
+      if (error <= max_error)
+      {
+        bearing = std::atan2(east, north) * math_util::_rad_2_deg;
+        distance = d;
+        return;
+      }
+    }
+
+    double sin_lat2 = std::sin(lat2);
+    double cos_lat2 = std::cos(lat2);
+
+    double y = std::sin(d_lon) * cos_lat2;
+    double x = source.cos_lat * sin_lat2 -
+        source.sin_lat * cos_lat2 * std::cos(d_lon);
+    bearing = std::atan2(y, x) * math_util::_rad_2_deg;
+
+    double sin_d_lat = std::sin((lat2 - source.lat) * 0.5);
+    double sin_d_lon = std::sin(d_lon * 0.5);
+    double a = sin_d_lat * sin_d_lat +
+        source.cos_lat * cos_lat2 * sin_d_lon * sin_d_lon;
+    distance = 2.0 * _earth_mean_radius * std::asin(std::min(1.0, std::sqrt(a)));
+  }
+
+  void GetBearingsAndDistances(
+      double source_latitude,
+      double source_longitude,
+      const std::vector<double>& destination_latitudes,
+      const std::vector<double>& destination_longitudes,
+      std::vector<double>& bearings,
+      std::vector<double>& distances,
+      double max_error)
+  {
+    size_t count = std::min(
+        destination_latitudes.size(),
+        destination_longitudes.size());
+    bearings.resize(count);
+    distances.resize(count);
+
+    GeodesicSource source(source_latitude, source_longitude);
+    for (size_t i = 0; i < count; i++)
+    {
+      GetBearingAndDistance(
+          source,
+          destination_latitudes[i],
+          destination_longitudes[i],
+          max_error,
+          bearings[i],
+          distances[i]);
+    }
+  }
+
+  void GetBearingsAndDistances(
+      const std::vector<double>& source_latitudes,
+      const std::vector<double>& source_longitudes,
+      const std::vector<double>& destination_latitudes,
+      const std::vector<double>& destination_longitudes,
+      std::vector<double>& bearings,
+      std::vector<double>& distances,
+      double max_error)
+  {
+    size_t count = std::min(
+        std::min(source_latitudes.size(), source_longitudes.size()),
+        std::min(destination_latitudes.size(), destination_longitudes.size()));
+    bearings.resize(count);
+    distances.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      GeodesicSource source(source_latitudes[i], source_longitudes[i]);
+      GetBearingAndDistance(
+          source,
+          destination_latitudes[i],
+          destination_longitudes[i],
+          max_error,
+          bearings[i],
+          distances[i]);
+    }
+  }
+
   double GetHeading(double src_x, double src_y, double dst_x, double dst_y)
   {
     return ToHeading(std::atan2(dst_y - src_y, dst_x - src_x));
@@ -334,4 +484,120 @@ namespace transform_util
     matrix[34] = sub_matrix[2][1];
     matrix[35] = sub_matrix[2][2];
   }
+
+  /**
+   * Computes R * X * R^T for a 3x3 block X stored with the given row stride.
+   */
+  template <size_t Stride>
+  static inline void RotateBlock(const double* r, const double* in, double* out)
+  {
+    // t = R * X
+    double t[9];
+    for (size_t i = 0; i < 3; i++)
+    {
+      for (size_t j = 0; j < 3; j++)
+      {
+        t[i * 3 + j] =
+            r[i * 3] * in[j] +
+            r[i * 3 + 1] * in[Stride + j] +
+            r[i * 3 + 2] * in[2 * Stride + j];
+      }
+    }
+
+    // out = t * R^T
+    for (size_t i = 0; i < 3; i++)
+    {
+      for (size_t j = 0; j < 3; j++)
+      {
+        out[i * Stride + j] =
+            t[i * 3] * r[j * 3] +
+            t[i * 3 + 1] * r[j * 3 + 1] +
+            t[i * 3 + 2] * r[j * 3 + 2];
+      }
+    }
+  }
+
+  static inline void GetRotation(const tf::Transform& transform, double* r)
+  {
+    const tf::Matrix3x3& basis = transform.getBasis();
+    for (size_t i = 0; i < 3; i++)
+    {
+      r[i * 3] = basis[i][0];
+      r[i * 3 + 1] = basis[i][1];
+      r[i * 3 + 2] = basis[i][2];
+    }
+  }
+
+  static inline void RotateCovariance6x6(
+      const double* r,
+      const boost::array<double, 36>& matrix_in,
+      boost::array<double, 36>& matrix_out)
+  {
+    // Rotate each of the 3x3 blocks into a temporary so that the input and
+    // output can alias.
+    double result[36];
+    RotateBlock<6>(r, &matrix_in[0], &result[0]);
+    RotateBlock<6>(r, &matrix_in[3], &result[3]);
+    RotateBlock<6>(r, &matrix_in[18], &result[18]);
+    RotateBlock<6>(r, &matrix_in[21], &result[21]);
+
+    std::copy(result, result + 36, matrix_out.begin());
+  }
+
+  void RotateCovariance(
+      const tf::Transform& transform,
+      const boost::array<double, 36>& matrix_in,
+      boost::array<double, 36>& matrix_out)
+  {
+    double r[9];
+    GetRotation(transform, r);
+    RotateCovariance6x6(r, matrix_in, matrix_out);
+  }
+
+  void RotateCovariance(
+      const tf::Transform& transform,
+      const boost::array<double, 9>& matrix_in,
+      boost::array<double, 9>& matrix_out)
+  {
+    double r[9];
+    GetRotation(transform, r);
+
+    double result[9];
+    RotateBlock<3>(r, &matrix_in[0], result);
+
+    std::copy(result, result + 9, matrix_out.begin());
+  }
+
+  void RotateCovariances(
+      const tf::Transform& transform,
+      const boost::array<double, 36>* matrices_in,
+      size_t count,
+      boost::array<double, 36>* matrices_out)
+  {
+    double r[9];
+    GetRotation(transform, r);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      RotateCovariance6x6(r, matrices_in[i], matrices_out[i]);
+    }
+  }
+
+  void RotateCovariances(
+      const tf::Transform& transform,
+      const std::vector<boost::array<double, 36> >& matrices_in,
+      std::vector<boost::array<double, 36> >& matrices_out)
+  {
+    matrices_out.resize(matrices_in.size());
+    if (matrices_in.empty())
+    {
+      return;
+    }
+
+    RotateCovariances(
+        transform,
+        &matrices_in[0],
+        matrices_in.size(),
+        &matrices_out[0]);
+  }
 }
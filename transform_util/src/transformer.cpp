@@ -40,12 +40,17 @@ namespace transform_util
   }
 
   void Transformer::Initialize(
-      const boost::shared_ptr<tf::TransformListener> tf)
+      const boost::shared_ptr<tf::Transformer> tf)
   {
     tf_listener_ = tf;
     initialized_ = Initialize();
   }
 
+  void Transformer::SetTransformBuffer(TransformBufferPtr buffer)
+  {
+    transform_buffer_ = buffer;
+  }
+
   bool Transformer::Initialize()
   {
     return true;
@@ -57,6 +62,12 @@ namespace transform_util
       const ros::Time& time,
       tf::StampedTransform& transform) const
   {
+    if (transform_buffer_ &&
+        transform_buffer_->Lookup(target_frame, source_frame, time, transform))
+    {
+      return true;
+    }
+
     if (!tf_listener_)
     {
       return false;
@@ -32,6 +32,7 @@
 #include <boost/make_shared.hpp>
 
 #include <transform_util/frames.h>
+#include <transform_util/wgs84_transformer.h>
 
 #include <pluginlib/class_list_macros.h>
 PLUGINLIB_DECLARE_CLASS(
@@ -167,7 +168,9 @@ namespace transform_util
     // Initialize LocalXY util with an origin.
     if (local_xy_util_->Initialized())
     {
-      utm_zone_ = GetZone(local_xy_util_->ReferenceLongitude());
+      utm_zone_ = GetZone(
+          local_xy_util_->ReferenceLatitude(),
+          local_xy_util_->ReferenceLongitude());
       utm_band_ = GetBand(local_xy_util_->ReferenceLatitude());
     }
 
@@ -206,6 +209,16 @@ namespace transform_util
     v_out = transform_ * v_out;
   }
 
+  bool UtmToTfTransform::GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const
+  {
+    stages.push_back(boost::make_shared<UtmToWgs84Transform>(
+        utm_util_, utm_zone_, utm_band_));
+    stages.push_back(boost::make_shared<Wgs84ToLocalXyTransform>(local_xy_util_));
+    stages.push_back(boost::make_shared<TfTransform>(transform_));
+    return true;
+  }
+
   TfToUtmTransform::TfToUtmTransform(
       const tf::StampedTransform& transform,
       boost::shared_ptr<UtmUtil> utm_util,
@@ -232,6 +245,15 @@ namespace transform_util
     v_out.setValue(easting, northing, local_xy.z());
   }
 
+  bool TfToUtmTransform::GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const
+  {
+    stages.push_back(boost::make_shared<TfTransform>(transform_));
+    stages.push_back(boost::make_shared<LocalXyToWgs84Transform>(local_xy_util_));
+    stages.push_back(boost::make_shared<Wgs84ToUtmTransform>(utm_util_));
+    return true;
+  }
+
   UtmToWgs84Transform::UtmToWgs84Transform(
     boost::shared_ptr<UtmUtil> utm_util,
     int32_t utm_zone,
@@ -264,4 +286,29 @@ namespace transform_util
     utm_util_->ToUtm(v_in.y(), v_in.x(), easting, northing);
     v_out.setValue(easting, northing, v_in.z());
   }
+
+  void Wgs84ToUtmTransform::TransformPoints(
+      const std::vector<tf::Vector3>& v_in,
+      std::vector<tf::Vector3>& v_out) const
+  {
+    std::vector<double> latitudes(v_in.size());
+    std::vector<double> longitudes(v_in.size());
+    for (size_t i = 0; i < v_in.size(); i++)
+    {
+      latitudes[i] = v_in[i].y();
+      longitudes[i] = v_in[i].x();
+    }
+
+    std::vector<int> zones;
+    std::vector<char> bands;
+    std::vector<double> eastings;
+    std::vector<double> northings;
+    utm_util_->ToUtm(latitudes, longitudes, zones, bands, eastings, northings);
+
+    v_out.resize(v_in.size());
+    for (size_t i = 0; i < v_in.size(); i++)
+    {
+      v_out[i].setValue(eastings[i], northings[i], v_in[i].z());
+    }
+  }
 }
@@ -29,6 +29,7 @@
 
 #include <transform_util/utm_util.h>
 
+#include <algorithm>
 #include <cmath>
 
 #include <ros/ros.h>
@@ -37,48 +38,141 @@
 
 namespace transform_util
 {
+  /**
+   * The UTM latitude bands from 80S in 8 degree steps.  The last band, X,
+   * spans 12 degrees up to 84N.
+   */
+  static const char _utm_bands[] = "CDEFGHJKLMNPQRSTUVWXX";
+
+  /**
+   * A region with a non-standard UTM zone.
+   */
+  struct ZoneException
+  {
+    double min_latitude;
+    double max_latitude;
+    double min_longitude;
+    double max_longitude;
+    uint32_t zone;
+  };
+
+  static const ZoneException _zone_exceptions[] =
+  {
+    // Southwest Norway
+    { 56.0, 64.0,  3.0, 12.0, 32 },
+    // Svalbard
+    { 72.0, 84.0,  0.0,  9.0, 31 },
+    { 72.0, 84.0,  9.0, 21.0, 33 },
+    { 72.0, 84.0, 21.0, 33.0, 35 },
+    { 72.0, 84.0, 33.0, 42.0, 37 }
+  };
+  static const size_t _num_zone_exceptions =
+      sizeof(_zone_exceptions) / sizeof(_zone_exceptions[0]);
+
+  /**
+   * A latitude/longitude rectangle within which the UTM zone and band are
+   * constant.
+   */
+  struct UtmCell
+  {
+    UtmCell() :
+      min_latitude(0),
+      max_latitude(0),
+      min_longitude(0),
+      max_longitude(0),
+      zone(0),
+      band('Z')
+    {
+    }
+
+    bool Contains(double latitude, double longitude) const
+    {
+      return latitude >= min_latitude && latitude < max_latitude &&
+          longitude >= min_longitude && longitude < max_longitude;
+    }
+
+    double min_latitude;
+    double max_latitude;
+    double min_longitude;
+    double max_longitude;
+    int zone;
+    char band;
+  };
+
   uint32_t GetZone(double longitude)
   {
-    int32_t zone = static_cast<int32_t>((longitude + 180.0) / 6.0) + 1;
-    if (zone < 1) zone = 1;
-    if (zone > 60) zone = 60;
+    // Work with whole degrees so the zone is found with an integer division.
+    int32_t degree = static_cast<int32_t>(std::floor(longitude + 180.0));
+    if (degree < 0) degree = 0;
+    if (degree > 359) degree = 359;
+
+    return static_cast<uint32_t>(degree / 6 + 1);
+  }
+
+  uint32_t GetZone(double latitude, double longitude)
+  {
+    // The exceptions only apply in bands V and X.
+    if (latitude >= 56.0 && latitude <= 84.0)
+    {
+      for (size_t i = 0; i < _num_zone_exceptions; i++)
+      {
+        const ZoneException& exception = _zone_exceptions[i];
+        // The latitude limits are exclusive like the bands, except for the
+        // top of band X at 84N.
+        if (latitude >= exception.min_latitude &&
+            (latitude < exception.max_latitude ||
+             (latitude == 84.0 && exception.max_latitude == 84.0)) &&
+            longitude >= exception.min_longitude &&
+            longitude < exception.max_longitude)
+        {
+          return exception.zone;
+        }
+      }
+    }
 
-    return static_cast<uint32_t>(zone);
+    return GetZone(longitude);
   }
 
   char GetBand(double latitude)
   {
-    // This routine determines the correct UTM letter designator for the given
-    // latitude returns 'Z' if latitude is outside the UTM limits of 84N to 80S
-    // Written by Chuck Gantz- chuck.gantz@globalstar.com
+    // Negated so that NaN is also outside the limits.
+    if (!(latitude >= -80.0 && latitude <= 84.0))
+    {
+      return 'Z';
+    }
 
-    char band;
+    return _utm_bands[static_cast<int32_t>((latitude + 80.0) * 0.125)];
+  }
+
+  static UtmCell GetCell(double latitude, double longitude)
+  {
+    UtmCell cell;
+    cell.zone = GetZone(latitude, longitude);
+    cell.band = GetBand(latitude);
 
-    if (latitude > 84) band = 'Z';
-    else if (latitude >= 72)  band = 'X';
-    else if (latitude >= 64)  band = 'W';
-    else if (latitude >= 56)  band = 'V';
-    else if (latitude >= 48)  band = 'U';
-    else if (latitude >= 40)  band = 'T';
-    else if (latitude >= 32)  band = 'S';
-    else if (latitude >= 24)  band = 'R';
-    else if (latitude >= 16)  band = 'Q';
-    else if (latitude >= 8)   band = 'P';
-    else if (latitude >= 0)   band = 'N';
-    else if (latitude >= -8)  band = 'M';
-    else if (latitude >= -16) band = 'L';
-    else if (latitude >= -24) band = 'K';
-    else if (latitude >= -32) band = 'J';
-    else if (latitude >= -40) band = 'H';
-    else if (latitude >= -48) band = 'G';
-    else if (latitude >= -56) band = 'F';
-    else if (latitude >= -64) band = 'E';
-    else if (latitude >= -72) band = 'D';
-    else if (latitude >= -80) band = 'C';
+    if (cell.band == 'Z')
+    {
+      // Leave the cell empty so that these points are always reclassified.
+      return cell;
+    }
+
+    int32_t band_index = static_cast<int32_t>((latitude + 80.0) * 0.125);
+    cell.min_latitude = -80.0 + 8.0 * band_index;
+    cell.max_latitude = std::min(cell.min_latitude + 8.0, 84.0);
+
+    if (cell.band == 'V' || cell.band == 'X')
+    {
+      // All of the zone exception boundaries fall on multiples of 3 degrees.
+      cell.min_longitude = std::floor(longitude / 3.0) * 3.0;
+      cell.max_longitude = cell.min_longitude + 3.0;
+    }
     else
-      band = 'Z';
+    {
+      cell.min_longitude = (cell.zone - 1) * 6.0 - 180.0;
+      cell.max_longitude = cell.min_longitude + 6.0;
+    }
 
-    return band;
+    return cell;
   }
 
   UtmUtil::UtmData::UtmData()
@@ -120,7 +214,7 @@ namespace transform_util
   {
     boost::unique_lock<boost::mutex> lock(mutex_);
 
-    zone = GetZone(longitude);
+    zone = GetZone(latitude, longitude);
     band = GetBand(latitude);
 
     double x = longitude * math_util::_deg_2_rad;
@@ -152,6 +246,51 @@ namespace transform_util
     ToUtm(latitude, longitude, zone, band, easting, northing);
   }
 
+  void UtmUtil::UtmData::ToUtm(
+      const std::vector<double>& latitudes,
+      const std::vector<double>& longitudes,
+      std::vector<int>& zones,
+      std::vector<char>& bands,
+      std::vector<double>& eastings,
+      std::vector<double>& northings) const
+  {
+    size_t count = std::min(latitudes.size(), longitudes.size());
+    zones.resize(count);
+    bands.resize(count);
+    eastings.resize(count);
+    northings.resize(count);
+
+    if (count == 0)
+    {
+      return;
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+
+    size_t i = 0;
+    while (i < count)
+    {
+      // Classify the first point of a run, then extend the run while the
+      // following points stay within the same cell.
+      UtmCell cell = GetCell(latitudes[i], longitudes[i]);
+      size_t start = i;
+      do
+      {
+        zones[i] = cell.zone;
+        bands[i] = cell.band;
+        eastings[i] = longitudes[i] * math_util::_deg_2_rad;
+        northings[i] = latitudes[i] * math_util::_deg_2_rad;
+        i++;
+      }
+      while (i < count && cell.Contains(latitudes[i], longitudes[i]));
+
+      projPJ utm = cell.band <= 'N' ?
+          utm_south_[cell.zone - 1] : utm_north_[cell.zone - 1];
+
+      pj_transform(lat_lon_, utm, i - start, 1, &eastings[start], &northings[start], NULL);
+    }
+  }
+
   void UtmUtil::UtmData::ToLatLon(
       int zone,
       char band,
@@ -203,6 +342,17 @@ namespace transform_util
     utm_data_.ToUtm(latitude, longitude, easting, northing);
   }
 
+  void UtmUtil::ToUtm(
+      const std::vector<double>& latitudes,
+      const std::vector<double>& longitudes,
+      std::vector<int>& zones,
+      std::vector<char>& bands,
+      std::vector<double>& eastings,
+      std::vector<double>& northings) const
+  {
+    utm_data_.ToUtm(latitudes, longitudes, zones, bands, eastings, northings);
+  }
+
   void UtmUtil::ToLatLon(
       int zone,
       char band,
@@ -143,6 +143,14 @@ namespace transform_util
     local_xy_util_->ToWgs84(local_xy.x(), local_xy.y(), latitude, longitude);
     v_out.setValue(longitude, latitude, local_xy.z());
   }
+
+  bool TfToWgs84Transform::GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const
+  {
+    stages.push_back(boost::make_shared<TfTransform>(transform_));
+    stages.push_back(boost::make_shared<LocalXyToWgs84Transform>(local_xy_util_));
+    return true;
+  }
   
   Wgs84ToTfTransform::Wgs84ToTfTransform(
     const tf::StampedTransform& transform,
@@ -163,5 +171,40 @@ namespace transform_util
     // Transform from the LocalXY coordinate frame using the TF transform.
     v_out = transform_ * v_out;
   }
-}
 
+  bool Wgs84ToTfTransform::GetStages(
+      std::vector<boost::shared_ptr<TransformImpl> >& stages) const
+  {
+    stages.push_back(boost::make_shared<Wgs84ToLocalXyTransform>(local_xy_util_));
+    stages.push_back(boost::make_shared<TfTransform>(transform_));
+    return true;
+  }
+
+  LocalXyToWgs84Transform::LocalXyToWgs84Transform(
+    boost::shared_ptr<LocalXyWgs84Util> local_xy_util) :
+    local_xy_util_(local_xy_util)
+  {
+    stamp_ = ros::Time::now();
+  }
+
+  void LocalXyToWgs84Transform::Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const
+  {
+    double latitude, longitude;
+    local_xy_util_->ToWgs84(v_in.x(), v_in.y(), latitude, longitude);
+    v_out.setValue(longitude, latitude, v_in.z());
+  }
+
+  Wgs84ToLocalXyTransform::Wgs84ToLocalXyTransform(
+    boost::shared_ptr<LocalXyWgs84Util> local_xy_util) :
+    local_xy_util_(local_xy_util)
+  {
+    stamp_ = ros::Time::now();
+  }
+
+  void Wgs84ToLocalXyTransform::Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const
+  {
+    double x, y;
+    local_xy_util_->ToLocalXy(v_in.y(), v_in.x(), x, y);
+    v_out.setValue(x, y, v_in.z());
+  }
+}
@@ -0,0 +1,391 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+/**
+ * Offline benchmark of the per-point conversion cost of the transformer
+ * plugins, of TransformManager::GetTransform lookups, and of the startup
+ * cost of TransformManager.
+ *
+ * tf data is provided by an in-process tf::Transformer, so no ROS master or
+ * tf publisher is needed.  The results are written to stdout as JSON.
+ *
+ * Usage: benchmark_transform [min_points_per_case]
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ros/ros.h>
+#include <tf/transform_datatypes.h>
+#include <tf/transform_listener.h>
+
+#include <transform_util/local_xy_util.h>
+#include <transform_util/transform.h>
+#include <transform_util/transform_buffer.h>
+#include <transform_util/transform_manager.h>
+#include <transform_util/utm_transformer.h>
+#include <transform_util/utm_util.h>
+#include <transform_util/wgs84_transformer.h>
+
+static const double _reference_latitude = 29.45196669;
+static const double _reference_longitude = -98.61370577;
+static const size_t _batch_sizes[] = { 1, 16, 256, 4096, 65536 };
+static const size_t _num_batch_sizes = sizeof(_batch_sizes) / sizeof(_batch_sizes[0]);
+
+// Accumulates outputs so the compiler can't discard the benchmarked work.
+static volatile double _sink = 0;
+
+struct Case
+{
+  std::string plugin;
+  std::string name;
+  transform_util::Transform transform;
+  std::vector<tf::Vector3> inputs;
+};
+
+struct PointResult
+{
+  std::string plugin;
+  std::string name;
+  size_t batch_size;
+  double ns_per_point;
+};
+
+struct LookupResult
+{
+  std::string name;
+  size_t lookups;
+  size_t failures;
+  double ns_per_lookup;
+};
+
+/**
+ * Time the conversion of a batch of points, repeating the batch until at least
+ * min_points have been converted.
+ */
+static double TimeBatch(
+    const transform_util::Transform& transform,
+    const std::vector<tf::Vector3>& inputs,
+    size_t batch_size,
+    size_t min_points)
+{
+  std::vector<tf::Vector3> batch(batch_size);
+  for (size_t i = 0; i < batch_size; i++)
+  {
+    batch[i] = inputs[i % inputs.size()];
+  }
+  std::vector<tf::Vector3> outputs(batch_size);
+
+  // Warm up.
+  transform.TransformPoints(batch, outputs);
+
+  size_t repetitions = std::max<size_t>(1, min_points / batch_size);
+
+  ros::WallTime start = ros::WallTime::now();
+  for (size_t i = 0; i < repetitions; i++)
+  {
+    transform.TransformPoints(batch, outputs);
+    _sink += outputs[i % batch_size].x();
+  }
+  double elapsed = (ros::WallTime::now() - start).toSec();
+
+  return elapsed * 1.0e9 / static_cast<double>(repetitions * batch_size);
+}
+
+static LookupResult TimeLookups(
+    const std::string& name,
+    const transform_util::TransformManager& manager,
+    const std::string& target_frame,
+    const std::string& source_frame,
+    const std::vector<ros::Time>& times,
+    size_t lookups)
+{
+  LookupResult result;
+  result.name = name;
+  result.lookups = lookups;
+  result.failures = 0;
+
+  transform_util::Transform transform;
+  ros::WallTime start = ros::WallTime::now();
+  for (size_t i = 0; i < lookups; i++)
+  {
+    if (!manager.GetTransform(target_frame, source_frame, times[i % times.size()], transform))
+    {
+      result.failures++;
+    }
+  }
+  double elapsed = (ros::WallTime::now() - start).toSec();
+
+  result.ns_per_lookup = elapsed * 1.0e9 / static_cast<double>(lookups);
+
+  return result;
+}
+
+/**
+ * Get the resident memory of the process in kilobytes, or 0 if unknown.
+ */
+static long GetResidentKb()
+{
+  long pages = 0;
+  long resident = 0;
+
+  FILE* file = std::fopen("/proc/self/statm", "r");
+  if (file)
+  {
+    if (std::fscanf(file, "%ld %ld", &pages, &resident) != 2)
+    {
+      resident = 0;
+    }
+    std::fclose(file);
+  }
+
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+
+  size_t min_points = 1000000;
+  if (argc > 1)
+  {
+    min_points = std::max(1L, std::strtol(argv[1], NULL, 10));
+  }
+
+  boost::shared_ptr<transform_util::UtmUtil> utm_util =
+      boost::make_shared<transform_util::UtmUtil>();
+  boost::shared_ptr<transform_util::LocalXyWgs84Util> local_xy_util =
+      boost::make_shared<transform_util::LocalXyWgs84Util>(
+          _reference_latitude,
+          _reference_longitude);
+
+  int32_t utm_zone = transform_util::GetZone(_reference_longitude);
+  char utm_band = transform_util::GetBand(_reference_latitude);
+
+  // The in-process tf source: /local_xy -> /map -> /base_link.
+  ros::Time stamp(1000.0);
+  tf::StampedTransform map_transform(
+      tf::Transform(tf::Quaternion(tf::Vector3(0, 0, 1), 0.4), tf::Vector3(120.0, -45.0, 0.0)),
+      stamp,
+      "/local_xy",
+      "/map");
+  tf::StampedTransform base_transform(
+      tf::Transform(tf::Quaternion(tf::Vector3(0, 0, 1), -1.2), tf::Vector3(15.0, 3.5, 1.0)),
+      stamp,
+      "/map",
+      "/base_link");
+
+  boost::shared_ptr<tf::Transformer> tf_source =
+      boost::make_shared<tf::Transformer>(true, ros::Duration(3600.0));
+  tf_source->setTransform(map_transform, "benchmark");
+  tf_source->setTransform(base_transform, "benchmark");
+
+  tf::StampedTransform local_xy_to_map;
+  tf_source->lookupTransform("/local_xy", "/map", ros::Time(0), local_xy_to_map);
+  tf::StampedTransform map_to_local_xy;
+  tf_source->lookupTransform("/map", "/local_xy", ros::Time(0), map_to_local_xy);
+
+  // Input points for each coordinate system, spread over a few kilometers
+  // around the local origin.
+  std::vector<tf::Vector3> local_points;
+  std::vector<tf::Vector3> wgs84_points;
+  std::vector<tf::Vector3> utm_points;
+  for (int32_t i = 0; i < 1024; i++)
+  {
+    double x = -2000.0 + 4000.0 * ((i * 37) % 1024) / 1024.0;
+    double y = -2000.0 + 4000.0 * ((i * 91) % 1024) / 1024.0;
+    local_points.push_back(tf::Vector3(x, y, 1.0));
+
+    double latitude, longitude;
+    local_xy_util->ToWgs84(x, y, latitude, longitude);
+    wgs84_points.push_back(tf::Vector3(longitude, latitude, 1.0));
+
+    double easting, northing;
+    utm_util->ToUtm(latitude, longitude, easting, northing);
+    utm_points.push_back(tf::Vector3(easting, northing, 1.0));
+  }
+
+  std::vector<Case> cases;
+
+  Case rigid;
+  rigid.plugin = "tf";
+  rigid.name = "map_to_local_xy";
+  rigid.transform = transform_util::Transform(local_xy_to_map);
+  rigid.inputs = local_points;
+  cases.push_back(rigid);
+
+  Case wgs84_to_utm;
+  wgs84_to_utm.plugin = "utm";
+  wgs84_to_utm.name = "wgs84_to_utm";
+  wgs84_to_utm.transform = boost::make_shared<transform_util::Wgs84ToUtmTransform>(utm_util);
+  wgs84_to_utm.inputs = wgs84_points;
+  cases.push_back(wgs84_to_utm);
+
+  Case utm_to_wgs84;
+  utm_to_wgs84.plugin = "utm";
+  utm_to_wgs84.name = "utm_to_wgs84";
+  utm_to_wgs84.transform = boost::make_shared<transform_util::UtmToWgs84Transform>(
+      utm_util, utm_zone, utm_band);
+  utm_to_wgs84.inputs = utm_points;
+  cases.push_back(utm_to_wgs84);
+
+  Case tf_to_utm;
+  tf_to_utm.plugin = "utm";
+  tf_to_utm.name = "tf_to_utm";
+  tf_to_utm.transform = boost::make_shared<transform_util::TfToUtmTransform>(
+      local_xy_to_map, utm_util, local_xy_util);
+  tf_to_utm.inputs = local_points;
+  cases.push_back(tf_to_utm);
+
+  Case utm_to_tf;
+  utm_to_tf.plugin = "utm";
+  utm_to_tf.name = "utm_to_tf";
+  utm_to_tf.transform = boost::make_shared<transform_util::UtmToTfTransform>(
+      map_to_local_xy, utm_util, local_xy_util, utm_zone, utm_band);
+  utm_to_tf.inputs = utm_points;
+  cases.push_back(utm_to_tf);
+
+  Case tf_to_wgs84;
+  tf_to_wgs84.plugin = "wgs84";
+  tf_to_wgs84.name = "tf_to_wgs84";
+  tf_to_wgs84.transform = boost::make_shared<transform_util::TfToWgs84Transform>(
+      local_xy_to_map, local_xy_util);
+  tf_to_wgs84.inputs = local_points;
+  cases.push_back(tf_to_wgs84);
+
+  Case wgs84_to_tf;
+  wgs84_to_tf.plugin = "wgs84";
+  wgs84_to_tf.name = "wgs84_to_tf";
+  wgs84_to_tf.transform = boost::make_shared<transform_util::Wgs84ToTfTransform>(
+      map_to_local_xy, local_xy_util);
+  wgs84_to_tf.inputs = wgs84_points;
+  cases.push_back(wgs84_to_tf);
+
+  std::vector<PointResult> point_results;
+  for (size_t i = 0; i < cases.size(); i++)
+  {
+    for (size_t j = 0; j < _num_batch_sizes; j++)
+    {
+      PointResult result;
+      result.plugin = cases[i].plugin;
+      result.name = cases[i].name;
+      result.batch_size = _batch_sizes[j];
+      result.ns_per_point = TimeBatch(
+          cases[i].transform,
+          cases[i].inputs,
+          _batch_sizes[j],
+          min_points);
+      point_results.push_back(result);
+    }
+  }
+
+  // Lookups through the manager.  The special frames need the local_xy origin
+  // from the parameter server, so only tf frames are looked up here; their
+  // conversion cost is covered by the point benchmarks above.
+  size_t lookups = std::max<size_t>(1, min_points / 100);
+  std::vector<LookupResult> lookup_results;
+
+  // Startup cost of the manager, including loading the transformer plugins.
+  long resident_before = GetResidentKb();
+  ros::WallTime start = ros::WallTime::now();
+  transform_util::TransformManager manager;
+  double construct_time = (ros::WallTime::now() - start).toSec();
+
+  start = ros::WallTime::now();
+  manager.Initialize(tf_source);
+  double initialize_time = (ros::WallTime::now() - start).toSec();
+  long resident_after = GetResidentKb();
+
+  std::vector<ros::Time> latest(1, ros::Time(0));
+  lookup_results.push_back(TimeLookups(
+      "tf_latest", manager, "/local_xy", "/base_link", latest, lookups));
+
+  transform_util::TransformBufferPtr buffer =
+      boost::make_shared<transform_util::TransformBuffer>(ros::Duration(3600.0), 1000);
+  std::vector<ros::Time> times;
+  for (int32_t i = 0; i < 1000; i++)
+  {
+    tf::StampedTransform sample(
+        tf::Transform(
+            tf::Quaternion(tf::Vector3(0, 0, 1), 0.001 * i),
+            tf::Vector3(0.1 * i, 0.0, 0.0)),
+        stamp + ros::Duration(0.01 * i),
+        "/map",
+        "/base_link");
+    buffer->Insert(sample);
+    times.push_back(stamp + ros::Duration(0.01 * i + 0.005));
+  }
+  times.pop_back();
+
+  manager.SetTransformBuffer(buffer);
+  lookup_results.push_back(TimeLookups(
+      "buffer_interpolated", manager, "/map", "/base_link", times, lookups));
+
+  std::printf("{\n  \"min_points\": %lu,\n", static_cast<unsigned long>(min_points));
+  std::printf(
+      "  \"startup\": {\"construct_ns\": %.0f, \"initialize_ns\": %.0f, \"resident_kb\": %ld},\n",
+      construct_time * 1.0e9,
+      initialize_time * 1.0e9,
+      resident_after - resident_before);
+  std::printf("  \"transforms\": [\n");
+  for (size_t i = 0; i < point_results.size(); i++)
+  {
+    const PointResult& result = point_results[i];
+    std::printf(
+        "    {\"plugin\": \"%s\", \"transform\": \"%s\", \"batch_size\": %lu, \"ns_per_point\": %.3f}%s\n",
+        result.plugin.c_str(),
+        result.name.c_str(),
+        static_cast<unsigned long>(result.batch_size),
+        result.ns_per_point,
+        i + 1 < point_results.size() ? "," : "");
+  }
+  std::printf("  ],\n  \"lookups\": [\n");
+  for (size_t i = 0; i < lookup_results.size(); i++)
+  {
+    const LookupResult& result = lookup_results[i];
+    std::printf(
+        "    {\"source\": \"%s\", \"lookups\": %lu, \"failures\": %lu, \"ns_per_lookup\": %.3f}%s\n",
+        result.name.c_str(),
+        static_cast<unsigned long>(result.lookups),
+        static_cast<unsigned long>(result.failures),
+        result.ns_per_lookup,
+        i + 1 < lookup_results.size() ? "," : "");
+  }
+  std::printf("  ]\n}\n");
+
+  return 0;
+}
@@ -27,6 +27,8 @@
 //
 // *****************************************************************************
 
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <ros/ros.h>
@@ -48,7 +50,49 @@ TEST(GeoreferenceTests, Load)
   EXPECT_EQ(512, georeference.TileSize());
 }
 
-// TODO(malban): Test coordinate/pixel transforms.
+TEST(GeoreferenceTests, BatchTransforms)
+{
+  std::string filename;
+  ASSERT_TRUE(ros::param::get("geo_file", filename));
+
+  transform_util::GeoReference georeference(filename);
+  ASSERT_TRUE(georeference.Load());
+
+  // The fit should be close to the tiepoints.
+  double x, y;
+  georeference.GetCoordinate(4799, 209, x, y);
+  EXPECT_NEAR(535674.5, x, 5.0);
+  EXPECT_NEAR(3258382.5, y, 5.0);
+
+  std::vector<cv::Point2d> pixels;
+  for (int i = 0; i < 100; i++)
+  {
+    pixels.push_back(cv::Point2d(i * 291, i * 158));
+  }
+
+  std::vector<cv::Point2d> coordinates;
+  georeference.GetCoordinates(pixels, coordinates);
+  ASSERT_EQ(pixels.size(), coordinates.size());
+
+  std::vector<cv::Point> pixels2;
+  georeference.GetPixels(coordinates, pixels2);
+  ASSERT_EQ(pixels.size(), pixels2.size());
+
+  for (size_t i = 0; i < pixels.size(); i++)
+  {
+    georeference.GetCoordinate(pixels[i].x, pixels[i].y, x, y);
+    EXPECT_DOUBLE_EQ(x, coordinates[i].x);
+    EXPECT_DOUBLE_EQ(y, coordinates[i].y);
+
+    int x_pixel, y_pixel;
+    georeference.GetPixel(coordinates[i].x, coordinates[i].y, x_pixel, y_pixel);
+    EXPECT_EQ(x_pixel, pixels2[i].x);
+    EXPECT_EQ(y_pixel, pixels2[i].y);
+
+    EXPECT_NEAR(pixels[i].x, pixels2[i].x, 1);
+    EXPECT_NEAR(pixels[i].y, pixels2[i].y, 1);
+  }
+}
 
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv)
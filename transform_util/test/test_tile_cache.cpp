@@ -0,0 +1,286 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <transform_util/georeference.h>
+#include <transform_util/tile_cache.h>
+
+// Offsets of the pixels within each 2x2 block of the test image.  They are
+// distinct, so every pixel of a block is different, and their mean is an
+// integer, so the half resolution level can be computed exactly.
+static const uint8_t _block_offsets[4] = {0, 1, 2, 5};
+
+static uint8_t ImageValue(int32_t x, int32_t y)
+{
+  return 8 * ((x / 2 + 3 * (y / 2)) % 31) + _block_offsets[x % 2 + 2 * (y % 2)];
+}
+
+static uint8_t ReducedValue(int32_t x, int32_t y)
+{
+  return 8 * ((x + 3 * y) % 31) + 2;
+}
+
+class TileCacheTests : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    char path[] = "/tmp/tile_cache_XXXXXX";
+    ASSERT_TRUE(mkdtemp(path) != NULL);
+    path_ = path;
+
+    // The image is 80 x 64 pixels, so the last column of 32 pixel tiles at
+    // full resolution and at half resolution is padded.
+    image_ = cv::Mat(64, 80, CV_8U);
+    for (int32_t y = 0; y < image_.rows; y++)
+    {
+      for (int32_t x = 0; x < image_.cols; x++)
+      {
+        image_.at<uint8_t>(y, x) = ImageValue(x, y);
+      }
+    }
+
+    // North up at 1 unit per pixel with the top left corner at (1000, 2000).
+    std::string geo_file = path_ + "/test.geo";
+    std::ofstream geo(geo_file.c_str());
+    geo << "image_path: \".\"\n"
+        << "image_width: 80\n"
+        << "image_height: 64\n"
+        << "tile_size: 32\n"
+        << "datum: \"wgs84\"\n"
+        << "projection: \"utm\"\n"
+        << "tiepoints:\n"
+        << " - point: [0, 0, 1000, 2000]\n"
+        << " - point: [80, 0, 1080, 2000]\n"
+        << " - point: [0, 64, 1000, 1936]\n"
+        << " - point: [80, 64, 1080, 1936]\n";
+    geo.close();
+
+    georeference_.reset(new transform_util::GeoReference(geo_file));
+    ASSERT_TRUE(georeference_->Load());
+
+    ASSERT_TRUE(transform_util::TileCache::WritePyramid(image_, 32, 8, path_));
+  }
+
+  virtual void TearDown()
+  {
+    if (!path_.empty())
+    {
+      boost::filesystem::remove_all(path_);
+    }
+  }
+
+  std::string path_;
+  cv::Mat image_;
+  boost::shared_ptr<transform_util::GeoReference> georeference_;
+};
+
+TEST_F(TileCacheTests, RoundTrip)
+{
+  transform_util::TileCache cache(*georeference_, path_);
+  ASSERT_TRUE(cache.Open());
+
+  // Levels are written until the image fits in a single tile.
+  EXPECT_EQ(3, cache.Levels());
+
+  std::vector<transform_util::TileKey> keys;
+  std::vector<cv::Mat> tiles;
+  cache.GetTiles(1000.5, 1936.5, 1079.5, 1999.5, 0, keys, tiles);
+  ASSERT_EQ(6u, keys.size());
+  ASSERT_EQ(keys.size(), tiles.size());
+
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    // The keys are in row-major tile order.
+    EXPECT_EQ(transform_util::TileKey(0, i % 3, i / 3), keys[i]);
+    ASSERT_EQ(32, tiles[i].rows);
+    ASSERT_EQ(32, tiles[i].cols);
+    ASSERT_EQ(CV_8U, tiles[i].type());
+
+    for (int32_t y = 0; y < 32; y++)
+    {
+      for (int32_t x = 0; x < 32; x++)
+      {
+        int32_t image_x = keys[i].x * 32 + x;
+        int32_t image_y = keys[i].y * 32 + y;
+        uint8_t expected = image_x < 80 ? ImageValue(image_x, image_y) : 0;
+        ASSERT_EQ(expected, tiles[i].at<uint8_t>(y, x))
+          << "tile " << keys[i].x << ", " << keys[i].y << " pixel " << x << ", " << y;
+      }
+    }
+  }
+
+  // The half resolution level is 40 x 32 pixels.
+  cache.GetTiles(1000.5, 1936.5, 1079.5, 1999.5, 1, keys, tiles);
+  ASSERT_EQ(2u, keys.size());
+
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    EXPECT_EQ(transform_util::TileKey(1, i, 0), keys[i]);
+
+    for (int32_t y = 0; y < 32; y++)
+    {
+      for (int32_t x = 0; x < 32; x++)
+      {
+        int32_t image_x = keys[i].x * 32 + x;
+        uint8_t expected = image_x < 40 ? ReducedValue(image_x, y) : 0;
+        ASSERT_EQ(expected, tiles[i].at<uint8_t>(y, x))
+          << "tile " << keys[i].x << " pixel " << x << ", " << y;
+      }
+    }
+  }
+
+  // Tiles outside of the pyramid are empty.
+  EXPECT_TRUE(cache.GetTile(transform_util::TileKey(0, 3, 0)).empty());
+  EXPECT_TRUE(cache.GetTile(transform_util::TileKey(3, 0, 0)).empty());
+}
+
+TEST_F(TileCacheTests, TileKeys)
+{
+  transform_util::TileCache cache(*georeference_, path_);
+  ASSERT_TRUE(cache.Open());
+
+  std::vector<transform_util::TileKey> keys;
+
+  // Pixels 31 and 32 are on either side of the first tile boundary.
+  cache.GetTileKeys(1031.5, 1990.5, 1031.5, 1990.5, 0, keys);
+  ASSERT_EQ(1u, keys.size());
+  EXPECT_EQ(transform_util::TileKey(0, 0, 0), keys[0]);
+
+  cache.GetTileKeys(1032.5, 1990.5, 1032.5, 1990.5, 0, keys);
+  ASSERT_EQ(1u, keys.size());
+  EXPECT_EQ(transform_util::TileKey(0, 1, 0), keys[0]);
+
+  // y increases to the north, so the bottom row of tiles has the smaller y.
+  cache.GetTileKeys(1031.5, 1950.5, 1032.5, 1950.5, 0, keys);
+  ASSERT_EQ(2u, keys.size());
+  EXPECT_EQ(transform_util::TileKey(0, 0, 1), keys[0]);
+  EXPECT_EQ(transform_util::TileKey(0, 1, 1), keys[1]);
+
+  // Boxes extending past the image are clipped to its tiles.
+  cache.GetTileKeys(900.5, 1900.5, 1200.5, 2100.5, 0, keys);
+  EXPECT_EQ(6u, keys.size());
+
+  cache.GetTileKeys(1070.5, 1990.5, 1200.5, 1995.5, 0, keys);
+  ASSERT_EQ(1u, keys.size());
+  EXPECT_EQ(transform_util::TileKey(0, 2, 0), keys[0]);
+
+  // Boxes entirely outside of the image don't have any tiles.
+  cache.GetTileKeys(1100.5, 1990.5, 1200.5, 1995.5, 0, keys);
+  EXPECT_TRUE(keys.empty());
+
+  // A tile at level 1 spans 64 full resolution pixels.
+  cache.GetTileKeys(1063.5, 1990.5, 1063.5, 1990.5, 1, keys);
+  ASSERT_EQ(1u, keys.size());
+  EXPECT_EQ(transform_util::TileKey(1, 0, 0), keys[0]);
+
+  cache.GetTileKeys(1064.5, 1990.5, 1064.5, 1990.5, 1, keys);
+  ASSERT_EQ(1u, keys.size());
+  EXPECT_EQ(transform_util::TileKey(1, 1, 0), keys[0]);
+
+  cache.GetTileKeys(900.5, 1900.5, 1200.5, 2100.5, 2, keys);
+  ASSERT_EQ(1u, keys.size());
+  EXPECT_EQ(transform_util::TileKey(2, 0, 0), keys[0]);
+
+  // Levels that weren't written don't have any tiles.
+  cache.GetTileKeys(1000.5, 1936.5, 1079.5, 1999.5, 3, keys);
+  EXPECT_TRUE(keys.empty());
+  cache.GetTileKeys(1000.5, 1936.5, 1079.5, 1999.5, -1, keys);
+  EXPECT_TRUE(keys.empty());
+}
+
+TEST_F(TileCacheTests, MemoryBudget)
+{
+  const size_t tile_bytes = 32 * 32;
+
+  transform_util::TileCache cache(*georeference_, path_, 3 * tile_bytes);
+  ASSERT_TRUE(cache.Open());
+  EXPECT_EQ(0u, cache.MemoryUsage());
+
+  for (int32_t i = 0; i < 6; i++)
+  {
+    transform_util::TileKey key(0, i % 3, i / 3);
+    cv::Mat tile = cache.GetTile(key);
+    ASSERT_FALSE(tile.empty());
+    EXPECT_EQ(ImageValue(key.x * 32, key.y * 32), tile.at<uint8_t>(0, 0));
+    EXPECT_EQ(std::min(i + 1, 3) * tile_bytes, cache.MemoryUsage());
+  }
+
+  // Evicted tiles are reloaded from the pyramid.
+  cv::Mat tile = cache.GetTile(transform_util::TileKey(0, 0, 0));
+  ASSERT_FALSE(tile.empty());
+  EXPECT_EQ(ImageValue(0, 0), tile.at<uint8_t>(0, 0));
+  EXPECT_EQ(3 * tile_bytes, cache.MemoryUsage());
+
+  // The most recently requested tile is kept even if it exceeds the budget.
+  transform_util::TileCache small_cache(*georeference_, path_, tile_bytes / 2);
+  ASSERT_TRUE(small_cache.Open());
+  for (int32_t i = 0; i < 3; i++)
+  {
+    ASSERT_FALSE(small_cache.GetTile(transform_util::TileKey(0, i, 0)).empty());
+    EXPECT_EQ(tile_bytes, small_cache.MemoryUsage());
+  }
+}
+
+TEST_F(TileCacheTests, Prefetch)
+{
+  transform_util::TileCache cache(*georeference_, path_);
+  ASSERT_TRUE(cache.Open());
+
+  std::vector<cv::Point2d> path;
+  path.push_back(cv::Point2d(1010.5, 1990.5));
+  path.push_back(cv::Point2d(1070.5, 1950.5));
+  cache.Prefetch(path, 5.0, 0);
+
+  // The two points are in opposite corner tiles.
+  for (int32_t i = 0; i < 200 && cache.MemoryUsage() < 2 * 32 * 32; i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  EXPECT_EQ(2 * 32 * 32u, cache.MemoryUsage());
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
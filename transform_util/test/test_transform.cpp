@@ -0,0 +1,146 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <cmath>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+
+#include <transform_util/transform.h>
+
+/**
+ * A simple non-linear transform used to exercise composition.
+ */
+class SquareTransform : public transform_util::TransformImpl
+{
+public:
+  virtual void Transform(const tf::Vector3& v_in, tf::Vector3& v_out) const
+  {
+    v_out.setValue(v_in.x() * v_in.x(), v_in.y(), v_in.z());
+  }
+};
+
+TEST(TransformTests, ComposeRigid)
+{
+  tf::Transform tf1(tf::Quaternion(tf::Vector3(0, 0, 1), 0.3), tf::Vector3(1, 2, 3));
+  tf::Transform tf2(tf::Quaternion(tf::Vector3(0, 1, 0), -0.7), tf::Vector3(-4, 5, 0.5));
+
+  transform_util::Transform t1(tf1);
+  transform_util::Transform t2(tf2);
+  transform_util::Transform composed = t1 * t2;
+
+  tf::Vector3 v(10, -3, 2);
+  tf::Vector3 expected = tf1 * (tf2 * v);
+  tf::Vector3 actual = composed * v;
+
+  EXPECT_NEAR(expected.x(), actual.x(), 1e-9);
+  EXPECT_NEAR(expected.y(), actual.y(), 1e-9);
+  EXPECT_NEAR(expected.z(), actual.z(), 1e-9);
+}
+
+TEST(TransformTests, FuseAdjacentRigidStages)
+{
+  tf::Transform tf1(tf::Quaternion(tf::Vector3(0, 0, 1), 0.3), tf::Vector3(1, 2, 3));
+  tf::Transform tf2(tf::Quaternion(tf::Vector3(0, 0, 1), 1.1), tf::Vector3(7, 0, 0));
+
+  transform_util::Transform t1(tf1);
+  transform_util::Transform t2(tf2);
+  transform_util::Transform square(boost::make_shared<SquareTransform>());
+
+  // Two rigid stages on either side of a non-linear stage should be fused
+  // into a single rigid stage each.
+  transform_util::Transform composed = t1 * t2 * square * t2 * t1;
+
+  std::vector<boost::shared_ptr<transform_util::TransformImpl> > stages;
+  stages.push_back(boost::make_shared<transform_util::TfTransform>(tf1));
+  stages.push_back(boost::make_shared<transform_util::TfTransform>(tf2));
+  stages.push_back(boost::make_shared<SquareTransform>());
+  stages.push_back(boost::make_shared<transform_util::TfTransform>(tf2));
+  stages.push_back(boost::make_shared<transform_util::TfTransform>(tf1));
+  transform_util::CompositeTransform composite(stages);
+  EXPECT_EQ(3, composite.NumStages());
+
+  std::vector<tf::Vector3> points;
+  for (int32_t i = 0; i < 10; i++)
+  {
+    points.push_back(tf::Vector3(i, i * 0.5, -i));
+  }
+
+  std::vector<tf::Vector3> transformed;
+  composed.TransformPoints(points, transformed);
+  ASSERT_EQ(points.size(), transformed.size());
+
+  for (size_t i = 0; i < points.size(); i++)
+  {
+    tf::Vector3 expected = tf2 * (tf1 * points[i]);
+    expected.setX(expected.x() * expected.x());
+    expected = tf1 * (tf2 * expected);
+
+    EXPECT_NEAR(expected.x(), transformed[i].x(), 1e-9);
+    EXPECT_NEAR(expected.y(), transformed[i].y(), 1e-9);
+    EXPECT_NEAR(expected.z(), transformed[i].z(), 1e-9);
+
+    tf::Vector3 single = composed * points[i];
+    EXPECT_NEAR(expected.x(), single.x(), 1e-9);
+    EXPECT_NEAR(expected.y(), single.y(), 1e-9);
+    EXPECT_NEAR(expected.z(), single.z(), 1e-9);
+  }
+}
+
+TEST(TransformTests, Linearize)
+{
+  transform_util::Transform square(boost::make_shared<SquareTransform>());
+
+  // Over a small region the squared coordinate is nearly linear.
+  transform_util::Transform linearized;
+  ASSERT_TRUE(square.Linearize(
+      tf::Vector3(100, 0, 0), tf::Vector3(100.1, 1, 0), 0.01, linearized));
+
+  tf::Vector3 v(100.05, 0.5, 0);
+  EXPECT_NEAR((square * v).x(), (linearized * v).x(), 0.01);
+  EXPECT_NEAR((square * v).y(), (linearized * v).y(), 0.01);
+
+  // Over a large region it is not.
+  EXPECT_FALSE(square.Linearize(
+      tf::Vector3(0, 0, 0), tf::Vector3(100, 1, 0), 0.01, linearized));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  ros::Time::init();
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,181 @@
+// *****************************************************************************
+//
+// Copyright (c) 2014, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+
+#include <math_util/constants.h>
+#include <transform_util/transform_buffer.h>
+
+TEST(TransformBufferTests, Interpolate)
+{
+  transform_util::TransformBuffer buffer;
+
+  tf::Transform t1(tf::Quaternion(tf::Vector3(0, 0, 1), 0), tf::Vector3(0, 0, 0));
+  tf::Transform t2(tf::Quaternion(tf::Vector3(0, 0, 1), math_util::_half_pi), tf::Vector3(10, -4, 2));
+
+  buffer.Insert(tf::StampedTransform(t2, ros::Time(20), "/far_field", "/base_link"));
+  buffer.Insert(tf::StampedTransform(t1, ros::Time(10), "/far_field", "/base_link"));
+
+  tf::StampedTransform transform;
+  ASSERT_TRUE(buffer.Lookup("far_field", "base_link", ros::Time(15), transform));
+
+  EXPECT_FLOAT_EQ(5, transform.getOrigin().x());
+  EXPECT_FLOAT_EQ(-2, transform.getOrigin().y());
+  EXPECT_FLOAT_EQ(1, transform.getOrigin().z());
+  EXPECT_FLOAT_EQ(math_util::_half_pi / 2.0, transform.getRotation().getAngle());
+  EXPECT_FLOAT_EQ(15, transform.stamp_.toSec());
+
+  // Exact samples are returned as-is.
+  ASSERT_TRUE(buffer.Lookup("/far_field", "/base_link", ros::Time(20), transform));
+  EXPECT_FLOAT_EQ(10, transform.getOrigin().x());
+
+  // Time 0 is the latest sample.
+  ASSERT_TRUE(buffer.Lookup("/far_field", "/base_link", ros::Time(0), transform));
+  EXPECT_FLOAT_EQ(20, transform.stamp_.toSec());
+
+  // No extrapolation and no unknown frame pairs.
+  EXPECT_FALSE(buffer.Lookup("/far_field", "/base_link", ros::Time(25), transform));
+  EXPECT_FALSE(buffer.Lookup("/far_field", "/base_link", ros::Time(5), transform));
+  EXPECT_FALSE(buffer.Lookup("/base_link", "/far_field", ros::Time(15), transform));
+}
+
+TEST(TransformBufferTests, CacheLimits)
+{
+  transform_util::TransformHistory history(
+      "/far_field", "/base_link", ros::Duration(5.0), 4);
+
+  for (int32_t i = 1; i <= 10; i++)
+  {
+    history.Insert(tf::Transform::getIdentity(), ros::Time(i));
+  }
+
+  EXPECT_EQ(4, history.Size());
+  EXPECT_FLOAT_EQ(7, history.Oldest().toSec());
+  EXPECT_FLOAT_EQ(10, history.Newest().toSec());
+
+  transform_util::TransformHistory short_history(
+      "/far_field", "/base_link", ros::Duration(2.5), 100);
+
+  for (int32_t i = 1; i <= 10; i++)
+  {
+    short_history.Insert(tf::Transform::getIdentity(), ros::Time(i));
+  }
+
+  EXPECT_EQ(3, short_history.Size());
+  EXPECT_FLOAT_EQ(8, short_history.Oldest().toSec());
+}
+
+TEST(TransformBufferTests, OutOfOrder)
+{
+  transform_util::TransformHistory history(
+      "/far_field", "/base_link", ros::Duration(100.0), 4);
+
+  tf::Quaternion identity = tf::Quaternion::getIdentity();
+  int32_t stamps[] = {10, 30, 20, 40, 25};
+  for (int32_t i = 0; i < 5; i++)
+  {
+    history.Insert(
+        tf::Transform(identity, tf::Vector3(stamps[i], 0, 0)),
+        ros::Time(stamps[i]));
+  }
+
+  // The oldest sample was dropped to make room for the late one.
+  EXPECT_EQ(4, history.Size());
+  EXPECT_FLOAT_EQ(20, history.Oldest().toSec());
+  EXPECT_FLOAT_EQ(40, history.Newest().toSec());
+
+  tf::StampedTransform transform;
+  ASSERT_TRUE(history.Lookup(ros::Time(22.5), transform));
+  EXPECT_FLOAT_EQ(22.5, transform.getOrigin().x());
+  ASSERT_TRUE(history.Lookup(ros::Time(35), transform));
+  EXPECT_FLOAT_EQ(35, transform.getOrigin().x());
+
+  // A sample older than a full history is ignored.
+  history.Insert(tf::Transform(identity, tf::Vector3(5, 0, 0)), ros::Time(5));
+  EXPECT_FLOAT_EQ(20, history.Oldest().toSec());
+
+  // A sample with an existing stamp replaces it.
+  history.Insert(tf::Transform(identity, tf::Vector3(-1, 0, 0)), ros::Time(30));
+  EXPECT_EQ(4, history.Size());
+  ASSERT_TRUE(history.Lookup(ros::Time(30), transform));
+  EXPECT_FLOAT_EQ(-1, transform.getOrigin().x());
+}
+
+static void InsertSamples(transform_util::TransformHistory* history, int32_t count)
+{
+  tf::Quaternion identity = tf::Quaternion::getIdentity();
+  for (int32_t i = 1; i <= count; i++)
+  {
+    history->Insert(
+        tf::Transform(identity, tf::Vector3(i, 2 * i, 3 * i)),
+        ros::Time(i));
+  }
+}
+
+TEST(TransformBufferTests, ConcurrentLookup)
+{
+  transform_util::TransformHistory history(
+      "/far_field", "/base_link", ros::Duration(1000.0), 4);
+  history.Insert(tf::Transform::getIdentity(), ros::Time(0.5));
+
+  // Lookups while the ring wraps around always see consistent samples.
+  const int32_t count = 200000;
+  boost::thread writer(boost::bind(&InsertSamples, &history, count));
+
+  int32_t found = 0;
+  tf::StampedTransform transform;
+  while (history.Newest().toSec() < count)
+  {
+    // The oldest samples are the ones being overwritten.
+    double time = history.Oldest().toSec() + 0.25;
+    if (time > 1 && history.Lookup(ros::Time(time), transform))
+    {
+      found++;
+      ASSERT_DOUBLE_EQ(time, transform.getOrigin().x());
+      ASSERT_DOUBLE_EQ(2 * time, transform.getOrigin().y());
+      ASSERT_DOUBLE_EQ(3 * time, transform.getOrigin().z());
+    }
+  }
+  writer.join();
+
+  EXPECT_GT(found, 0);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -27,6 +27,12 @@
 //
 // *****************************************************************************
 
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
 #include <gtest/gtest.h>
 
 #include <ros/ros.h>
@@ -69,6 +75,18 @@ TEST(TransformManagerTests, Identity2)
   EXPECT_FLOAT_EQ(p1.y(), p2.y());
 }
 
+TEST(TransformManagerTests, SupportsTransform)
+{
+  // Support for the plugin frames is known without loading the plugins.  The
+  // tf frames are only known once the listener has received them, which
+  // main() waits for.
+  EXPECT_TRUE(_tf_manager.SupportsTransform(transform_util::_utm_frame, transform_util::_wgs84_frame));
+  EXPECT_TRUE(_tf_manager.SupportsTransform(transform_util::_wgs84_frame, transform_util::_utm_frame));
+  EXPECT_TRUE(_tf_manager.SupportsTransform("/far_field", transform_util::_wgs84_frame));
+  EXPECT_TRUE(_tf_manager.SupportsTransform(transform_util::_utm_frame, "/near_field"));
+  EXPECT_TRUE(_tf_manager.SupportsTransform("/near_field", "/far_field"));
+}
+
 TEST(TransformManagerTests, TfToTf1)
 {
   // Local Origin
@@ -305,6 +323,161 @@ TEST(TransformManagerTests, TfToWgs84_2)
   EXPECT_FLOAT_EQ(29.4564773982, wgs84.y());
 }
 
+/**
+ * Collects the results of asynchronous transform requests.
+ */
+class RequestResults
+{
+public:
+  void Callback(bool success, const transform_util::Transform& transform)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    successes_.push_back(success);
+    transforms_.push_back(transform);
+    condition_.notify_all();
+  }
+
+  bool WaitFor(size_t count)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (successes_.size() < count)
+    {
+      if (!condition_.timed_wait(lock, boost::posix_time::seconds(5)))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::vector<bool> successes_;
+  std::vector<transform_util::Transform> transforms_;
+};
+
+static tf::StampedTransform MakeTransform(double x, const ros::Time& stamp)
+{
+  return tf::StampedTransform(
+      tf::Transform(tf::Quaternion::getIdentity(), tf::Vector3(x, 0, 0)),
+      stamp,
+      "/request_target",
+      "/request_source");
+}
+
+TEST(TransformManagerTests, RequestTransformCallback)
+{
+  boost::shared_ptr<tf::Transformer> transformer =
+      boost::make_shared<tf::Transformer>();
+  transform_util::TransformManager manager;
+  manager.Initialize(transformer);
+
+  ros::Time stamp = ros::Time::now();
+  transformer->setTransform(MakeTransform(4.0, stamp));
+
+  RequestResults results;
+  manager.RequestTransform(
+      "/request_target",
+      "/request_source",
+      stamp,
+      boost::bind(&RequestResults::Callback, &results, _1, _2));
+
+  ASSERT_TRUE(results.WaitFor(1));
+  EXPECT_TRUE(results.successes_[0]);
+  tf::Vector3 point = results.transforms_[0] * tf::Vector3(1, 2, 3);
+  EXPECT_FLOAT_EQ(5, point.x());
+  EXPECT_FLOAT_EQ(2, point.y());
+  EXPECT_FLOAT_EQ(3, point.z());
+}
+
+TEST(TransformManagerTests, RequestTransformFuture)
+{
+  boost::shared_ptr<tf::Transformer> transformer =
+      boost::make_shared<tf::Transformer>();
+  transform_util::TransformManager manager;
+  manager.Initialize(transformer);
+
+  // The future is fulfilled once the transform arrives, and can be waited on
+  // without spinning the global callback queue.
+  ros::Time stamp = ros::Time::now();
+  boost::shared_future<transform_util::Transform> future =
+      manager.RequestTransform(
+          "/request_target", "/request_source", stamp, ros::Duration(5.0));
+
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  EXPECT_FALSE(future.is_ready());
+
+  transformer->setTransform(MakeTransform(-3.0, stamp));
+  ASSERT_TRUE(future.timed_wait(boost::posix_time::seconds(5)));
+
+  tf::Vector3 point = future.get() * tf::Vector3(0, 0, 0);
+  EXPECT_FLOAT_EQ(-3, point.x());
+}
+
+TEST(TransformManagerTests, RequestTransformTimeout)
+{
+  boost::shared_ptr<tf::Transformer> transformer =
+      boost::make_shared<tf::Transformer>();
+  transform_util::TransformManager manager;
+  manager.Initialize(transformer);
+
+  ros::Time stamp = ros::Time::now();
+  RequestResults results;
+  manager.RequestTransform(
+      "/request_target",
+      "/request_source",
+      stamp,
+      boost::bind(&RequestResults::Callback, &results, _1, _2),
+      ros::Duration(0.2));
+
+  boost::shared_future<transform_util::Transform> future =
+      manager.RequestTransform(
+          "/request_target", "/request_source", stamp, ros::Duration(0.2));
+
+  ASSERT_TRUE(results.WaitFor(1));
+  EXPECT_FALSE(results.successes_[0]);
+
+  ASSERT_TRUE(future.timed_wait(boost::posix_time::seconds(5)));
+  EXPECT_THROW(future.get(), tf::LookupException);
+}
+
+TEST(TransformManagerTests, RequestTransformBatching)
+{
+  boost::shared_ptr<tf::Transformer> transformer =
+      boost::make_shared<tf::Transformer>();
+  transform_util::TransformManager manager;
+  manager.Initialize(transformer);
+
+  // Queue the requests before the transforms are available, so they're all
+  // pending when the data arrives and are resolved together.
+  ros::Time stamp1 = ros::Time::now();
+  ros::Time stamp2 = stamp1 + ros::Duration(0.5);
+  RequestResults results;
+  for (int32_t i = 0; i < 10; i++)
+  {
+    manager.RequestTransform(
+        "/request_target",
+        "/request_source",
+        i < 7 ? stamp1 : stamp2,
+        boost::bind(&RequestResults::Callback, &results, _1, _2),
+        ros::Duration(5.0));
+  }
+
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  EXPECT_EQ(0u, manager.RequestLookupCount());
+
+  transformer->setTransform(MakeTransform(1.0, stamp1));
+  transformer->setTransform(MakeTransform(2.0, stamp2));
+  ASSERT_TRUE(results.WaitFor(10));
+
+  // One lookup per distinct time.
+  EXPECT_EQ(2u, manager.RequestLookupCount());
+  for (size_t i = 0; i < results.successes_.size(); i++)
+  {
+    EXPECT_TRUE(results.successes_[i]);
+  }
+}
+
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv)
 {
@@ -313,6 +486,8 @@ int main(int argc, char **argv)
   // Initialize the ROS core parameters can be loaded from the launch file
   ros::init(argc, argv, "test_transform_manager");
 
+  // Initialize() loads the plugins for the special frames, which receive the
+  // local xy origin while waiting below.
   _tf_manager.Initialize();
 
   ros::AsyncSpinner spinner(1);
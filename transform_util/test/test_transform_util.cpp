@@ -27,7 +27,9 @@
 //
 // *****************************************************************************
 
+#include <cmath>
 #include <cstdlib>
+#include <vector>
 
 #include <boost/array.hpp>
 
@@ -37,6 +39,7 @@
 
 #include <math_util/constants.h>
 #include <math_util/math_util.h>
+#include <math_util/trig_util.h>
 #include <transform_util/transform_util.h>
 
 // TODO(malban): Add unit tests for GetRelativeTransform()
@@ -49,6 +52,80 @@ TEST(TransformUtilTests, GetBearing)
   EXPECT_FLOAT_EQ(-90, transform_util::GetBearing(0, 55, 0, 50));
 }
 
+TEST(TransformUtilTests, GetBearingsAndDistances)
+{
+  double source_latitude = 29.45196669;
+  double source_longitude = -98.61370577;
+
+  std::vector<double> latitudes;
+  std::vector<double> longitudes;
+  for (int i = 0; i < 200; i++)
+  {
+    double range = 0.00001 * std::pow(1.08, i);
+    latitudes.push_back(source_latitude + range * std::cos(i * 0.7));
+    longitudes.push_back(source_longitude + range * std::sin(i * 0.7));
+  }
+
+  std::vector<double> bearings;
+  std::vector<double> distances;
+  transform_util::GetBearingsAndDistances(
+      source_latitude, source_longitude,
+      latitudes, longitudes,
+      bearings, distances);
+
+  ASSERT_EQ(latitudes.size(), bearings.size());
+  ASSERT_EQ(latitudes.size(), distances.size());
+
+  for (size_t i = 0; i < latitudes.size(); i++)
+  {
+    EXPECT_NEAR(
+        transform_util::GetBearing(
+            source_latitude, source_longitude, latitudes[i], longitudes[i]),
+        bearings[i],
+        1e-9);
+    EXPECT_NEAR(
+        transform_util::GetDistance(
+            source_latitude, source_longitude, latitudes[i], longitudes[i]),
+        distances[i],
+        1e-6);
+  }
+
+  // The flat-earth approximation must stay within the requested tolerance.
+  double max_error = 0.05;
+  std::vector<double> flat_bearings;
+  std::vector<double> flat_distances;
+  transform_util::GetBearingsAndDistances(
+      source_latitude, source_longitude,
+      latitudes, longitudes,
+      flat_bearings, flat_distances,
+      max_error);
+
+  for (size_t i = 0; i < latitudes.size(); i++)
+  {
+    double d_bearing = math_util::WrapRadians(
+        (flat_bearings[i] - bearings[i]) * math_util::_deg_2_rad, 0);
+    EXPECT_NEAR(distances[i], flat_distances[i], max_error);
+    EXPECT_NEAR(0, distances[i] * d_bearing, max_error);
+  }
+
+  std::vector<double> source_latitudes(latitudes.size(), source_latitude);
+  std::vector<double> source_longitudes(latitudes.size(), source_longitude);
+  std::vector<double> pair_bearings;
+  std::vector<double> pair_distances;
+  transform_util::GetBearingsAndDistances(
+      source_latitudes, source_longitudes,
+      latitudes, longitudes,
+      pair_bearings, pair_distances);
+
+  for (size_t i = 0; i < latitudes.size(); i++)
+  {
+    EXPECT_DOUBLE_EQ(bearings[i], pair_bearings[i]);
+    EXPECT_DOUBLE_EQ(distances[i], pair_distances[i]);
+  }
+
+  EXPECT_NEAR(555975, transform_util::GetDistance(30, 50, 35, 50), 1);
+}
+
 TEST(TransformUtilTests, SnapToRightAngle1)
 {
   tf::Quaternion identity = tf::Quaternion::getIdentity();
@@ -178,6 +255,72 @@ TEST(TransformUtilTests, TestUpperLeftLowerRight)
   EXPECT_EQ(18, array[35]);
 }
 
+TEST(TransformUtilTests, RotateCovariance)
+{
+  boost::array<double, 36> covariance;
+  for (size_t i = 0; i < 36; i++)
+  {
+    covariance[i] = std::rand() / static_cast<double>(RAND_MAX) - 0.5;
+  }
+
+  tf::Transform transform(
+      tf::Quaternion(tf::Vector3(0.2, -0.5, 1.0).normalized(), 0.8),
+      tf::Vector3(10, 20, 30));
+  tf::Matrix3x3 rotation = transform.getBasis();
+
+  // Reference result, computed by multiplying out the full 6x6 matrices.
+  double r6[6][6] = {{0}};
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      r6[i][j] = rotation[i][j];
+      r6[i + 3][j + 3] = rotation[i][j];
+    }
+  }
+
+  double expected[6][6] = {{0}};
+  for (int i = 0; i < 6; i++)
+  {
+    for (int j = 0; j < 6; j++)
+    {
+      for (int k = 0; k < 6; k++)
+      {
+        for (int l = 0; l < 6; l++)
+        {
+          expected[i][j] += r6[i][k] * covariance[k * 6 + l] * r6[j][l];
+        }
+      }
+    }
+  }
+
+  boost::array<double, 36> rotated;
+  transform_util::RotateCovariance(transform, covariance, rotated);
+
+  std::vector<boost::array<double, 36> > batch(3, covariance);
+  transform_util::RotateCovariances(transform, batch, batch);
+
+  for (int i = 0; i < 6; i++)
+  {
+    for (int j = 0; j < 6; j++)
+    {
+      EXPECT_NEAR(expected[i][j], rotated[i * 6 + j], 1e-12);
+      EXPECT_NEAR(expected[i][j], batch[2][i * 6 + j], 1e-12);
+    }
+  }
+
+  boost::array<double, 9> covariance3;
+  transform_util::Set3x3Cov(transform_util::GetLowerRight(covariance), covariance3);
+  transform_util::RotateCovariance(transform, covariance3, covariance3);
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      EXPECT_NEAR(expected[i + 3][j + 3], covariance3[i * 3 + j], 1e-12);
+    }
+  }
+}
+
 TEST(TransformUtilTests, GetPrimaryAxis)
 {
   tf::Vector3 v1(-1, 0, 0);
@@ -29,6 +29,7 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -58,6 +59,68 @@ TEST(UtmUtilTests, GetBand)
   EXPECT_EQ('Z', transform_util::GetBand(-80.5));
 }
 
+TEST(UtmUtilTests, GetZoneExceptions)
+{
+  // Bergen is in the southwest Norway exception.
+  EXPECT_EQ(31, transform_util::GetZone(5.324383));
+  EXPECT_EQ(32, transform_util::GetZone(60.391263, 5.324383));
+
+  // Outside of the exception the standard zones apply.
+  EXPECT_EQ(31, transform_util::GetZone(55.9, 5.324383));
+  EXPECT_EQ(31, transform_util::GetZone(60.391263, 2.9));
+
+  // 64N is in band W, which doesn't have the exception.
+  EXPECT_EQ(32, transform_util::GetZone(63.999999, 4.0));
+  EXPECT_EQ(31, transform_util::GetZone(64.0, 4.0));
+
+  // Svalbard
+  EXPECT_EQ(31, transform_util::GetZone(78.5, 8.9));
+  EXPECT_EQ(33, transform_util::GetZone(78.223, 15.6267));  // Longyearbyen
+  EXPECT_EQ(35, transform_util::GetZone(78.5, 21.0));
+  EXPECT_EQ(37, transform_util::GetZone(78.5, 41.9));
+  EXPECT_EQ(38, transform_util::GetZone(78.5, 42.0));
+  EXPECT_EQ(31, transform_util::GetZone(84.0, 8.9));
+  EXPECT_EQ(33, transform_util::GetZone(72.0, 9.0));
+
+  EXPECT_EQ(11, transform_util::GetZone(33.9425, -118.408056));  // LAX
+  EXPECT_EQ( 1, transform_util::GetZone(0, -180.0));
+  EXPECT_EQ(60, transform_util::GetZone(0, 180.0));
+}
+
+TEST(UtmUtilTests, BatchToUtm)
+{
+  transform_util::UtmUtil utm_util;
+
+  // A track that crosses zone, band, and exception boundaries.
+  std::vector<double> latitudes;
+  std::vector<double> longitudes;
+  for (int i = 0; i < 400; i++)
+  {
+    latitudes.push_back(50.0 + i * 0.03);
+    longitudes.push_back(-1.0 + i * 0.04);
+  }
+
+  std::vector<int> zones;
+  std::vector<char> bands;
+  std::vector<double> eastings;
+  std::vector<double> northings;
+  utm_util.ToUtm(latitudes, longitudes, zones, bands, eastings, northings);
+
+  ASSERT_EQ(latitudes.size(), zones.size());
+  for (size_t i = 0; i < latitudes.size(); i++)
+  {
+    int zone;
+    char band;
+    double easting, northing;
+    utm_util.ToUtm(latitudes[i], longitudes[i], zone, band, easting, northing);
+
+    EXPECT_EQ(zone, zones[i]);
+    EXPECT_EQ(band, bands[i]);
+    EXPECT_DOUBLE_EQ(easting, eastings[i]);
+    EXPECT_DOUBLE_EQ(northing, northings[i]);
+  }
+}
+
 TEST(UtmUtilTests, ToUtm)
 {
   transform_util::UtmUtil utm_util;